@@ -12,7 +12,7 @@
 #include "../../MCAL/RCC/STM_RCC.h"
 
 #define HSI_CLOCK       ((u32) 16000000)
-#define HSE_CLOCK       ((u32) 25000000)
+#define HSE_CLOCK       RCC_HSE_CLOCK
 
 typedef void (*clkHandlercbf_t)(u32);
 
@@ -0,0 +1,21 @@
+/*******************************************************************
+*   File name:    Address.h
+*   Author:       Ibrahim Saad
+*   Description:  This file contains the casts between pointers and u32 addresses
+*   Version: v1.0
+*******************************************************************/
+
+#ifndef ADDRESS_H
+#define ADDRESS_H
+
+#include <stdint.h>
+#include "Std_types.h"
+
+/*
+    Addresses of the MCU are u32, casts go through uintptr_t so host builds (flash simulator,
+    64-bit pointers) don't warn, on target they are plain casts.
+*/
+#define TO_ADDRESS(pointer)     ((u32) (uintptr_t) (pointer))
+#define TO_POINTER(address)     ((void*) (uintptr_t) (address))
+
+#endif
@@ -0,0 +1,26 @@
+/*******************************************************************
+*   File name:    Ram_func.h
+*   Author:       Ibrahim Saad
+*   Description:  This file contains the RAM_FUNC attribute which links functions
+*                 in SRAM
+*   Version: v1.0
+*******************************************************************/
+
+#ifndef RAM_FUNC_H
+#define RAM_FUNC_H
+
+/*
+    Functions marked by RAM_FUNC are linked in ".RamFunc" section, STM32CubeIDE linker scripts
+    keep it inside .data output section (*(.RamFunc) *(.RamFunc*)) so the startup code copies
+    it from flash to SRAM with the initialized data, for other linker scripts add these two lines
+    to .data section. Code running from SRAM isn't stalled while the flash programs or erases,
+    as long as it doesn't call functions or read constants still in flash.
+    long_call is needed since SRAM is out of the range of a BL instruction from flash.
+*/
+#if defined(__arm__)
+#define RAM_FUNC    __attribute__((section(".RamFunc"), noinline, long_call))
+#else
+#define RAM_FUNC
+#endif
+
+#endif
@@ -0,0 +1,28 @@
+/*******************************************************************
+*   File name:    Soft_crc.h
+*   Author:       Ibrahim Saad
+*   Description:  This file contains the APIs of the software CRC-32 matching the
+*                 CRC calculation unit
+*   Version: v1.0
+*******************************************************************/
+
+#ifndef SOFT_CRC_H
+#define SOFT_CRC_H
+
+#include "../Std_types.h"
+
+/*
+    Software CRC-32 giving the same values as the CRC calculation unit (CRC.c):
+        - polynomial 0x04C11DB7, no reflection, no final xor, each 32-bit word is shifted in from bit 31
+        - SOFT_CRC_INIT is the value of CRC_DR after crc_resetCRCValue
+        - bytes are packed into words little endian (as the MCU reads them from memory), a last partial
+          word is padded by zeros, so only the last call of softCrc_updateBytes may have length % 4 != 0
+        - slicing-by-8 tables (8KB const) everywhere, host builds with PCLMUL enabled (-mpclmul or
+          -march=native on x86-64) fold 64 bytes per step by carry-less multiply
+*/
+#define SOFT_CRC_INIT       0xFFFFFFFF
+
+u32 softCrc_updateWords(u32 crc, const u32* words, u32 wordsCount);
+u32 softCrc_updateBytes(u32 crc, const void* data, u32 length);
+
+#endif
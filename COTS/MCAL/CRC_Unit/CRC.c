@@ -9,9 +9,14 @@
  */
 
 #include "CRC.h"
+#include "../DMA/STM_DMA.h"
 
 #define CRC_CR_RESET    0
 
+#define CRC_POLYNOMIAL          0x04C11DB7
+#define CRC_INIT_VALUE          0xFFFFFFFF
+#define CRC_CONTEXT_MAGIC       0xC5
+
 struct CRCRegs_t
 {
     u32 CRC_DR;
@@ -21,12 +26,20 @@ struct CRCRegs_t
 
 static volatile struct CRCRegs_t* const crcRegs = (volatile struct CRCRegs_t* const) 0x40023000;
 
-static void approximateWaiting_4ClockCycles();
+static volatile u8 asyncBusy = 0;
+static crcCbf_t asyncCallBack = NULL;
+static const crcContext_t* loadedContext = NULL;   /* context whose state is in CRC_DR */
+
+static void asyncDoneCallback(void);
+static void asyncErrorCallback(u8 errorStatus);
+static u32 inverseWordStep(u32 crc);
+static void loadContext(const crcContext_t* context);
 
+/* a write while the previous word is calculated (4 AHB cycles) is stalled by the unit, no wait needed */
 void crc_setDataRegister(u32 data)
 {
+    loadedContext = NULL;
     crcRegs->CRC_DR = data;
-    approximateWaiting_6ClockCycles();
 }
 
 CRC_ErrorStatus_t crc_getCRC(pu32 crcValue)
@@ -46,19 +59,20 @@ CRC_ErrorStatus_t crc_getCRC(pu32 crcValue)
 
 void crc_resetCRCValue()
 {
+    loadedContext = NULL;
     crcRegs->CRC_CR |= (1 << CRC_CR_RESET);
 }
 
-CRC_ErrorStatus_t crc_getDataBlockCRC(pu32 arr, u16 length, pu32 crcValue)
+CRC_ErrorStatus_t crc_getDataBlockCRC(pu32 arr, u32 length, pu32 crcValue)
 {
     CRC_ErrorStatus_t errorStatus = crc_retNotOk;
     if(arr && crcValue)
     {
-        u16 i;
+        u32 i;
+        loadedContext = NULL;
         for(i = 0; i < length; i++)
         {
             crcRegs->CRC_DR = arr[i];
-            approximateWaiting_4ClockCycles();
         }
         *crcValue = crcRegs->CRC_DR;
         errorStatus = crc_retOk;
@@ -70,11 +84,216 @@ CRC_ErrorStatus_t crc_getDataBlockCRC(pu32 arr, u16 length, pu32 crcValue)
     return errorStatus;
 }
 
-static void approximateWaiting_4ClockCycles()
+CRC_ErrorStatus_t crc_getDataRegisterAddress(pu32 address)
+{
+    CRC_ErrorStatus_t errorStatus = crc_retNotOk;
+    if(address)
+    {
+        *address = (u32) &crcRegs->CRC_DR;
+        errorStatus = crc_retOk;
+    }
+    else
+    {
+        errorStatus = crc_retNullPointer;
+    }
+    return errorStatus;
+}
+
+CRC_ErrorStatus_t crc_getDataBlockCRCAsync(u16 streamId, const u32* arr, u32 length, crcCbf_t cbf)
+{
+    CRC_ErrorStatus_t errorStatus = crc_retNotOk;
+    if(!arr || !cbf)
+    {
+        errorStatus = crc_retNullPointer;
+    }
+    else if(length == 0 || length > 0x3FFFFFFF)
+    {
+        errorStatus = crc_retInvalidLength;
+    }
+    else if(asyncBusy)
+    {
+        errorStatus = crc_retBusy;
+    }
+    else
+    {
+        asyncBusy = 1;
+        asyncCallBack = cbf;
+        loadedContext = NULL;
+        dma_registerErrorsCallback(dmaId_2, streamId, asyncErrorCallback);
+        if(dma_feedRegisterAsync(streamId, &crcRegs->CRC_DR, arr, length * 4, asyncDoneCallback) == dma_retOk)
+        {
+            errorStatus = crc_retOk;
+        }
+        else
+        {
+            asyncBusy = 0;
+            errorStatus = crc_retDmaError;
+        }
+    }
+    return errorStatus;
+}
+
+CRC_ErrorStatus_t crc_begin(crcContext_t* context)
+{
+    CRC_ErrorStatus_t errorStatus = crc_retNullPointer;
+    if(context)
+    {
+        if(loadedContext == context)
+        {
+            loadedContext = NULL;
+        }
+        context->state = CRC_INIT_VALUE;
+        context->pendingWord = 0;
+        context->pendingBytes = 0;
+        context->magic = CRC_CONTEXT_MAGIC;
+        errorStatus = crc_retOk;
+    }
+    return errorStatus;
+}
+
+CRC_ErrorStatus_t crc_update(crcContext_t* context, const void* data, u32 length)
+{
+    CRC_ErrorStatus_t errorStatus = crc_retNotOk;
+    const u8* bytes = (const u8*) data;
+    if(!context || (!data && length))
+    {
+        errorStatus = crc_retNullPointer;
+    }
+    else if(context->magic != CRC_CONTEXT_MAGIC)
+    {
+        errorStatus = crc_retInvalidContext;
+    }
+    else if(asyncBusy)
+    {
+        errorStatus = crc_retBusy;
+    }
+    else
+    {
+        /* unaligned head completes the pending word byte by byte */
+        while(length && (context->pendingBytes || ((u32) bytes & 0x3)))
+        {
+            context->pendingWord |= (u32) *bytes << (8 * context->pendingBytes);
+            context->pendingBytes++;
+            bytes++;
+            length--;
+            if(context->pendingBytes == 4)
+            {
+                loadContext(context);
+                crcRegs->CRC_DR = context->pendingWord;
+                context->pendingWord = 0;
+                context->pendingBytes = 0;
+            }
+        }
+        /* aligned body goes as words, the head loop above leaves bytes aligned if length >= 4 */
+        if(length >= 4)
+        {
+            const u32* words = (const u32*) bytes;
+            loadContext(context);
+            while(length >= 4)
+            {
+                crcRegs->CRC_DR = *words;
+                words++;
+                length -= 4;
+            }
+            bytes = (const u8*) words;
+        }
+        while(length)
+        {
+            context->pendingWord |= (u32) *bytes << (8 * context->pendingBytes);
+            context->pendingBytes++;
+            bytes++;
+            length--;
+        }
+        if(loadedContext == context)
+        {
+            context->state = crcRegs->CRC_DR;
+        }
+        errorStatus = crc_retOk;
+    }
+    return errorStatus;
+}
+
+CRC_ErrorStatus_t crc_finish(crcContext_t* context, pu32 crcValue)
+{
+    CRC_ErrorStatus_t errorStatus = crc_retNotOk;
+    if(!context || !crcValue)
+    {
+        errorStatus = crc_retNullPointer;
+    }
+    else if(context->magic != CRC_CONTEXT_MAGIC)
+    {
+        errorStatus = crc_retInvalidContext;
+    }
+    else if(asyncBusy)
+    {
+        errorStatus = crc_retBusy;
+    }
+    else
+    {
+        if(context->pendingBytes)
+        {
+            loadContext(context);
+            crcRegs->CRC_DR = context->pendingWord;
+            context->state = crcRegs->CRC_DR;
+            context->pendingWord = 0;
+            context->pendingBytes = 0;
+        }
+        *crcValue = context->state;
+        context->magic = 0;
+        if(loadedContext == context)
+        {
+            loadedContext = NULL;
+        }
+        errorStatus = crc_retOk;
+    }
+    return errorStatus;
+}
+
+static void asyncDoneCallback(void)
+{
+    asyncBusy = 0;
+    asyncCallBack(crc_retOk, crcRegs->CRC_DR);
+}
+
+static void asyncErrorCallback(u8 errorStatus)
+{
+    /* transfer and direct mode errors end the job the same way */
+    (void) errorStatus;
+    if(asyncBusy)
+    {
+        asyncBusy = 0;
+        asyncCallBack(crc_retDmaError, 0);
+    }
+}
+
+/* undoes the 32 shifts of one word, P has bit 0 set so a shift which xored P left bit 0 set */
+static u32 inverseWordStep(u32 crc)
 {
     u8 i;
-    for(i = 0; i < 4; i++)
+    for(i = 0; i < 32; i++)
     {
-        __asm("nop");
+        if(crc & 1)
+        {
+            crc = ((crc ^ CRC_POLYNOMIAL) >> 1) | 0x80000000;
+        }
+        else
+        {
+            crc >>= 1;
+        }
+    }
+    return crc;
+}
+
+static void loadContext(const crcContext_t* context)
+{
+    if(loadedContext != context)
+    {
+        crcRegs->CRC_CR |= (1 << CRC_CR_RESET);
+        if(context->state != CRC_INIT_VALUE)
+        {
+            /* after reset CRC_DR = f(0xFFFFFFFF ^ word) = state */
+            crcRegs->CRC_DR = inverseWordStep(context->state) ^ CRC_INIT_VALUE;
+        }
+        loadedContext = context;
     }
 }
@@ -18,11 +18,52 @@ typedef enum
     crc_retNotOk,
     crc_retOk,
     crc_retNullPointer,
+    crc_retInvalidLength,
+    crc_retBusy,
+    crc_retDmaError,
+    crc_retInvalidContext,
 }CRC_ErrorStatus_t;
 
+/* state of one logical CRC stream, fields are private to CRC.c */
+typedef struct
+{
+    u32 state;              /* CRC_DR after the last full word */
+    u32 pendingWord;        /* bytes waiting for a full word */
+    u8 pendingBytes;
+    u8 magic;
+}crcContext_t;
+
+/* result is crc_retOk or crc_retDmaError, crcValue is CRC_DR after the last word */
+typedef void (*crcCbf_t)(CRC_ErrorStatus_t result, u32 crcValue);
+
 void crc_setDataRegister(u32 data);
 CRC_ErrorStatus_t crc_getCRC(pu32 crcValue);
 void crc_resetCRCValue();
-CRC_ErrorStatus_t crc_getDataBlockCRC(pu32 arr, u16 length, pu32 crcValue);
+CRC_ErrorStatus_t crc_getDataBlockCRC(pu32 arr, u32 length, pu32 crcValue);
+CRC_ErrorStatus_t crc_getDataRegisterAddress(pu32 address);    /* for DMA transfers to CRC_DR */
+
+/*
+    crc_getDataBlockCRCAsync feeds length words (u32 count, any size) of arr to CRC_DR by a DMA2 memory to memory
+    stream then calls cbf from the stream interrupt:
+        - like crc_getDataBlockCRC the CRC is not reset, call crc_resetCRCValue first for a new block
+        - streamId is a DMA2 stream owned by the caller (dmaManager_requestStream with dmaRequest_MemToMem),
+          its errors callback is registered by this API
+        - DMA2 clock and the stream interrupt in NVIC must be enabled by the user
+*/
+CRC_ErrorStatus_t crc_getDataBlockCRCAsync(u16 streamId, const u32* arr, u32 length, crcCbf_t cbf);
+
+/*
+    Streaming contexts over the unit (CRC clock must be enabled):
+        - crc_update takes bytes of any length and alignment, they are packed into words little endian
+          (as a u32 array in memory), crc_finish pads the last partial word by zeros, so the result is the
+          one of crc_getDataBlockCRC over the zero padded buffer (and of softCrc_updateBytes)
+        - contexts are independent, the unit is loaded with the state of the context being updated when
+          another one (or a block/async API) used it last, the unit has no initial value register so the
+          state S is loaded by a reset then a write of f^-1(S) ^ 0xFFFFFFFF (f: one word step of the unit)
+        - not reentrant, a context updated from an interrupt needs its own critical section in the caller
+*/
+CRC_ErrorStatus_t crc_begin(crcContext_t* context);
+CRC_ErrorStatus_t crc_update(crcContext_t* context, const void* data, u32 length);
+CRC_ErrorStatus_t crc_finish(crcContext_t* context, pu32 crcValue);
 
 #endif /* CRC_H */
\ No newline at end of file
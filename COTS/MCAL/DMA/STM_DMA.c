@@ -27,9 +27,53 @@
 #define STREAM6_BASE_ADD                0x400260A0
 #define STREAM7_BASE_ADD                0x400260B8
 
+#define STREAM_REGS_OFFSET              0x10
+#define STREAM_REGS_SIZE                0x18
+#define GET_STREAM_INDEX(stream)        ((u8)(((stream) - STREAM_REGS_OFFSET) / STREAM_REGS_SIZE))
+#define GET_STREAM_BASE(dma, index)     ((dma) + STREAM_REGS_OFFSET + ((index) * STREAM_REGS_SIZE))
+#define LOW_REG_STREAMS_COUNT           4
+#define GET_DMA_INDEX(dmaId)            (((dmaId) == dmaId_2) ? DMA2_IDX : DMA1_IDX)
+
+#define PING_PONG_BUFFERS               2
+
+/* DWT cycle counter used to timestamp transfers */
+#define DEMCR                           *((volatile u32* const) 0xE000EDFC)
+#define DWT_CTRL                        *((volatile u32* const) 0xE0001000)
+#define DWT_CYCCNT                      *((volatile u32* const) 0xE0001004)
+#define DEMCR_TRCENA                    24
+#define DWT_CTRL_CYCCNTENA              0
+
+#if DMA_STATS_ENABLED
+#define STATS_ON_ENABLE(streamBase)                     statsOnEnable(streamBase)
+#define STATS_ON_FLAGS(dmaIndex, streamIndex, flags)    statsOnFlags(dmaIndex, streamIndex, flags)
+#else
+#define STATS_ON_ENABLE(streamBase)
+#define STATS_ON_FLAGS(dmaIndex, streamIndex, flags)
+#endif
+
 #define MIN_VALID_DATA_ITEMS            1
 #define MAX_VALID_DATA_ITEMS            0xFFFF
 
+/* memory to memory jobs: chunk size is a multiple of every burst length (4, 8, 16 beats) */
+#define MEM_JOB_MAX_CHUNK_ITEMS         0xFFF0
+#define MEM_JOB_INC_BOTH                0
+#define MEM_JOB_FIXED_SOURCE            1
+#define MEM_JOB_FIXED_DESTINATION       2
+#define MSK_MEM_BURST_ALIGN             0x0000000F  /* a burst moves 16 bytes (the whole FIFO) */
+#define MEM_WIDTH_BYTE                  1
+#define MEM_WIDTH_HALF_WORD             2
+#define MEM_WIDTH_WORD                  4
+
+/* FIFO/burst compatibility, codes are the register fields (burst 0:3, size 0:2, threshold 0:3) */
+#define FIFO_SIZE_BYTES                 16
+#define BURST_CODE_SINGLE               0
+#define BURST_CODE_INC16                3
+#define GET_BURST_BEATS(code)           ((code) ? (2 << (code)) : 1)
+#define GET_DATA_SIZE_BYTES(code)       (1 << (code))
+#define GET_FIFO_THRESHOLD_BYTES(code)  (((code) + 1) * 4)
+#define MSK_WORD_ALIGN                  0x00000003
+#define MSK_HALF_WORD_ALIGN             0x00000001
+
 #define MSK_CHECK_VALID_DMA_ID          0x000000FF
 #define MSK_VALID_DMA_ID                0x000000EC
 #define MSK_CLR_CHECK_VALID_DMA_ID      0xFFFFFF00
@@ -95,8 +139,6 @@
 #define SxCR_DMEIE                      1            
 #define SxCR_EN                         0
 
-#define SxFCR_FEIE                      7
-#define SxFCR_DMDIS                     2
 /* will be used to read flags, clear them also (cleared by writing one) */
 /* use lower register for (0, 1, 2, 3) and higher register for (7, 6, 5, 4) */
 #define MSK_TCIF37                      0x08000000
@@ -124,6 +166,9 @@
 #define MSK_FEIF15                      0x00000040
 #define MSK_FEIF04                      0x00000001
 
+/* all flags of one stream shifted down to stream0/stream4 position */
+#define MSK_STREAM_ALL_FLAGS            (MSK_TCIF04 | MSK_HTIF04 | MSK_TEIF04 | MSK_DMEIF04 | MSK_FEIF04)
+
 #define SxFCR_FEIE                      7
 #define SxFCR_DMDIS                     2
 #define MSK_SxFCR_FS                    0x00000038
@@ -136,10 +181,13 @@
 #define MSK_CLR_MSIZE                   0xFFFF9FFF
 #define MSK_CLR_PSIZE                   0xFFFFE7FF
 #define MSK_CLR_DIR                     0xFFFFFF3F
+#define MSK_READ_PSIZE                  0x00000003
 
 /* For SxFCR */
 #define MSK_CLR_FTH                     0xFFFFFFFC
 
+#define MSK_SxCR_INTERRUPTS             ((1 << SxCR_TCIE) | (1 << SxCR_HTIE) | (1 << SxCR_TEIE) | (1 << SxCR_DMEIE))
+
 #define MSK_CHECK_STRAM_STATE           0x00000001
 #define MSK_STRAM_ENABLED               1
 #define MSK_STREAM_DISABLED             0
@@ -162,6 +210,27 @@ typedef struct
     u32 DMA_HIFCR;
 }DMARegs_t;
 
+typedef struct
+{
+    u32 destination;
+    u32 source;
+    u32 remainingBytes;
+    u32 chunkBytes;
+    u32 pattern;
+    dmaCallBack_t cbf;
+    u8 width;
+    u8 fixedPort;
+    volatile u8 active;
+}memJob_t;
+
+typedef struct
+{
+    dmaPingPongCallBack_t cbf;
+    u32 overruns;
+    volatile u8 softwareOwned[PING_PONG_BUFFERS];
+    volatile u8 active;
+}pingPong_t;
+
 extern void DMA1_Stream0_IRQHandler(void);
 extern void DMA1_Stream1_IRQHandler(void);
 extern void DMA1_Stream2_IRQHandler(void);
@@ -187,188 +256,238 @@ static dmaCallBack_t dma2TCCallBacks [TOT_STREAM_COUNTS] = {NULL};
 static dmaErrorCallBack_t dma1ErrorCallBacks [TOT_STREAM_COUNTS] = {NULL};
 static dmaErrorCallBack_t dma2ErrorCallBacks [TOT_STREAM_COUNTS] = {NULL};
 
+/* shift of stream flags inside LISR/LIFCR (streams 0:3) and HISR/HIFCR (streams 4:7) */
+static const u8 flagsShift [TOT_STREAM_COUNTS] = {0, 6, 16, 22, 0, 6, 16, 22};
+
+/* memory to memory jobs, only DMA2 can do memory to memory transfers */
+static memJob_t memJobs [TOT_STREAM_COUNTS];
+static pingPong_t pingPongs [DMA_COUNTS][TOT_STREAM_COUNTS];
+#if DMA_STATS_ENABLED
+static dmaStreamStats_t streamsStats [DMA_COUNTS][TOT_STREAM_COUNTS];
+#endif
+
 static void dmaHandler(u32 dmaBaseAdd, u8 streamIndex);
+static DMA_ErrorStatus_t startMemJob(u16 streamId, u32 destination, u32 source, u32 size, u8 fixedPort, dmaCallBack_t cbf);
+static void memJobStartChunk(u8 streamIndex);
+static void memJobHandler(u8 streamIndex, u32 flags);
+static void pingPongHandler(u32 dmaBaseAdd, u8 dmaIndex, u8 streamIndex);
+#if DMA_STATS_ENABLED
+static void statsOnEnable(u32 streamBase);
+static void statsOnFlags(u8 dmaIndex, u8 streamIndex, u32 flags);
+#endif
+static void resolveAutoTuning(const streamCfg_t* streamCfg, pu8 memoryBurstMode, pu8 peripheralBurstMode, pu16 fifoLevel, pu32 fcr);
+static u8 pickBurst(u8 sizeCode, u8 increment, u32 addresses, u32 totalBytes, u32 fifoBytes);
+static DMA_ErrorStatus_t checkFifoAndBurst(const streamCfg_t* streamCfg, u8 memoryBurstMode, u8 peripheralBurstMode, u16 fifoLevel, u32 fcr);
 static DMA_ErrorStatus_t checkValidData(u32 dmaId, u16 streamId);
 static DMA_ErrorStatus_t checkValidDataAndCanConfig(u32 dmaId, u16 streamId);
 
 DMA_ErrorStatus_t dma_streamInit(u32 dmaId, const streamCfg_t* streamCfg)
 {
-    DMA_ErrorStatus_t errorStatus = checkValidDataAndCanConfig(dmaId, streamCfg->streamId);
-    if(errorStatus == dma_retOk)
+    DMA_ErrorStatus_t errorStatus = dma_retNullPointer;
+    dmaStreamImage_t image;
+    if(streamCfg)
     {
-        u16 stream = streamCfg->streamId;
-        dmaId &= MSK_CLR_CHECK_VALID_DMA_ID;
-        stream &= MSK_CLR_CHECK_VALID_STREAM;
-        if(streamCfg->pripheralAddress)
+        errorStatus = checkValidDataAndCanConfig(dmaId, streamCfg->streamId);
+        if(errorStatus == dma_retOk)
         {
-            CAST_STREAM_REGS(dmaId + stream)->DMA_SxPAR = streamCfg->pripheralAddress;
-            if(streamCfg->memory0Address)
-            {
-                CAST_STREAM_REGS(dmaId + stream)->DMA_SxM0AR = streamCfg->memory0Address;
-                if((streamCfg->bufferMode & MSK_CHECK_VALID_BUFF_MODE) == MSK_VALID_BUFF_MODE)
-                {
-                    switch(streamCfg->bufferMode)
-                    {
-                        case bufferMode_Regular:
-                            CAST_STREAM_REGS(dmaId + stream)->DMA_SxCR &= ~(1 << SxCR_DBM);
-                            CAST_STREAM_REGS(dmaId + stream)->DMA_SxCR &= ~(1 << SxCR_CIRC);
-                            CAST_STREAM_REGS(dmaId + stream)->DMA_SxFCR |= (1 << SxFCR_DMDIS);
-                            break;
-                        case bufferMode_Double:
-                            if(streamCfg->memory1Address)
-                            {
-                                CAST_STREAM_REGS(dmaId + stream)->DMA_SxM1AR = streamCfg->memory1Address;
-                                CAST_STREAM_REGS(dmaId + stream)->DMA_SxCR |= (1 << SxCR_DBM);
-                                CAST_STREAM_REGS(dmaId + stream)->DMA_SxFCR &= ~(1 << SxFCR_DMDIS);
-                            }
-                            else
-                            {
-                                errorStatus = dma_retNullPointer;
-                            }
-                            break;
-                        case bufferMode_Circular:
-                            CAST_STREAM_REGS(dmaId + stream)->DMA_SxCR |= (1 << SxCR_CIRC);
-                            CAST_STREAM_REGS(dmaId + stream)->DMA_SxFCR &= ~(1 << SxFCR_DMDIS);
-                            break;
-                    }
-                    if(errorStatus != dma_retNullPointer)
-                    {
-                        if(streamCfg->dataItems >= MIN_VALID_DATA_ITEMS && streamCfg->dataItems <= MAX_VALID_DATA_ITEMS)
-                        {
-                            CAST_STREAM_REGS(dmaId + stream)->DMA_SxCR = streamCfg->dataItems;
-                            if((streamCfg->channelId & MSK_CHECK_VALID_CHANNEL) == MSK_VALID_CHANNEL)
-                            {
-                                CAST_STREAM_REGS(dmaId + stream)->DMA_SxCR &= MSK_CLR_CHSEL;
-                                CAST_STREAM_REGS(dmaId + stream)->DMA_SxCR |= (streamCfg->channelId & MSK_CLR_CHECK_VALID_CHANNEL) << SxCR_CHSEL_SHIFT;
-                                if((streamCfg->flowControl & MSK_CHECK_VALID_FLOW_CTRL) == MSK_VALID_FLOW_CTRL)
-                                {
-                                    if(streamCfg->flowControl == flowControl_DMA)
-                                    {
-                                        CAST_STREAM_REGS(dmaId + stream)->DMA_SxCR &= ~(1 << SxCR_PFCTRL);
-                                    }
-                                    else
-                                    {
-                                        CAST_STREAM_REGS(dmaId + stream)->DMA_SxCR |= (1 << SxCR_PFCTRL);
-                                    }
-                                    if((streamCfg->streamPriority & MSK_CHECK_VALID_PRIO) == MSK_VALID_PRIO)
-                                    {
-                                        CAST_STREAM_REGS(dmaId + stream)->DMA_SxCR &= MSK_CLR_PL;
-                                        CAST_STREAM_REGS(dmaId + stream)->DMA_SxCR |= (streamCfg->streamPriority & MSK_CLR_CHECK_VALID_PRIO) << SxCR_PRIO_SHIFT;
-                                        if((streamCfg->fifoLevel & MSK_CHECK_VALID_FIFO_LVL) == MSK_VALID_FIFO_LVL)
-                                        {
-                                            CAST_STREAM_REGS(dmaId + stream)->DMA_SxFCR &= MSK_CLR_FTH;
-                                            CAST_STREAM_REGS(dmaId + stream)->DMA_SxFCR |= (streamCfg->fifoLevel & MSK_CLR_CHECK_VALID_FIFO_LVL);
-                                            if((streamCfg->streamDirection & MSK_CHECK_VALID_STREAM_DIR) == MSK_VALID_STREAM_DIR)
-                                            {
-                                                CAST_STREAM_REGS(dmaId + stream)->DMA_SxCR &= MSK_CLR_DIR;
-                                                CAST_STREAM_REGS(dmaId + stream)->DMA_SxCR |= (streamCfg->streamDirection & MSK_CLR_CHECK_VALID_DIR) << SxCR_DIR_SHIFT;
-                                                if((streamCfg->peripheralIncMode & MSK_CHECK_VALID_INC_MODE) == MSK_VALID_INC_MODE
-                                                    && (streamCfg->memoryIncMode & MSK_CHECK_VALID_INC_MODE) == MSK_VALID_INC_MODE)
-                                                {
-                                                    if(streamCfg->peripheralIncMode == peripheralIncMode_Fixed)
-                                                    {
-                                                        CAST_STREAM_REGS(dmaId + stream)->DMA_SxCR &= ~(1 << SxCR_PINC);
-                                                    }
-                                                    else if(streamCfg->peripheralIncMode == peripheralIncMode_IncBySize)
-                                                    {
-                                                        CAST_STREAM_REGS(dmaId + stream)->DMA_SxCR |= (1 << SxCR_PINC);
-                                                        CAST_STREAM_REGS(dmaId + stream)->DMA_SxCR &= ~(1 << SxCR_PINCOS);
-                                                    }
-                                                    else
-                                                    {
-                                                        CAST_STREAM_REGS(dmaId + stream)->DMA_SxCR |= (1 << SxCR_PINC);
-                                                        CAST_STREAM_REGS(dmaId + stream)->DMA_SxCR |= (1 << SxCR_PINCOS);
-                                                    }
-
-                                                    if(streamCfg->memoryIncMode == memoryIncMode_Fixed)
-                                                    {
-                                                        CAST_STREAM_REGS(dmaId + stream)->DMA_SxCR &= ~(1 << SxCR_MINC);
-                                                    }
-                                                    else
-                                                    {
-                                                        CAST_STREAM_REGS(dmaId + stream)->DMA_SxCR |= (1 << SxCR_MINC);
-                                                    }
-                                                    if((streamCfg->peripheralSize & MSK_CHECK_VALID_DSIZE) == MSK_VALID_DSIZE
-                                                        && (streamCfg->memorySize & MSK_CHECK_VALID_DSIZE) == MSK_VALID_DSIZE)
-                                                    {
-                                                        CAST_STREAM_REGS(dmaId + stream)->DMA_SxCR &= MSK_CLR_MSIZE;
-                                                        CAST_STREAM_REGS(dmaId + stream)->DMA_SxCR |= (streamCfg->memorySize & MSK_CLR_CHECK_VALID_DSIZE) << SxCR_MSIZE_SHIFT;
-                                                        CAST_STREAM_REGS(dmaId + stream)->DMA_SxCR &= MSK_CLR_PSIZE;
-                                                        CAST_STREAM_REGS(dmaId + stream)->DMA_SxCR |= (streamCfg->peripheralSize & MSK_CLR_CHECK_VALID_DSIZE) << SxCR_PSIZE_SHIFT;
-                                                        if((streamCfg->peripheralBurstMode & MSK_CHECK_VALID_PRI_BURST) == MSK_VALID_PRI_BURST)
-                                                        {
-                                                            CAST_STREAM_REGS(dmaId + stream)->DMA_SxCR &= MSK_CLR_PBURST;
-                                                            CAST_STREAM_REGS(dmaId + stream)->DMA_SxCR |= (streamCfg->peripheralBurstMode & MSK_CLR_CHECK_VALID_PRI_BURST) << SxCR_PBURST_SHIFT;
-                                                            if((streamCfg->memoryBurstMode & MSK_CHECK_VALID_MEM_BURST) == MSK_VALID_MEM_BURST)
-                                                            {
-                                                                CAST_STREAM_REGS(dmaId + stream)->DMA_SxCR &= MSK_CLR_MBURST;
-                                                                CAST_STREAM_REGS(dmaId + stream)->DMA_SxCR |= (streamCfg->memoryBurstMode & MSK_CLR_CHECK_VALID_MEM_BURST) << SxCR_MBURST_SHIFT;
-                                                                errorStatus = dma_retOk;
-                                                            }
-                                                            else
-                                                            {
-                                                                errorStatus = dma_retInvalidMemoryBurstMode;
-                                                            }
-                                                        }
-                                                        else
-                                                        {
-                                                            errorStatus = dma_retInvalidPeripheralBurstMode;
-                                                        }
-                                                    }
-                                                    else
-                                                    {
-                                                        errorStatus = dma_retInvalidDataSize;
-                                                    }
-                                                }
-                                                else
-                                                {
-                                                    errorStatus = dma_retInvalidIncrementMode;
-                                                }
-                                            }
-                                            else
-                                            {
-                                                errorStatus = dma_retInvalidStreamDirection;
-                                            }
-                                        }
-                                        else
-                                        {
-                                            errorStatus = dma_retInvalidFifoLevel;
-                                        }
-                                    }
-                                    else
-                                    {
-                                        errorStatus = dma_retInvalidStreamPriority;
-                                    }
-                                }
-                                else
-                                {
-                                    errorStatus = dma_retInvalidFlowControlOption;
-                                }
-                            }
-                            else
-                            {
-                                errorStatus = dma_retInvalidChannelId;
-                            }
-                        }
-                        else
-                        {
-                            errorStatus = dma_retInvalidDataItems;
-                        }
-                    }
-                }
-                else
-                {
-                    errorStatus = dma_retInvalidBufferMode;
-                }
-            }
-            else
+            errorStatus = dma_prepareStream(dmaId, streamCfg, &image);
+        }
+        if(errorStatus == dma_retOk)
+        {
+            volatile StreamRegs_t* const streamRegs = CAST_STREAM_REGS(image.streamBase);
+            /* interrupts enabled by their own APIs are kept */
+            streamRegs->DMA_SxCR = image.cr | (streamRegs->DMA_SxCR & MSK_SxCR_INTERRUPTS);
+            streamRegs->DMA_SxPAR = image.par;
+            streamRegs->DMA_SxM0AR = image.m0ar;
+            if(image.cr & (1 << SxCR_DBM))
             {
-                errorStatus = dma_retNullPointer;
+                streamRegs->DMA_SxM1AR = image.m1ar;
             }
+            streamRegs->DMA_SxNDTR = image.ndtr;
+            streamRegs->DMA_SxFCR = image.fcr | (streamRegs->DMA_SxFCR & (1 << SxFCR_FEIE));
+        }
+    }
+    return errorStatus;
+}
+
+DMA_ErrorStatus_t dma_prepareStream(u32 dmaId, const streamCfg_t* streamCfg, dmaStreamImage_t* image)
+{
+    DMA_ErrorStatus_t errorStatus = dma_retNullPointer;
+    if(streamCfg && image)
+    {
+        errorStatus = checkValidData(dmaId, streamCfg->streamId);
+    }
+    if(errorStatus != dma_retOk)
+    {
+        /* NULL pointer, invalid dmaId or invalid streamId */
+    }
+    else if(!streamCfg->pripheralAddress || !streamCfg->memory0Address)
+    {
+        errorStatus = dma_retNullPointer;
+    }
+    else if((streamCfg->bufferMode & MSK_CHECK_VALID_BUFF_MODE) != MSK_VALID_BUFF_MODE)
+    {
+        errorStatus = dma_retInvalidBufferMode;
+    }
+    else if(streamCfg->bufferMode == bufferMode_Double && !streamCfg->memory1Address)
+    {
+        errorStatus = dma_retNullPointer;
+    }
+    else if(streamCfg->dataItems < MIN_VALID_DATA_ITEMS)
+    {
+        errorStatus = dma_retInvalidDataItems;
+    }
+    else if((streamCfg->channelId & MSK_CHECK_VALID_CHANNEL) != MSK_VALID_CHANNEL)
+    {
+        errorStatus = dma_retInvalidChannelId;
+    }
+    else if((streamCfg->flowControl & MSK_CHECK_VALID_FLOW_CTRL) != MSK_VALID_FLOW_CTRL)
+    {
+        errorStatus = dma_retInvalidFlowControlOption;
+    }
+    else if((streamCfg->streamPriority & MSK_CHECK_VALID_PRIO) != MSK_VALID_PRIO)
+    {
+        errorStatus = dma_retInvalidStreamPriority;
+    }
+    else if((streamCfg->fifoLevel & MSK_CHECK_VALID_FIFO_LVL) != MSK_VALID_FIFO_LVL)
+    {
+        errorStatus = dma_retInvalidFifoLevel;
+    }
+    else if((streamCfg->streamDirection & MSK_CHECK_VALID_STREAM_DIR) != MSK_VALID_STREAM_DIR)
+    {
+        errorStatus = dma_retInvalidStreamDirection;
+    }
+    else if((streamCfg->peripheralIncMode & MSK_CHECK_VALID_INC_MODE) != MSK_VALID_INC_MODE
+            || (streamCfg->memoryIncMode & MSK_CHECK_VALID_INC_MODE) != MSK_VALID_INC_MODE)
+    {
+        errorStatus = dma_retInvalidIncrementMode;
+    }
+    else if((streamCfg->peripheralSize & MSK_CHECK_VALID_DSIZE) != MSK_VALID_DSIZE
+            || (streamCfg->memorySize & MSK_CHECK_VALID_DSIZE) != MSK_VALID_DSIZE)
+    {
+        errorStatus = dma_retInvalidDataSize;
+    }
+    else if((streamCfg->peripheralBurstMode & MSK_CHECK_VALID_PRI_BURST) != MSK_VALID_PRI_BURST)
+    {
+        errorStatus = dma_retInvalidPeripheralBurstMode;
+    }
+    else if((streamCfg->memoryBurstMode & MSK_CHECK_VALID_MEM_BURST) != MSK_VALID_MEM_BURST)
+    {
+        errorStatus = dma_retInvalidMemoryBurstMode;
+    }
+    else
+    {
+        u32 cr = 0, fcr = 0;
+        u8 streamIndex = GET_STREAM_INDEX(streamCfg->streamId & MSK_CLR_CHECK_VALID_STREAM);
+        u8 memoryBurstMode = streamCfg->memoryBurstMode;
+        u8 peripheralBurstMode = streamCfg->peripheralBurstMode;
+        u16 fifoLevel = streamCfg->fifoLevel;
+        dmaId &= MSK_CLR_CHECK_VALID_DMA_ID;
+        switch(streamCfg->bufferMode)
+        {
+            case bufferMode_Regular:
+                fcr |= (1 << SxFCR_DMDIS);
+                break;
+            case bufferMode_Double:
+                cr |= (1 << SxCR_DBM);
+                break;
+            case bufferMode_Circular:
+                cr |= (1 << SxCR_CIRC);
+                break;
+        }
+        resolveAutoTuning(streamCfg, &memoryBurstMode, &peripheralBurstMode, &fifoLevel, &fcr);
+        cr |= (streamCfg->channelId & MSK_CLR_CHECK_VALID_CHANNEL) << SxCR_CHSEL_SHIFT;
+        if(streamCfg->flowControl == flowControl_Peripheral)
+        {
+            cr |= (1 << SxCR_PFCTRL);
+        }
+        cr |= (streamCfg->streamPriority & MSK_CLR_CHECK_VALID_PRIO) << SxCR_PRIO_SHIFT;
+        fcr |= (fifoLevel & MSK_CLR_CHECK_VALID_FIFO_LVL);
+        cr |= (streamCfg->streamDirection & MSK_CLR_CHECK_VALID_DIR) << SxCR_DIR_SHIFT;
+        if(streamCfg->peripheralIncMode == peripheralIncMode_IncBySize)
+        {
+            cr |= (1 << SxCR_PINC);
+        }
+        else if(streamCfg->peripheralIncMode == peripheralIncMode_Aligned)
+        {
+            cr |= (1 << SxCR_PINC) | (1 << SxCR_PINCOS);
+        }
+        if(streamCfg->memoryIncMode == memoryIncMode_IncBySize)
+        {
+            cr |= (1 << SxCR_MINC);
+        }
+        cr |= (streamCfg->memorySize & MSK_CLR_CHECK_VALID_DSIZE) << SxCR_MSIZE_SHIFT;
+        cr |= (streamCfg->peripheralSize & MSK_CLR_CHECK_VALID_DSIZE) << SxCR_PSIZE_SHIFT;
+        cr |= (peripheralBurstMode & MSK_CLR_CHECK_VALID_PRI_BURST) << SxCR_PBURST_SHIFT;
+        cr |= (memoryBurstMode & MSK_CLR_CHECK_VALID_MEM_BURST) << SxCR_MBURST_SHIFT;
+        errorStatus = checkFifoAndBurst(streamCfg, memoryBurstMode, peripheralBurstMode, fifoLevel, fcr);
+        if(errorStatus == dma_retOk)
+        {
+            image->streamBase = GET_STREAM_BASE(dmaId, streamIndex);
+            image->flagsClearAddress = (u32) ((streamIndex < LOW_REG_STREAMS_COUNT) ? &CAST_DMA_REGS(dmaId)->DMA_LIFCR 
+                                                                                   : &CAST_DMA_REGS(dmaId)->DMA_HIFCR);
+            image->flagsClearMask = MSK_STREAM_ALL_FLAGS << flagsShift[streamIndex];
+            image->cr = cr;
+            image->ndtr = streamCfg->dataItems;
+            image->par = (u32) streamCfg->pripheralAddress;
+            image->m0ar = (u32) streamCfg->memory0Address;
+            image->m1ar = (u32) streamCfg->memory1Address;
+            image->fcr = fcr;
+        }
+    }
+    return errorStatus;
+}
+
+DMA_ErrorStatus_t dma_armStream(const dmaStreamImage_t* image)
+{
+    DMA_ErrorStatus_t errorStatus = dma_retNullPointer;
+    if(image)
+    {
+        volatile StreamRegs_t* const streamRegs = CAST_STREAM_REGS(image->streamBase);
+        if(streamRegs->DMA_SxCR & (1 << SxCR_EN))
+        {
+            errorStatus = dma_retConfigWhileEnabledStream;
         }
         else
         {
-            errorStatus = dma_retNullPointer;
+            *((volatile u32*) image->flagsClearAddress) = image->flagsClearMask;
+            streamRegs->DMA_SxPAR = image->par;
+            streamRegs->DMA_SxM0AR = image->m0ar;
+            streamRegs->DMA_SxM1AR = image->m1ar;
+            streamRegs->DMA_SxNDTR = image->ndtr;
+            streamRegs->DMA_SxFCR = image->fcr | (streamRegs->DMA_SxFCR & (1 << SxFCR_FEIE));
+            streamRegs->DMA_SxCR = image->cr | (streamRegs->DMA_SxCR & MSK_SxCR_INTERRUPTS) | (1 << SxCR_EN);
+            STATS_ON_ENABLE(image->streamBase);
+            errorStatus = dma_retOk;
+        }
+    }
+    return errorStatus;
+}
+
+DMA_ErrorStatus_t dma_rearmStream(dmaStreamImage_t* image, u32* memoryAddress, u16 dataItems)
+{
+    DMA_ErrorStatus_t errorStatus = dma_retNullPointer;
+    if(image && memoryAddress)
+    {
+        volatile StreamRegs_t* const streamRegs = CAST_STREAM_REGS(image->streamBase);
+        if(streamRegs->DMA_SxCR & (1 << SxCR_EN))
+        {
+            errorStatus = dma_retConfigWhileEnabledStream;
+        }
+        else if(dataItems < MIN_VALID_DATA_ITEMS)
+        {
+            errorStatus = dma_retInvalidDataItems;
+        }
+        else
+        {
+            image->m0ar = (u32) memoryAddress;
+            image->ndtr = dataItems;
+            *((volatile u32*) image->flagsClearAddress) = image->flagsClearMask;
+            streamRegs->DMA_SxM0AR = image->m0ar;
+            streamRegs->DMA_SxNDTR = image->ndtr;
+            streamRegs->DMA_SxCR |= (1 << SxCR_EN);
+            STATS_ON_ENABLE(image->streamBase);
+            errorStatus = dma_retOk;
         }
     }
     return errorStatus;
@@ -379,7 +498,10 @@ DMA_ErrorStatus_t dma_enableStream(u32 dmaId, u16 streamId)
     DMA_ErrorStatus_t errorStatus = checkValidDataAndCanConfig(dmaId, streamId);
     if(errorStatus == dma_retOk)
     {
+        dmaId &= MSK_CLR_CHECK_VALID_DMA_ID;
+        streamId &= MSK_CLR_CHECK_VALID_STREAM;
         CAST_STREAM_REGS(dmaId + streamId)->DMA_SxCR |= (1 << SxCR_EN);
+        STATS_ON_ENABLE(dmaId + streamId);
     }
     else
     {
@@ -430,7 +552,7 @@ DMA_ErrorStatus_t dma_setStreamPriority(u32 dmaId, u16 streamId, u8 streamPriori
         if((streamPriority & MSK_CHECK_VALID_PRIO) == MSK_VALID_PRIO)
         {
             dmaId &= MSK_CLR_CHECK_VALID_DMA_ID;
-            streamId &= MSK_CHECK_VALID_STREAM;
+            streamId &= MSK_CLR_CHECK_VALID_STREAM;
             CAST_STREAM_REGS(dmaId + streamId)->DMA_SxCR &= MSK_CLR_PL;
             CAST_STREAM_REGS(dmaId + streamId)->DMA_SxCR |= (streamPriority & MSK_CLR_CHECK_VALID_PRIO) << SxCR_PRIO_SHIFT;
             errorStatus = dma_retOk;
@@ -473,7 +595,7 @@ DMA_ErrorStatus_t dma_setDataItems(u32 dmaId, u16 streamId, u16 dataItems)
         {
             dmaId &= MSK_CLR_CHECK_VALID_DMA_ID;
             streamId &= MSK_CLR_CHECK_VALID_STREAM;
-            CAST_STREAM_REGS(dmaId + streamId)->DMA_SxCR = dataItems;
+            CAST_STREAM_REGS(dmaId + streamId)->DMA_SxNDTR = dataItems;
             errorStatus = dma_retOk;
         }
         else
@@ -492,7 +614,7 @@ DMA_ErrorStatus_t dma_setFlowControl(u32 dmaId, u16 streamId, u8 flowControl)
         if((flowControl & MSK_CHECK_VALID_FLOW_CTRL) == MSK_VALID_FLOW_CTRL)
         {
             dmaId &= MSK_CLR_CHECK_VALID_DMA_ID;
-            streamId &= MSK_CHECK_VALID_STREAM;
+            streamId &= MSK_CLR_CHECK_VALID_STREAM;
             if(flowControl == flowControl_DMA)
             {
                 CAST_STREAM_REGS(dmaId + streamId)->DMA_SxCR &= ~(1 << SxCR_PFCTRL);
@@ -519,7 +641,7 @@ DMA_ErrorStatus_t dma_setChannelId(u32 dmaId, u16 streamId, u8 channelId)
         if((channelId & MSK_CHECK_VALID_CHANNEL) == MSK_VALID_CHANNEL)
         {
             dmaId &= MSK_CLR_CHECK_VALID_DMA_ID;
-            streamId &= MSK_CHECK_VALID_STREAM;
+            streamId &= MSK_CLR_CHECK_VALID_STREAM;
             CAST_STREAM_REGS(dmaId + streamId)->DMA_SxCR &= MSK_CLR_CHSEL;
             CAST_STREAM_REGS(dmaId + streamId)->DMA_SxCR |= (channelId & MSK_CLR_CHECK_VALID_CHANNEL) << SxCR_CHSEL_SHIFT;
             errorStatus = dma_retOk;
@@ -540,7 +662,7 @@ DMA_ErrorStatus_t dma_setPeripheralSize(u32 dmaId, u16 streamId, u8 peripheralSi
         if((peripheralSize & MSK_CHECK_VALID_DSIZE) == MSK_VALID_DSIZE)
         {
             dmaId &= MSK_CLR_CHECK_VALID_DMA_ID;
-            streamId &= MSK_CHECK_VALID_STREAM;
+            streamId &= MSK_CLR_CHECK_VALID_STREAM;
             CAST_STREAM_REGS(dmaId + streamId)->DMA_SxCR &= MSK_CLR_PSIZE;
             CAST_STREAM_REGS(dmaId + streamId)->DMA_SxCR |= (peripheralSize & MSK_CLR_CHECK_VALID_DSIZE) << SxCR_PSIZE_SHIFT;
             errorStatus = dma_retOk;
@@ -561,7 +683,7 @@ DMA_ErrorStatus_t dma_setMemorySize(u32 dmaId, u16 streamId, u8 memorySize)
         if((memorySize & MSK_CHECK_VALID_DSIZE) == MSK_VALID_DSIZE)
         {
             dmaId &= MSK_CLR_CHECK_VALID_DMA_ID;
-            streamId &= MSK_CHECK_VALID_STREAM;
+            streamId &= MSK_CLR_CHECK_VALID_STREAM;
             CAST_STREAM_REGS(dmaId + streamId)->DMA_SxCR &= MSK_CLR_MSIZE;
             CAST_STREAM_REGS(dmaId + streamId)->DMA_SxCR |= (memorySize & MSK_CLR_CHECK_VALID_DSIZE) << SxCR_MSIZE_SHIFT;
             errorStatus = dma_retOk;
@@ -582,7 +704,7 @@ DMA_ErrorStatus_t dma_setPeripheralAddress(u32 dmaId, u16 streamId, u32* periphe
         if(peripheralAddress)
         {
             dmaId &= MSK_CLR_CHECK_VALID_DMA_ID;
-            streamId &= MSK_CHECK_VALID_STREAM;
+            streamId &= MSK_CLR_CHECK_VALID_STREAM;
             CAST_STREAM_REGS(dmaId + streamId)->DMA_SxPAR = peripheralAddress;
             errorStatus = dma_retOk;
         }
@@ -602,7 +724,7 @@ DMA_ErrorStatus_t dma_setMemory0Address(u32 dmaId, u16 streamId, u32* memory0Add
         if(memory0Address)
         {
             dmaId &= MSK_CLR_CHECK_VALID_DMA_ID;
-            streamId &= MSK_CHECK_VALID_STREAM;
+            streamId &= MSK_CLR_CHECK_VALID_STREAM;
             CAST_STREAM_REGS(dmaId + streamId)->DMA_SxM0AR = memory0Address;
             errorStatus = dma_retOk;
         }
@@ -622,7 +744,7 @@ DMA_ErrorStatus_t dma_setMemory1Address(u32 dmaId, u16 streamId, u32* memory1Add
         if(memory1Address)
         {
             dmaId &= MSK_CLR_CHECK_VALID_DMA_ID;
-            streamId &= MSK_CHECK_VALID_STREAM;
+            streamId &= MSK_CLR_CHECK_VALID_STREAM;
             CAST_STREAM_REGS(dmaId + streamId)->DMA_SxM1AR = memory1Address;
             errorStatus = dma_retOk;
         }
@@ -674,6 +796,8 @@ DMA_ErrorStatus_t dma_setBufferMode(u32 dmaId, u16 streamId, u8 bufferMode)
     {
         if((bufferMode & MSK_CHECK_VALID_BUFF_MODE) == MSK_VALID_BUFF_MODE)
         {
+            dmaId &= MSK_CLR_CHECK_VALID_DMA_ID;
+            streamId &= MSK_CLR_CHECK_VALID_STREAM;
             switch(bufferMode)
             {
                 case bufferMode_Regular:
@@ -928,387 +1052,699 @@ DMA_ErrorStatus_t dma_registerErrorsCallback(u32 dmaId, u16 streamId, dmaErrorCa
     return errorStatus;
 }
 
-static DMA_ErrorStatus_t checkValidData(u32 dmaId, u16 streamId)
+DMA_ErrorStatus_t dma_memcpyAsync(u16 streamId, void* destination, const void* source, u32 size, dmaCallBack_t cbf)
 {
-    DMA_ErrorStatus_t errorStatus = dma_retNotOk;
-    if((dmaId & MSK_CHECK_VALID_DMA_ID) == MSK_VALID_DMA_ID)
+    DMA_ErrorStatus_t errorStatus = checkValidDataAndCanConfig(dmaId_2, streamId);
+    if(errorStatus == dma_retOk)
     {
-        if((streamId & MSK_CHECK_VALID_STREAM) == MSK_VALID_STREAM)
+        if(destination && source && cbf)
         {
-            errorStatus = dma_retOk;
+            errorStatus = startMemJob(streamId, (u32) destination, (u32) source, size, MEM_JOB_INC_BOTH, cbf);
         }
         else
         {
-            errorStatus = dma_retInvalidStreamId;
+            errorStatus = dma_retNullPointer;
         }
     }
-    else
-    {
-        errorStatus = dma_retInvalidDMAId;
-    }
     return errorStatus;
 }
 
-static DMA_ErrorStatus_t checkValidDataAndCanConfig(u32 dmaId, u16 streamId)
+DMA_ErrorStatus_t dma_feedRegisterAsync(u16 streamId, volatile u32* dataRegister, const void* source, u32 size, dmaCallBack_t cbf)
 {
-    DMA_ErrorStatus_t errorStatus = checkValidData(dmaId, streamId);
+    DMA_ErrorStatus_t errorStatus = checkValidDataAndCanConfig(dmaId_2, streamId);
     if(errorStatus == dma_retOk)
     {
-        dmaId &= MSK_CLR_CHECK_VALID_DMA_ID;
-        streamId &= MSK_CLR_CHECK_VALID_STREAM;
-        if((CAST_STREAM_REGS(dmaId + streamId)->DMA_SxCR & MSK_CHECK_STRAM_STATE) == MSK_STREAM_DISABLED)
+        if(dataRegister && source && cbf)
         {
-            errorStatus = dma_retConfigWhileEnabledStream;
+            errorStatus = startMemJob(streamId, (u32) dataRegister, (u32) source, size, MEM_JOB_FIXED_DESTINATION, cbf);
         }
         else
         {
-            errorStatus = dma_retOk;
+            errorStatus = dma_retNullPointer;
         }
     }
     return errorStatus;
 }
 
-void dmaHandler(u32 dmaBaseAdd, u8 streamIndex)
+DMA_ErrorStatus_t dma_memsetAsync(u16 streamId, void* destination, u8 value, u32 size, dmaCallBack_t cbf)
 {
-    switch(streamIndex)
+    DMA_ErrorStatus_t errorStatus = checkValidDataAndCanConfig(dmaId_2, streamId);
+    if(errorStatus == dma_retOk)
     {
-        case 0:
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_LISR & MSK_HTIF04)
-            {
-                if(dma1HCCallBacks[streamIndex])
-                {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_LIFCR &= ~MSK_HTIF04;
-                    dma1HCCallBacks[streamIndex]();
-                }
-            }
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_LISR & MSK_TCIF04)
-            {
-                if(dma1TCCallBacks[streamIndex])
-                {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_LIFCR &= MSK_TCIF04;
-                    dma1TCCallBacks[streamIndex]();
-                }
-            }
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_LISR & MSK_FEIF04)
-            {
-                if(dma1ErrorCallBacks[streamIndex])
-                {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_LIFCR &= MSK_FEIF04;
-                    dma1ErrorCallBacks[streamIndex] (dma_retFIFOError);
-                }
-            }
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_LISR & MSK_TEIF04)
-            {
-                if(dma1ErrorCallBacks[streamIndex])
-                {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_LIFCR &= MSK_TEIF04;
-                    dma1ErrorCallBacks[streamIndex] (dma_retTransferError);
-                }
-            }
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_LISR & MSK_DMEIF04)
-            {
-                if(dma1ErrorCallBacks[streamIndex])
-                {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_LIFCR &= MSK_DMEIF04;
-                    dma1ErrorCallBacks[streamIndex] (dma_retDirectModeError);
-                }
-            }
-            break;
-        case 1:
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_LISR & MSK_HTIF15)
-            {
-                if(dma1HCCallBacks[streamIndex])
-                {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_LIFCR &= ~MSK_HTIF15;
-                    dma1HCCallBacks[streamIndex]();
-                }
-            }
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_LISR & MSK_TCIF15)
-            {
-                if(dma1TCCallBacks[streamIndex])
-                {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_LIFCR &= MSK_TCIF15;
-                    dma1TCCallBacks[streamIndex]();
-                }
-            }
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_LISR & MSK_FEIF15)
-            {
-                if(dma1ErrorCallBacks[streamIndex])
-                {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_LIFCR &= MSK_FEIF15;
-                    dma1ErrorCallBacks[streamIndex] (dma_retFIFOError);
-                }
-            }
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_LISR & MSK_TEIF15)
-            {
-                if(dma1ErrorCallBacks[streamIndex])
-                {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_LIFCR &= MSK_TEIF15;
-                    dma1ErrorCallBacks[streamIndex] (dma_retTransferError);
-                }
-            }
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_LISR & MSK_DMEIF15)
-            {
-                if(dma1ErrorCallBacks[streamIndex])
-                {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_LIFCR &= MSK_DMEIF15;
-                    dma1ErrorCallBacks[streamIndex] (dma_retDirectModeError);
-                }
-            }
-            break;
-        case 2:
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_LISR & MSK_HTIF26)
-            {
-                if(dma1HCCallBacks[streamIndex])
-                {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_LIFCR &= ~MSK_HTIF26;
-                    dma1HCCallBacks[streamIndex]();
-                }
-            }
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_LISR & MSK_TCIF26)
+        if(destination && cbf)
+        {
+            u8 streamIndex = GET_STREAM_INDEX(streamId & MSK_CLR_CHECK_VALID_STREAM);
+            if(!memJobs[streamIndex].active)
             {
-                if(dma1TCCallBacks[streamIndex])
-                {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_LIFCR &= MSK_TCIF26;
-                    dma1TCCallBacks[streamIndex]();
-                }
+                /* the source is a fixed word holding the value in every byte lane */
+                memJobs[streamIndex].pattern = (u32) value * 0x01010101;
             }
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_LISR & MSK_FEIF26)
+            errorStatus = startMemJob(streamId, (u32) destination, (u32) &memJobs[streamIndex].pattern, size, MEM_JOB_FIXED_SOURCE, cbf);
+        }
+        else
+        {
+            errorStatus = dma_retNullPointer;
+        }
+    }
+    return errorStatus;
+}
+
+DMA_ErrorStatus_t dma_pingPongStart(u32 dmaId, const streamCfg_t* streamCfg, dmaPingPongCallBack_t cbf)
+{
+    DMA_ErrorStatus_t errorStatus = dma_retNotOk;
+    if(streamCfg && cbf)
+    {
+        if(streamCfg->bufferMode == bufferMode_Double)
+        {
+            errorStatus = dma_streamInit(dmaId, streamCfg);
+            if(errorStatus == dma_retOk)
             {
-                if(dma1ErrorCallBacks[streamIndex])
+                pingPong_t* pingPong = &pingPongs[GET_DMA_INDEX(dmaId)][GET_STREAM_INDEX(streamCfg->streamId & MSK_CLR_CHECK_VALID_STREAM)];
+                pingPong->cbf = cbf;
+                pingPong->overruns = 0;
+                pingPong->softwareOwned[0] = 0;
+                pingPong->softwareOwned[1] = 0;
+                pingPong->active = 1;
+                errorStatus = dma_enableTransferInterrupt(dmaId, streamCfg->streamId);
+                if(errorStatus == dma_retOk)
                 {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_LIFCR &= MSK_FEIF26;
-                    dma1ErrorCallBacks[streamIndex] (dma_retFIFOError);
+                    errorStatus = dma_enableStream(dmaId, streamCfg->streamId);
                 }
             }
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_LISR & MSK_TEIF26)
+        }
+        else
+        {
+            errorStatus = dma_retInvalidBufferMode;
+        }
+    }
+    else
+    {
+        errorStatus = dma_retNullPointer;
+    }
+    return errorStatus;
+}
+
+DMA_ErrorStatus_t dma_pingPongStop(u32 dmaId, u16 streamId)
+{
+    DMA_ErrorStatus_t errorStatus = checkValidData(dmaId, streamId);
+    if(errorStatus == dma_retOk)
+    {
+        pingPongs[GET_DMA_INDEX(dmaId)][GET_STREAM_INDEX(streamId & MSK_CLR_CHECK_VALID_STREAM)].active = 0;
+        errorStatus = dma_disableStream(dmaId, streamId);
+        if(errorStatus == dma_retStreamIsDisabled)
+        {
+            errorStatus = dma_retOk;
+        }
+    }
+    return errorStatus;
+}
+
+DMA_ErrorStatus_t dma_pingPongRelease(u32 dmaId, u16 streamId, u8 bufferIndex)
+{
+    DMA_ErrorStatus_t errorStatus = checkValidData(dmaId, streamId);
+    if(errorStatus == dma_retOk)
+    {
+        if(bufferIndex < PING_PONG_BUFFERS)
+        {
+            pingPongs[GET_DMA_INDEX(dmaId)][GET_STREAM_INDEX(streamId & MSK_CLR_CHECK_VALID_STREAM)].softwareOwned[bufferIndex] = 0;
+            errorStatus = dma_retOk;
+        }
+        else
+        {
+            errorStatus = dma_retInvalidBufferIndex;
+        }
+    }
+    return errorStatus;
+}
+
+DMA_ErrorStatus_t dma_pingPongSetIdleBuffer(u32 dmaId, u16 streamId, u8 bufferIndex, u32* address)
+{
+    DMA_ErrorStatus_t errorStatus = checkValidData(dmaId, streamId);
+    if(errorStatus == dma_retOk)
+    {
+        if(!address)
+        {
+            errorStatus = dma_retNullPointer;
+        }
+        else if(bufferIndex >= PING_PONG_BUFFERS)
+        {
+            errorStatus = dma_retInvalidBufferIndex;
+        }
+        else
+        {
+            u8 dmaIndex = GET_DMA_INDEX(dmaId);
+            dmaId &= MSK_CLR_CHECK_VALID_DMA_ID;
+            streamId &= MSK_CLR_CHECK_VALID_STREAM;
+            /* memory0 address can be written only while the hardware targets memory1 and vice versa */
+            if(pingPongs[dmaIndex][GET_STREAM_INDEX(streamId)].softwareOwned[bufferIndex]
+                && ((CAST_STREAM_REGS(dmaId + streamId)->DMA_SxCR >> SxCR_CT) & 1) != bufferIndex)
             {
-                if(dma1ErrorCallBacks[streamIndex])
+                if(bufferIndex == 0)
                 {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_LIFCR &= MSK_TEIF26;
-                    dma1ErrorCallBacks[streamIndex] (dma_retTransferError);
+                    CAST_STREAM_REGS(dmaId + streamId)->DMA_SxM0AR = (u32) address;
                 }
-            }
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_LISR & MSK_DMEIF26)
-            {
-                if(dma1ErrorCallBacks[streamIndex])
+                else
                 {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_LIFCR &= MSK_DMEIF26;
-                    dma1ErrorCallBacks[streamIndex] (dma_retDirectModeError);
+                    CAST_STREAM_REGS(dmaId + streamId)->DMA_SxM1AR = (u32) address;
                 }
+                errorStatus = dma_retOk;
             }
-            break;
-        case 3:
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_LISR & MSK_HTIF37)
+            else
             {
-                if(dma1HCCallBacks[streamIndex])
-                {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_LIFCR &= ~MSK_HTIF37;
-                    dma1HCCallBacks[streamIndex]();
-                }
+                errorStatus = dma_retConfigWhileEnabledStream;
             }
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_LISR & MSK_TCIF37)
-            {
-                if(dma1TCCallBacks[streamIndex])
-                {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_LIFCR &= MSK_TCIF37;
-                    dma1TCCallBacks[streamIndex]();
-                }
-            }
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_LISR & MSK_FEIF37)
-            {
-                if(dma1ErrorCallBacks[streamIndex])
-                {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_LIFCR &= MSK_FEIF37;
-                    dma1ErrorCallBacks[streamIndex] (dma_retFIFOError);
-                }
-            }
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_LISR & MSK_TEIF37)
-            {
-                if(dma1ErrorCallBacks[streamIndex])
-                {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_LIFCR &= MSK_TEIF37;
-                    dma1ErrorCallBacks[streamIndex] (dma_retTransferError);
-                }
-            }
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_LISR & MSK_DMEIF37)
-            {
-                if(dma1ErrorCallBacks[streamIndex])
-                {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_LIFCR &= MSK_DMEIF37;
-                    dma1ErrorCallBacks[streamIndex] (dma_retDirectModeError);
-                }
-            }
-            break;
-        case 4:
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_HISR & MSK_HTIF04)
-            {
-                if(dma1HCCallBacks[streamIndex])
-                {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_HIFCR &= ~MSK_HTIF04;
-                    dma1HCCallBacks[streamIndex]();
-                }
-            }
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_HISR & MSK_TCIF04)
-            {
-                if(dma1TCCallBacks[streamIndex])
-                {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_HIFCR &= MSK_TCIF04;
-                    dma1TCCallBacks[streamIndex]();
-                }
-            }
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_HISR & MSK_FEIF04)
-            {
-                if(dma1ErrorCallBacks[streamIndex])
-                {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_HIFCR &= MSK_FEIF04;
-                    dma1ErrorCallBacks[streamIndex] (dma_retFIFOError);
-                }
-            }
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_HISR & MSK_TEIF04)
-            {
-                if(dma1ErrorCallBacks[streamIndex])
-                {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_HIFCR &= MSK_TEIF04;
-                    dma1ErrorCallBacks[streamIndex] (dma_retTransferError);
-                }
-            }
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_HISR & MSK_DMEIF04)
-            {
-                if(dma1ErrorCallBacks[streamIndex])
-                {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_HIFCR &= MSK_DMEIF04;
-                    dma1ErrorCallBacks[streamIndex] (dma_retDirectModeError);
-                }
-            }
-            break;
-        case 5:
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_HISR & MSK_HTIF15)
-            {
-                if(dma1HCCallBacks[streamIndex])
-                {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_HIFCR &= ~MSK_HTIF15;
-                    dma1HCCallBacks[streamIndex]();
-                }
-            }
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_HISR & MSK_TCIF15)
-            {
-                if(dma1TCCallBacks[streamIndex])
-                {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_HIFCR &= MSK_TCIF15;
-                    dma1TCCallBacks[streamIndex]();
-                }
-            }
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_HISR & MSK_FEIF15)
-            {
-                if(dma1ErrorCallBacks[streamIndex])
-                {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_HIFCR &= MSK_FEIF15;
-                    dma1ErrorCallBacks[streamIndex] (dma_retFIFOError);
-                }
-            }
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_HISR & MSK_TEIF15)
+        }
+    }
+    return errorStatus;
+}
+
+DMA_ErrorStatus_t dma_pingPongGetOverruns(u32 dmaId, u16 streamId, pu32 overruns)
+{
+    DMA_ErrorStatus_t errorStatus = checkValidData(dmaId, streamId);
+    if(errorStatus == dma_retOk)
+    {
+        if(overruns)
+        {
+            *overruns = pingPongs[GET_DMA_INDEX(dmaId)][GET_STREAM_INDEX(streamId & MSK_CLR_CHECK_VALID_STREAM)].overruns;
+            errorStatus = dma_retOk;
+        }
+        else
+        {
+            errorStatus = dma_retNullPointer;
+        }
+    }
+    return errorStatus;
+}
+
+DMA_ErrorStatus_t dma_enableStats(void)
+{
+    DMA_ErrorStatus_t errorStatus = dma_retNotOk;
+#if DMA_STATS_ENABLED
+    u8 dmaIndex, streamIndex;
+    DEMCR |= (1 << DEMCR_TRCENA);
+    DWT_CYCCNT = 0;
+    DWT_CTRL |= (1 << DWT_CTRL_CYCCNTENA);
+    for(dmaIndex = 0; dmaIndex < DMA_COUNTS; dmaIndex++)
+    {
+        for(streamIndex = 0; streamIndex < TOT_STREAM_COUNTS; streamIndex++)
+        {
+            streamsStats[dmaIndex][streamIndex] = (dmaStreamStats_t) {0};
+        }
+    }
+    errorStatus = dma_retOk;
+#endif
+    return errorStatus;
+}
+
+DMA_ErrorStatus_t dma_getStreamStats(u32 dmaId, u16 streamId, dmaStreamStats_t* stats)
+{
+    DMA_ErrorStatus_t errorStatus = checkValidData(dmaId, streamId);
+    if(errorStatus == dma_retOk)
+    {
+        if(stats)
+        {
+#if DMA_STATS_ENABLED
+            *stats = streamsStats[GET_DMA_INDEX(dmaId)][GET_STREAM_INDEX(streamId & MSK_CLR_CHECK_VALID_STREAM)];
+#else
+            errorStatus = dma_retNotOk;
+#endif
+        }
+        else
+        {
+            errorStatus = dma_retNullPointer;
+        }
+    }
+    return errorStatus;
+}
+
+DMA_ErrorStatus_t dma_resetStreamStats(u32 dmaId, u16 streamId)
+{
+    DMA_ErrorStatus_t errorStatus = checkValidData(dmaId, streamId);
+    if(errorStatus == dma_retOk)
+    {
+#if DMA_STATS_ENABLED
+        streamsStats[GET_DMA_INDEX(dmaId)][GET_STREAM_INDEX(streamId & MSK_CLR_CHECK_VALID_STREAM)] = (dmaStreamStats_t) {0};
+#else
+        errorStatus = dma_retNotOk;
+#endif
+    }
+    return errorStatus;
+}
+
+DMA_ErrorStatus_t dma_dumpStats(dmaStreamStats_t* statsTable)
+{
+    DMA_ErrorStatus_t errorStatus = dma_retNullPointer;
+    if(statsTable)
+    {
+#if DMA_STATS_ENABLED
+        u8 dmaIndex, streamIndex;
+        for(dmaIndex = 0; dmaIndex < DMA_COUNTS; dmaIndex++)
+        {
+            for(streamIndex = 0; streamIndex < TOT_STREAM_COUNTS; streamIndex++)
             {
-                if(dma1ErrorCallBacks[streamIndex])
-                {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_HIFCR &= MSK_TEIF15;
-                    dma1ErrorCallBacks[streamIndex] (dma_retTransferError);
-                }
+                statsTable[dmaIndex * TOT_STREAM_COUNTS + streamIndex] = streamsStats[dmaIndex][streamIndex];
             }
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_HISR & MSK_DMEIF15)
+        }
+        errorStatus = dma_retOk;
+#else
+        errorStatus = dma_retNotOk;
+#endif
+    }
+    return errorStatus;
+}
+
+static void resolveAutoTuning(const streamCfg_t* streamCfg, pu8 memoryBurstMode, pu8 peripheralBurstMode, pu16 fifoLevel, pu32 fcr)
+{
+    u8 memorySizeCode = streamCfg->memorySize & MSK_CLR_CHECK_VALID_DSIZE;
+    u8 peripheralSizeCode = streamCfg->peripheralSize & MSK_CLR_CHECK_VALID_DSIZE;
+    u8 memToMem = (streamCfg->streamDirection == streamDirection_MemToMem);
+    u32 totalBytes = (u32) streamCfg->dataItems * GET_DATA_SIZE_BYTES(peripheralSizeCode);
+    u32 memoryAddresses = (u32) streamCfg->memory0Address;
+    /* a threshold set by the user must be a multiple of the memory burst, auto picks its threshold after */
+    u32 memoryFifoBytes = (*fifoLevel == fifoLevel_Auto) ? FIFO_SIZE_BYTES
+                            : GET_FIFO_THRESHOLD_BYTES(*fifoLevel & MSK_CLR_CHECK_VALID_FIFO_LVL);
+    u8 burstCode;
+    if(streamCfg->bufferMode == bufferMode_Double)
+    {
+        memoryAddresses |= (u32) streamCfg->memory1Address;
+    }
+    if(*memoryBurstMode == memoryBurstMode_Auto)
+    {
+        burstCode = pickBurst(memorySizeCode, streamCfg->memoryIncMode == memoryIncMode_IncBySize,
+                                memoryAddresses, totalBytes, memoryFifoBytes);
+        *memoryBurstMode = (memoryBurstMode_Single & MSK_CHECK_VALID_MEM_BURST) | burstCode;
+    }
+    if(*peripheralBurstMode == peripheralBurstMode_Auto)
+    {
+        /* a real peripheral asks for one item per request, PINCOS forces single bursts */
+        burstCode = BURST_CODE_SINGLE;
+        if(memToMem)
+        {
+            burstCode = pickBurst(peripheralSizeCode, streamCfg->peripheralIncMode == peripheralIncMode_IncBySize,
+                                    (u32) streamCfg->pripheralAddress, totalBytes, FIFO_SIZE_BYTES);
+        }
+        *peripheralBurstMode = (peripheralBurstMode_Single & MSK_CHECK_VALID_PRI_BURST) | burstCode;
+    }
+    if(*fifoLevel == fifoLevel_Auto)
+    {
+        u8 bursts = ((*memoryBurstMode & MSK_CLR_CHECK_VALID_MEM_BURST) != BURST_CODE_SINGLE)
+                    || ((*peripheralBurstMode & MSK_CLR_CHECK_VALID_PRI_BURST) != BURST_CODE_SINGLE);
+        *fcr &= ~(1 << SxFCR_DMDIS);
+        if(bursts)
+        {
+            /* full threshold is a multiple of every legal burst */
+            *fifoLevel = fifoLevel_Full;
+            *fcr |= (1 << SxFCR_DMDIS);
+        }
+        else if(!memToMem && memorySizeCode == peripheralSizeCode)
+        {
+            /* nothing to gain from the FIFO, direct mode ignores the threshold */
+            *fifoLevel = fifoLevel_OneQuarter;
+        }
+        else
+        {
+            /* packing/unpacking or memory to memory need the FIFO, half leaves room while the bus is busy */
+            *fifoLevel = fifoLevel_Half;
+            *fcr |= (1 << SxFCR_DMDIS);
+        }
+    }
+}
+
+static u8 pickBurst(u8 sizeCode, u8 increment, u32 addresses, u32 totalBytes, u32 fifoBytes)
+{
+    u8 burstCode = BURST_CODE_SINGLE;
+    u8 code;
+    u32 burstBytes;
+    if(increment)
+    {
+        /* an aligned burst never crosses a 1KB boundary, length multiple of it never runs past the end,
+           fifoBytes (FIFO size or threshold) multiple of it */
+        for(code = BURST_CODE_INC16; code > BURST_CODE_SINGLE && burstCode == BURST_CODE_SINGLE; code--)
+        {
+            burstBytes = GET_BURST_BEATS(code) * GET_DATA_SIZE_BYTES(sizeCode);
+            if((fifoBytes % burstBytes) == 0 && (addresses % burstBytes) == 0 && (totalBytes % burstBytes) == 0)
             {
-                if(dma1ErrorCallBacks[streamIndex])
-                {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_HIFCR &= MSK_DMEIF15;
-                    dma1ErrorCallBacks[streamIndex] (dma_retDirectModeError);
-                }
+                burstCode = code;
             }
+        }
+    }
+    return burstCode;
+}
+
+static DMA_ErrorStatus_t checkFifoAndBurst(const streamCfg_t* streamCfg, u8 memoryBurstMode, u8 peripheralBurstMode, u16 fifoLevel, u32 fcr)
+{
+    DMA_ErrorStatus_t errorStatus = dma_retOk;
+    u8 memoryBurstCode = memoryBurstMode & MSK_CLR_CHECK_VALID_MEM_BURST;
+    u8 peripheralBurstCode = peripheralBurstMode & MSK_CLR_CHECK_VALID_PRI_BURST;
+    u32 memoryBurstBytes = GET_BURST_BEATS(memoryBurstCode)
+                            * GET_DATA_SIZE_BYTES(streamCfg->memorySize & MSK_CLR_CHECK_VALID_DSIZE);
+    u32 peripheralBurstBytes = GET_BURST_BEATS(peripheralBurstCode)
+                            * GET_DATA_SIZE_BYTES(streamCfg->peripheralSize & MSK_CLR_CHECK_VALID_DSIZE);
+    u8 fifoLevelCode = fifoLevel & MSK_CLR_CHECK_VALID_FIFO_LVL;
+    if(memoryBurstCode > BURST_CODE_INC16)
+    {
+        errorStatus = dma_retInvalidMemoryBurstMode;
+    }
+    else if(peripheralBurstCode > BURST_CODE_INC16)
+    {
+        errorStatus = dma_retInvalidPeripheralBurstMode;
+    }
+    else if(fifoLevelCode > (fifoLevel_Full & MSK_CLR_CHECK_VALID_FIFO_LVL))
+    {
+        errorStatus = dma_retInvalidFifoLevel;
+    }
+    else if(!(fcr & (1 << SxFCR_DMDIS)))
+    {
+        /* direct mode: bursts are forced to single by hardware, threshold is not used */
+    }
+    else if((GET_FIFO_THRESHOLD_BYTES(fifoLevelCode) % memoryBurstBytes) != 0)
+    {
+        errorStatus = dma_retInvalidFifoLevel;
+    }
+    else if(peripheralBurstBytes > FIFO_SIZE_BYTES
+            || (peripheralBurstCode != BURST_CODE_SINGLE && streamCfg->peripheralIncMode == peripheralIncMode_Aligned))
+    {
+        errorStatus = dma_retInvalidPeripheralBurstMode;
+    }
+    return errorStatus;
+}
+
+static DMA_ErrorStatus_t checkValidData(u32 dmaId, u16 streamId)
+{
+    DMA_ErrorStatus_t errorStatus = dma_retNotOk;
+    if((dmaId & MSK_CHECK_VALID_DMA_ID) == MSK_VALID_DMA_ID)
+    {
+        if((streamId & MSK_CHECK_VALID_STREAM) == MSK_VALID_STREAM)
+        {
+            errorStatus = dma_retOk;
+        }
+        else
+        {
+            errorStatus = dma_retInvalidStreamId;
+        }
+    }
+    else
+    {
+        errorStatus = dma_retInvalidDMAId;
+    }
+    return errorStatus;
+}
+
+static DMA_ErrorStatus_t checkValidDataAndCanConfig(u32 dmaId, u16 streamId)
+{
+    DMA_ErrorStatus_t errorStatus = checkValidData(dmaId, streamId);
+    if(errorStatus == dma_retOk)
+    {
+        dmaId &= MSK_CLR_CHECK_VALID_DMA_ID;
+        streamId &= MSK_CLR_CHECK_VALID_STREAM;
+        if((CAST_STREAM_REGS(dmaId + streamId)->DMA_SxCR & MSK_CHECK_STRAM_STATE) == MSK_STRAM_ENABLED)
+        {
+            errorStatus = dma_retConfigWhileEnabledStream;
+        }
+        else
+        {
+            errorStatus = dma_retOk;
+        }
+    }
+    return errorStatus;
+}
+
+static DMA_ErrorStatus_t startMemJob(u16 streamId, u32 destination, u32 source, u32 size, u8 fixedPort, dmaCallBack_t cbf)
+{
+    DMA_ErrorStatus_t errorStatus = dma_retNotOk;
+    u8 streamIndex = GET_STREAM_INDEX(streamId & MSK_CLR_CHECK_VALID_STREAM);
+    if(memJobs[streamIndex].active)
+    {
+        errorStatus = dma_retConfigWhileEnabledStream;
+    }
+    else if(size == 0)
+    {
+        errorStatus = dma_retInvalidDataItems;
+    }
+    else
+    {
+        /* the widest data size all of (destination, source, size) are aligned to */
+        u32 alignment = destination | size;
+        if(fixedPort != MEM_JOB_FIXED_SOURCE)
+        {
+            alignment |= source;
+        }
+        if((alignment & MSK_WORD_ALIGN) == 0)
+        {
+            memJobs[streamIndex].width = MEM_WIDTH_WORD;
+        }
+        else if((alignment & MSK_HALF_WORD_ALIGN) == 0)
+        {
+            memJobs[streamIndex].width = MEM_WIDTH_HALF_WORD;
+        }
+        else
+        {
+            memJobs[streamIndex].width = MEM_WIDTH_BYTE;
+        }
+        memJobs[streamIndex].destination = destination;
+        memJobs[streamIndex].source = source;
+        memJobs[streamIndex].remainingBytes = size;
+        memJobs[streamIndex].fixedPort = fixedPort;
+        memJobs[streamIndex].cbf = cbf;
+        memJobs[streamIndex].active = 1;
+        memJobStartChunk(streamIndex);
+        errorStatus = dma_retOk;
+    }
+    return errorStatus;
+}
+
+static void memJobStartChunk(u8 streamIndex)
+{
+    memJob_t* job = &memJobs[streamIndex];
+    volatile StreamRegs_t* const streamRegs = CAST_STREAM_REGS(GET_STREAM_BASE(DMA2_BASE_ADDRESS, streamIndex));
+    u32 items = job->remainingBytes / job->width;
+    u32 sizeCode, burstCode, alignment, temp;
+    if(items > MEM_JOB_MAX_CHUNK_ITEMS)
+    {
+        items = MEM_JOB_MAX_CHUNK_ITEMS;
+    }
+    job->chunkBytes = items * job->width;
+    switch(job->width)
+    {
+        case MEM_WIDTH_WORD:
+            sizeCode = memorySize_Word & MSK_CLR_CHECK_VALID_DSIZE;
+            burstCode = memoryBurstMode_Inc4 & MSK_CLR_CHECK_VALID_MEM_BURST;
             break;
-        case 6:
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_HISR & MSK_HTIF26)
-            {
-                if(dma1HCCallBacks[streamIndex])
-                {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_HIFCR &= ~MSK_HTIF26;
-                    dma1HCCallBacks[streamIndex]();
-                }
-            }
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_HISR & MSK_TCIF26)
-            {
-                if(dma1TCCallBacks[streamIndex])
-                {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_HIFCR &= MSK_TCIF26;
-                    dma1TCCallBacks[streamIndex]();
-                }
-            }
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_HISR & MSK_FEIF26)
-            {
-                if(dma1ErrorCallBacks[streamIndex])
-                {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_HIFCR &= MSK_FEIF26;
-                    dma1ErrorCallBacks[streamIndex] (dma_retFIFOError);
-                }
-            }
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_HISR & MSK_TEIF26)
-            {
-                if(dma1ErrorCallBacks[streamIndex])
-                {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_HIFCR &= MSK_TEIF26;
-                    dma1ErrorCallBacks[streamIndex] (dma_retTransferError);
-                }
-            }
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_HISR & MSK_DMEIF26)
-            {
-                if(dma1ErrorCallBacks[streamIndex])
-                {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_HIFCR &= MSK_DMEIF26;
-                    dma1ErrorCallBacks[streamIndex] (dma_retDirectModeError);
-                }
-            }
+        case MEM_WIDTH_HALF_WORD:
+            sizeCode = memorySize_HalfWord & MSK_CLR_CHECK_VALID_DSIZE;
+            burstCode = memoryBurstMode_Inc8 & MSK_CLR_CHECK_VALID_MEM_BURST;
             break;
-        case 7:
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_HISR & MSK_HTIF37)
-            {
-                if(dma1HCCallBacks[streamIndex])
-                {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_HIFCR &= ~MSK_HTIF37;
-                    dma1HCCallBacks[streamIndex]();
-                }
-            }
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_HISR & MSK_TCIF37)
-            {
-                if(dma1TCCallBacks[streamIndex])
-                {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_HIFCR &= MSK_TCIF37;
-                    dma1TCCallBacks[streamIndex]();
-                }
-            }
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_HISR & MSK_FEIF37)
-            {
-                if(dma1ErrorCallBacks[streamIndex])
-                {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_HIFCR &= MSK_FEIF37;
-                    dma1ErrorCallBacks[streamIndex] (dma_retFIFOError);
-                }
-            }
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_HISR & MSK_TEIF37)
-            {
-                if(dma1ErrorCallBacks[streamIndex])
-                {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_HIFCR &= MSK_TEIF37;
-                    dma1ErrorCallBacks[streamIndex] (dma_retTransferError);
-                }
-            }
-            if(CAST_DMA_REGS(dmaBaseAdd)->DMA_HISR & MSK_DMEIF37)
-            {
-                if(dma1ErrorCallBacks[streamIndex])
-                {
-                    CAST_DMA_REGS(dmaBaseAdd)->DMA_HIFCR &= MSK_DMEIF37;
-                    dma1ErrorCallBacks[streamIndex] (dma_retDirectModeError);
-                }
-            }
+        default:
+            sizeCode = memorySize_Byte & MSK_CLR_CHECK_VALID_DSIZE;
+            burstCode = memoryBurstMode_Inc16 & MSK_CLR_CHECK_VALID_MEM_BURST;
             break;
     }
+    temp = (sizeCode << SxCR_MSIZE_SHIFT) | (sizeCode << SxCR_PSIZE_SHIFT)
+            | ((streamDirection_MemToMem & MSK_CLR_CHECK_VALID_DIR) << SxCR_DIR_SHIFT)
+            | (1 << SxCR_TCIE) | (1 << SxCR_TEIE) | (1 << SxCR_DMEIE);
+    alignment = job->chunkBytes;
+    if(job->fixedPort != MEM_JOB_FIXED_DESTINATION)
+    {
+        temp |= (1 << SxCR_MINC);
+        alignment |= job->destination;
+    }
+    if(job->fixedPort != MEM_JOB_FIXED_SOURCE)
+    {
+        temp |= (1 << SxCR_PINC);
+        alignment |= job->source;
+    }
+    /* bursts of a full FIFO only when no burst can cross a 1KB boundary or run past the chunk,
+       a fixed destination is a register written by single beats */
+    if((alignment & MSK_MEM_BURST_ALIGN) == 0)
+    {
+        temp |= (burstCode << SxCR_PBURST_SHIFT);
+        if(job->fixedPort != MEM_JOB_FIXED_DESTINATION)
+        {
+            temp |= (burstCode << SxCR_MBURST_SHIFT);
+        }
+    }
+    streamRegs->DMA_SxCR = 0;
+    if(streamIndex < LOW_REG_STREAMS_COUNT)
+    {
+        CAST_DMA_REGS(DMA2_BASE_ADDRESS)->DMA_LIFCR = MSK_STREAM_ALL_FLAGS << flagsShift[streamIndex];
+    }
+    else
+    {
+        CAST_DMA_REGS(DMA2_BASE_ADDRESS)->DMA_HIFCR = MSK_STREAM_ALL_FLAGS << flagsShift[streamIndex];
+    }
+    /* in memory to memory the peripheral port is the source and memory0 port is the destination */
+    streamRegs->DMA_SxPAR = job->source;
+    streamRegs->DMA_SxM0AR = job->destination;
+    streamRegs->DMA_SxNDTR = items;
+    streamRegs->DMA_SxFCR = (1 << SxFCR_DMDIS) | (fifoLevel_Full & MSK_CLR_CHECK_VALID_FIFO_LVL);
+    streamRegs->DMA_SxCR = temp;
+    streamRegs->DMA_SxCR = temp | (1 << SxCR_EN);
+    STATS_ON_ENABLE(GET_STREAM_BASE(DMA2_BASE_ADDRESS, streamIndex));
+}
+
+static void memJobHandler(u8 streamIndex, u32 flags)
+{
+    memJob_t* job = &memJobs[streamIndex];
+    if(flags & (MSK_TEIF04 | MSK_DMEIF04))
+    {
+        job->active = 0;
+        if(dma2ErrorCallBacks[streamIndex])
+        {
+            dma2ErrorCallBacks[streamIndex] ((flags & MSK_TEIF04) ? dma_retTransferError : dma_retDirectModeError);
+        }
+    }
+    else if(flags & MSK_TCIF04)
+    {
+        if(job->fixedPort != MEM_JOB_FIXED_DESTINATION)
+        {
+            job->destination += job->chunkBytes;
+        }
+        if(job->fixedPort != MEM_JOB_FIXED_SOURCE)
+        {
+            job->source += job->chunkBytes;
+        }
+        job->remainingBytes -= job->chunkBytes;
+        if(job->remainingBytes)
+        {
+            memJobStartChunk(streamIndex);
+        }
+        else
+        {
+            job->active = 0;
+            job->cbf();
+        }
+    }
+}
+
+static void pingPongHandler(u32 dmaBaseAdd, u8 dmaIndex, u8 streamIndex)
+{
+    pingPong_t* pingPong = &pingPongs[dmaIndex][streamIndex];
+    /* CT already points to the buffer the hardware switched to, the other one has just completed */
+    u8 nextBuffer = (CAST_STREAM_REGS(GET_STREAM_BASE(dmaBaseAdd, streamIndex))->DMA_SxCR >> SxCR_CT) & 1;
+    u8 completedBuffer = nextBuffer ^ 1;
+    if(pingPong->softwareOwned[nextBuffer])
+    {
+        dmaErrorCallBack_t errorCallBack = (dmaIndex == DMA2_IDX) ? dma2ErrorCallBacks[streamIndex] : dma1ErrorCallBacks[streamIndex];
+        pingPong->overruns++;
+        if(errorCallBack)
+        {
+            errorCallBack(dma_retBufferOverrun);
+        }
+    }
+    pingPong->softwareOwned[completedBuffer] = 1;
+    pingPong->cbf(completedBuffer);
+}
+
+#if DMA_STATS_ENABLED
+static void statsOnEnable(u32 streamBase)
+{
+    u8 dmaIndex = (streamBase >= DMA2_BASE_ADDRESS) ? DMA2_IDX : DMA1_IDX;
+    u8 streamIndex = GET_STREAM_INDEX(streamBase - ((dmaIndex == DMA2_IDX) ? DMA2_BASE_ADDRESS : DMA1_BASE_ADDRESS));
+    dmaStreamStats_t* stats = &streamsStats[dmaIndex][streamIndex];
+    u32 psize = (CAST_STREAM_REGS(streamBase)->DMA_SxCR >> SxCR_PSIZE_SHIFT) & MSK_READ_PSIZE;
+    stats->armedBytes = CAST_STREAM_REGS(streamBase)->DMA_SxNDTR << psize;
+    stats->startCycle = DWT_CYCCNT;
+    stats->inFlight = 1;
+}
+
+static void statsOnFlags(u8 dmaIndex, u8 streamIndex, u32 flags)
+{
+    dmaStreamStats_t* stats = &streamsStats[dmaIndex][streamIndex];
+    if(flags & MSK_HTIF04)
+    {
+        stats->halfTransfers++;
+    }
+    if(flags & MSK_TCIF04)
+    {
+        u32 now = DWT_CYCCNT;
+        u32 cycles = now - stats->startCycle;
+        stats->transfers++;
+        stats->bytes += stats->armedBytes;
+        stats->lastCycles = cycles;
+        stats->totalCycles += cycles;
+        if(cycles > stats->maxCycles)
+        {
+            stats->maxCycles = cycles;
+        }
+        /* circular and double buffer streams go on with the same size */
+        stats->startCycle = now;
+        stats->inFlight = (CAST_STREAM_REGS(GET_STREAM_BASE(dmaIndex == DMA2_IDX ? DMA2_BASE_ADDRESS : DMA1_BASE_ADDRESS, streamIndex))->DMA_SxCR 
+                            & ((1 << SxCR_CIRC) | (1 << SxCR_DBM))) ? 1 : 0;
+    }
+    if(flags & MSK_FEIF04)
+    {
+        stats->fifoErrors++;
+    }
+    if(flags & MSK_TEIF04)
+    {
+        stats->transferErrors++;
+        stats->inFlight = 0;
+    }
+    if(flags & MSK_DMEIF04)
+    {
+        stats->directModeErrors++;
+    }
+}
+#endif
+
+static void dmaHandler(u32 dmaBaseAdd, u8 streamIndex)
+{
+    dmaCallBack_t* hcCallBacks = dma1HCCallBacks;
+    dmaCallBack_t* tcCallBacks = dma1TCCallBacks;
+    dmaErrorCallBack_t* errorCallBacks = dma1ErrorCallBacks;
+    u8 dmaIndex = DMA1_IDX;
+    u32 flags;
+    if(dmaBaseAdd == DMA2_BASE_ADDRESS)
+    {
+        dmaIndex = DMA2_IDX;
+        hcCallBacks = dma2HCCallBacks;
+        tcCallBacks = dma2TCCallBacks;
+        errorCallBacks = dma2ErrorCallBacks;
+    }
+    /* flags are cleared by writing one to the clear register, never by read-modify-write */
+    if(streamIndex < LOW_REG_STREAMS_COUNT)
+    {
+        flags = (CAST_DMA_REGS(dmaBaseAdd)->DMA_LISR >> flagsShift[streamIndex]) & MSK_STREAM_ALL_FLAGS;
+        CAST_DMA_REGS(dmaBaseAdd)->DMA_LIFCR = flags << flagsShift[streamIndex];
+    }
+    else
+    {
+        flags = (CAST_DMA_REGS(dmaBaseAdd)->DMA_HISR >> flagsShift[streamIndex]) & MSK_STREAM_ALL_FLAGS;
+        CAST_DMA_REGS(dmaBaseAdd)->DMA_HIFCR = flags << flagsShift[streamIndex];
+    }
+    STATS_ON_FLAGS(dmaIndex, streamIndex, flags);
+    if(dmaBaseAdd == DMA2_BASE_ADDRESS && memJobs[streamIndex].active)
+    {
+        memJobHandler(streamIndex, flags);
+    }
+    else
+    {
+        if((flags & MSK_TCIF04) && pingPongs[dmaIndex][streamIndex].active)
+        {
+            pingPongHandler(dmaBaseAdd, dmaIndex, streamIndex);
+            flags &= ~MSK_TCIF04;
+        }
+        if((flags & MSK_HTIF04) && hcCallBacks[streamIndex])
+        {
+            hcCallBacks[streamIndex]();
+        }
+        if((flags & MSK_TCIF04) && tcCallBacks[streamIndex])
+        {
+            tcCallBacks[streamIndex]();
+        }
+        if((flags & MSK_FEIF04) && errorCallBacks[streamIndex])
+        {
+            errorCallBacks[streamIndex] (dma_retFIFOError);
+        }
+        if((flags & MSK_TEIF04) && errorCallBacks[streamIndex])
+        {
+            errorCallBacks[streamIndex] (dma_retTransferError);
+        }
+        if((flags & MSK_DMEIF04) && errorCallBacks[streamIndex])
+        {
+            errorCallBacks[streamIndex] (dma_retDirectModeError);
+        }
+    }
 }
 
 void DMA1_Stream0_IRQHandler(void)
@@ -100,6 +100,9 @@
                 Channel7 >> Not Connected                       Channel7 >> Not Connected
 */
 
+#define DMA_STATS_ENABLED                   1       /* 0 to remove per stream statistics from the driver */
+#define DMA_STATS_TABLE_SIZE                16      /* DMA1 streams 0:7 then DMA2 streams 0:7 */
+
 #define dmaId_1                             0x400260EC
 #define dmaId_2                             0x400264EC
 
@@ -130,6 +133,7 @@
 #define fifoLevel_OneQuarter                0xCC00
 #define fifoLevel_ThirdQuarter              0xCC02
 #define fifoLevel_Full                      0xCC03
+#define fifoLevel_Auto                      0xCCFF  /* derive threshold and FIFO/direct mode at prepare */
 
 #define peripheralIncMode_Fixed             0x1D
 #define peripheralIncMode_IncBySize         0x2D
@@ -149,11 +153,13 @@
 #define memoryBurstMode_Inc4                0xA1
 #define memoryBurstMode_Inc8                0xA2
 #define memoryBurstMode_Inc16               0xA3
+#define memoryBurstMode_Auto                0xAF    /* largest legal burst from size, alignment and length */
 
 #define peripheralBurstMode_Single          0xB0
 #define peripheralBurstMode_Inc4            0xB1
 #define peripheralBurstMode_Inc8            0xB2
 #define peripheralBurstMode_Inc16           0xB3
+#define peripheralBurstMode_Auto            0xBF    /* bursts only in memory to memory, single otherwise */
 
 #define memorySize_Byte                     0xE0
 #define memorySize_HalfWord                 0xE1
@@ -169,6 +175,7 @@
 
 typedef void (*dmaCallBack_t)(void);
 typedef void (*dmaErrorCallBack_t)(u8 errorStatus);
+typedef void (*dmaPingPongCallBack_t)(u8 bufferIndex);
 
 typedef enum
 {
@@ -194,6 +201,8 @@ typedef enum
     dma_retInvalidDataSize,
     dma_retInvalidPeripheralBurstMode,
     dma_retInvalidMemoryBurstMode,
+    dma_retInvalidBufferIndex,
+    dma_retBufferOverrun,
 }DMA_ErrorStatus_t;
 
 typedef struct 
@@ -217,6 +226,48 @@ typedef struct
     u8 bufferMode;
 }streamCfg_t;
 
+/* statistics of a stream, cycles are counted by DWT cycle counter (core clock) */
+typedef struct
+{
+    u64 bytes;                  /* bytes moved by completed transfers */
+    u64 totalCycles;            /* from enable (or previous completion) to completion, summed */
+    u32 transfers;              /* completed transfers */
+    u32 halfTransfers;
+    u32 fifoErrors;
+    u32 transferErrors;
+    u32 directModeErrors;
+    u32 lastCycles;
+    u32 maxCycles;
+    u32 armedBytes;             /* bytes of the running transfer, taken when it was enabled */
+    u32 startCycle;             /* armedBytes, startCycle and inFlight are used by the driver */
+    u8 inFlight;
+}dmaStreamStats_t;
+
+/* validated register image of a stream, built once by dma_prepareStream */
+typedef struct
+{
+    u32 streamBase;
+    u32 flagsClearAddress;
+    u32 flagsClearMask;
+    u32 cr;
+    u32 ndtr;
+    u32 par;
+    u32 m0ar;
+    u32 m1ar;
+    u32 fcr;
+}dmaStreamImage_t;
+
+/*
+    FIFO and burst (dma_streamInit, dma_prepareStream):
+        - FIFO is 16 bytes, a memory burst (beats x memory size) must divide the FIFO threshold,
+          any other combination is rejected by dma_retInvalidFifoLevel instead of FIFO errors at runtime
+        - memoryBurstMode_Auto picks the largest burst dividing the FIFO (the threshold if fifoLevel is
+          set) whose bytes divide the transfer length and the alignment of memory address(es), single if
+          memory is not incremented
+        - peripheralBurstMode_Auto picks the same way for memory to memory only (peripheral port reads memory)
+        - fifoLevel_Auto uses a full threshold with bursts, direct mode if there are no bursts and no
+          packing (same data sizes, not memory to memory), else a half threshold
+*/
 DMA_ErrorStatus_t dma_streamInit(u32 dmaId, const streamCfg_t* streamCfg);
 DMA_ErrorStatus_t dma_enableStream(u32 dmaId, u16 streamId);
 DMA_ErrorStatus_t dma_disableStream(u32 dmaId, u16 streamId);
@@ -242,4 +293,56 @@ DMA_ErrorStatus_t dma_registerHalfCompleteCallback(u32 dmaId, u16 streamId, dmaC
 DMA_ErrorStatus_t dma_registerTransferCompleteCallback(u32 dmaId, u16 streamId, dmaCallBack_t cbf);
 DMA_ErrorStatus_t dma_registerErrorsCallback(u32 dmaId, u16 streamId, dmaErrorCallBack_t cbf);
 
+/*
+    Prepare once, arm fast:
+        - dma_prepareStream validates streamCfg like dma_streamInit but only builds the register image
+        - dma_armStream writes the whole image and enables the (disabled) stream
+        - dma_rearmStream changes only memory0 address and data items then enables the stream again
+        - interrupts enabled by dma_enable...Interrupt APIs are kept by both
+*/
+DMA_ErrorStatus_t dma_prepareStream(u32 dmaId, const streamCfg_t* streamCfg, dmaStreamImage_t* image);
+DMA_ErrorStatus_t dma_armStream(const dmaStreamImage_t* image);
+DMA_ErrorStatus_t dma_rearmStream(dmaStreamImage_t* image, u32* memoryAddress, u16 dataItems);
+
+/*
+    Statistics (DMA_STATS_ENABLED):
+        - dma_enableStats starts the DWT cycle counter and clears all statistics
+        - counters are updated when a stream is enabled by this driver and in the stream interrupt,
+          so transfer/half transfer counts need their interrupts enabled
+        - dma_dumpStats copies the statistics of all streams to an array of DMA_STATS_TABLE_SIZE
+        - with DMA_STATS_ENABLED 0 these APIs return dma_retNotOk
+*/
+DMA_ErrorStatus_t dma_enableStats(void);
+DMA_ErrorStatus_t dma_getStreamStats(u32 dmaId, u16 streamId, dmaStreamStats_t* stats);
+DMA_ErrorStatus_t dma_resetStreamStats(u32 dmaId, u16 streamId);
+DMA_ErrorStatus_t dma_dumpStats(dmaStreamStats_t* statsTable);
+
+/*
+    Memory to memory jobs (DMA2 only, the stream must be disabled and not used by another job):
+        - data size and burst are picked from the alignment of destination, source and size
+        - jobs bigger than 65535 items are split into chunks and re-armed from the stream interrupt
+        - cbf is called from the stream interrupt when the whole job is done, transfer/direct mode errors
+          are reported to the callback registered by dma_registerErrorsCallback
+        - DMA2 clock and the stream interrupt in NVIC must be enabled by the user
+*/
+DMA_ErrorStatus_t dma_memcpyAsync(u16 streamId, void* destination, const void* source, u32 size, dmaCallBack_t cbf);
+DMA_ErrorStatus_t dma_memsetAsync(u16 streamId, void* destination, u8 value, u32 size, dmaCallBack_t cbf);
+/* same job with a fixed destination, size bytes from source are written to dataRegister (CRC_DR for example) */
+DMA_ErrorStatus_t dma_feedRegisterAsync(u16 streamId, volatile u32* dataRegister, const void* source, u32 size, dmaCallBack_t cbf);
+
+/*
+    Ping-pong streaming over double buffer mode (bufferMode_Double with memory0Address and memory1Address):
+        - cbf gets the index (0: memory0, 1: memory1) of the buffer the hardware just completed,
+          from then on this buffer is owned by software while the hardware works on the other one
+        - software gives the buffer back by dma_pingPongRelease after consuming (or refilling) it
+        - if the hardware switches to a buffer software didn't release yet, the overrun counter is
+          incremented and the callback registered by dma_registerErrorsCallback gets dma_retBufferOverrun
+        - dma_pingPongSetIdleBuffer swaps the address of a software owned buffer without stopping the stream
+*/
+DMA_ErrorStatus_t dma_pingPongStart(u32 dmaId, const streamCfg_t* streamCfg, dmaPingPongCallBack_t cbf);
+DMA_ErrorStatus_t dma_pingPongStop(u32 dmaId, u16 streamId);
+DMA_ErrorStatus_t dma_pingPongRelease(u32 dmaId, u16 streamId, u8 bufferIndex);
+DMA_ErrorStatus_t dma_pingPongSetIdleBuffer(u32 dmaId, u16 streamId, u8 bufferIndex, u32* address);
+DMA_ErrorStatus_t dma_pingPongGetOverruns(u32 dmaId, u16 streamId, pu32 overruns);
+
 #endif
\ No newline at end of file
@@ -9,10 +9,17 @@
  */
 
 #include "FLASH.h"
+#include "../../LIB/Address.h"
+#ifdef FLASH_HOST_SIM
+#include "FLASH_Sim.h"
+#endif
 
 #define FLASH_BASE_ADD                  0x08000000
+#define FLASH_END_ADD                   (FLASH_BASE_ADD + FLASH_SIZE)
+#define FLASH_BLOCK_SHIFT               14              /* 16KB, the smallest sector */
 
-#define FLASH_WAIT_TIMEOUT              0xFFFF
+/* loop count covering the worst case 128KB sector erase (4s) at 84MHz */
+#define FLASH_WAIT_TIMEOUT              0x04000000
 
 #define KEYR_KEY1                       0x45670123
 #define KEYR_KEY2                       0xCDEF89AB
@@ -29,7 +36,9 @@
 
 #define MSK_CHECK_VALID_SECTOR_NO       0xF0
 #define MSK_VALID_SECTOR_NO             0xB0
-#define MSK_CLR_CHECK_VALID_SECTOR_NO   0x0F   
+#define MSK_CLR_CHECK_VALID_SECTOR_NO   0x0F
+#define IS_VALID_SECTOR_NO(sectorNo)    ((((sectorNo) & MSK_CHECK_VALID_SECTOR_NO) == MSK_VALID_SECTOR_NO) \
+                                         && (((sectorNo) & MSK_CLR_CHECK_VALID_SECTOR_NO) < FLASH_SECTORS_COUNT))
 
 /* For FLASH_ACR bits [31:13, 7:4 reserved], LATENCY from 3:0 */
 #define ACR_DCRST           12
@@ -37,6 +46,8 @@
 #define ACR_DCEN            10
 #define ACR_ICEN            9
 #define ACR_PRFTEN          8
+#define MSK_ART_CACHES      ((1 << ACR_ICEN) | (1 << ACR_DCEN))
+#define MSK_ART_RESETS      ((1 << ACR_ICRST) | (1 << ACR_DCRST))
 #define MSK_CLR_LATENCY     0xFFFFFFF0
 #define MSK_READ_LATENCY    0x000000FF
 
@@ -60,11 +71,68 @@
 #define MSK_PSIZE_x16       0x00000100
 #define MSK_PSIZE_x32       0x00000200
 #define MSK_PSIZE_x64       0x00000300
-#define MSK_CLR_SNB         0xFFFFFF88
+#define MSK_CLR_SNB         0xFFFFFF80  /* SNB, MER, SER and PG */
 #define CR_SNB_SHIFT        3
 #define CR_MER              2
 #define CR_SER              1
 #define CR_PG               0
+#define MSK_CR_OPERATION    0x000000FF  /* PG, SER, MER and SNB */
+
+/* errors set by the flash as soon as an operation is requested */
+#define MSK_SR_REQUEST_ERRORS   (MSK_SR_PGSERR | MSK_SR_PGPERR | MSK_SR_PGAERR | MSK_SR_WRPERR)
+#define MSK_SR_ALL_FLAGS        (MSK_SR_RDERR | MSK_SR_REQUEST_ERRORS | MSK_SR_OPERR | MSK_SR_EOP)
+
+/* widest programming unit allowed by the supply voltage, x8 for unaligned bytes */
+#define PROGRAM_WIDTH                   (1 << FLASH_VOLTAGE_RANGE)
+#define MSK_PSIZE_PROGRAM_WIDTH         (FLASH_VOLTAGE_RANGE << 8)
+#define MSK_PSIZE_HEAD_TAIL             0x00000000
+
+#if FLASH_WRITE_CHUNK_SIZE < PROGRAM_WIDTH
+#error "FLASH_WRITE_CHUNK_SIZE must be at least the program width"
+#endif
+
+#define FLASH_MAX_HCLK                  84000000
+#define MAX_LATENCY                     5
+
+#define FLASH_JOB_ERASE     0
+#define FLASH_JOB_PROGRAM   1
+
+#ifdef FLASH_HOST_SIM
+/* registers and flash array are emulated by FLASH_Sim.c, the sim calls FLASH_IRQHandler from the thread polling it */
+#define FLASH_REGS                          ((volatile void*) flashSim_registers)
+#define PROGRAM_BYTE(address, value)        flashSim_program(TO_ADDRESS(address), (value), 1)
+#define PROGRAM_HALF_WORD(address, value)   flashSim_program(TO_ADDRESS(address), (value), 2)
+#define PROGRAM_WORD(address, value)        flashSim_program(TO_ADDRESS(address), (value), 4)
+#define CLEAR_SR_FLAGS(flags)               flashSim_clearStatus(flags)
+#define FLASH_UNLOCK_HOOK()                 flashSim_unlock()
+#define FLASH_START_HOOK()                  flashSim_startOperation()
+#define FLASH_POLL_HOOK()                   flashSim_waitWhileBusy()
+#define ENTER_CRITICAL(primask)             ((primask) = 0)
+#define EXIT_CRITICAL(primask)              ((void) (primask))
+#else
+#define FLASH_REGS                          0x40023C00
+#define PROGRAM_BYTE(address, value)        (*(volatile u8*) (address) = (value))
+#define PROGRAM_HALF_WORD(address, value)   (*(volatile u16*) (address) = (value))
+#define PROGRAM_WORD(address, value)        (*(volatile u32*) (address) = (value))
+/* SR flags are cleared by writing 1 */
+#define CLEAR_SR_FLAGS(flags)               (flashRegs->FLASH_SR = (flags))
+#define FLASH_UNLOCK_HOOK()
+#define FLASH_START_HOOK()
+#define FLASH_POLL_HOOK()
+/* PRIMASK is saved so the engine can be fed from interrupts too */
+#define ENTER_CRITICAL(primask)             __asm volatile("MRS %0, primask\n\tCPSID I" : "=r"(primask) :: "memory")
+#define EXIT_CRITICAL(primask)              __asm volatile("MSR primask, %0" :: "r"(primask) : "memory")
+#endif
+
+typedef struct
+{
+    pu32 address;
+    const u32* data;
+    u32 wordsCount;
+    flashJobCbf_t cbf;
+    u8 type;
+    u8 sectorNo;
+}flashJob_t;
 
 struct FlashRegs_t
 {
@@ -76,11 +144,58 @@ struct FlashRegs_t
     u32 FLASH_OPTCR;
 };
 
-static volatile struct FlashRegs_t* const flashRegs = (volatile struct FlashRegs_t* const) 0x40023C00;  
+typedef struct
+{
+    u32 startAddress;
+    u32 size;
+}flashSector_t;
+
+static volatile struct FlashRegs_t* const flashRegs = (volatile struct FlashRegs_t* const) FLASH_REGS;
 static operationErrorCbf_t operationErrorCallBack = NULL;
 
-extern void FLASH_IRQHandler(void);
-static FLASH_ErrorStatus_t checkBusyFlag();
+/* HCLK step of each wait state (RM0368 table 6), 2.1V:2.4V row is used for the 2.1V:2.7V range */
+static const u32 waitStateStepHz [] = {16000000, 18000000, 30000000};
+
+/* F401 family layout, FLASH_SECTORS_COUNT of them exist on FLASH_VARIANT */
+static const flashSector_t sectors [] =
+{
+    {0x08000000, 0x04000},
+    {0x08004000, 0x04000},
+    {0x08008000, 0x04000},
+    {0x0800C000, 0x04000},
+    {0x08010000, 0x10000},
+    {0x08020000, 0x20000},
+    {0x08040000, 0x20000},
+    {0x08060000, 0x20000},
+};
+
+/* sector index of each 16KB block of the flash */
+static const u8 sectorOfBlock [] =
+{
+    0, 1, 2, 3, 4, 4, 4, 4,
+    5, 5, 5, 5, 5, 5, 5, 5,
+    6, 6, 6, 6, 6, 6, 6, 6,
+    7, 7, 7, 7, 7, 7, 7, 7,
+};
+
+static flashJob_t jobsQueue [FLASH_JOBS_QUEUE_SIZE];
+static volatile u8 jobsHead = 0;
+static volatile u8 jobsCount = 0;
+static volatile u8 engineBusy = 0;
+static u32 programmedWords = 0;
+static u32 userPsize = 0;               /* PSIZE of flash_setPsize, put back when the engine stops */
+
+extern RAM_FUNC void FLASH_IRQHandler(void);
+static RAM_FUNC FLASH_ErrorStatus_t checkBusyFlag();
+static RAM_FUNC FLASH_ErrorStatus_t waitWhileBusy(void);
+static RAM_FUNC void selectPsize(u32 psizeMask);
+static u32 getLatencyOfClock(u32 hclk);
+static FLASH_ErrorStatus_t pushJob(const flashJob_t* job);
+static RAM_FUNC FLASH_ErrorStatus_t issueOperation(void);
+static RAM_FUNC FLASH_ErrorStatus_t readRequestErrors(void);
+static RAM_FUNC flashJobCbf_t popJob(void);
+static RAM_FUNC void completeJob(FLASH_ErrorStatus_t jobStatus);
+static RAM_FUNC void runEngine(void);
 
 FLASH_ErrorStatus_t flash_lock()
 {
@@ -100,6 +215,7 @@ FLASH_ErrorStatus_t flash_unlock()
     {
         flashRegs->FLASH_KEYR = KEYR_KEY1;
         flashRegs->FLASH_KEYR = KEYR_KEY2;
+        FLASH_UNLOCK_HOOK();
         errorStatus = flash_retOk;
     }
     return errorStatus;
@@ -161,6 +277,55 @@ FLASH_ErrorStatus_t flash_setLatency(u8 latency)
     return errorStatus;
 }
 
+FLASH_ErrorStatus_t flash_setLatencyForClock(u32 hclk)
+{
+    FLASH_ErrorStatus_t errorStatus = flash_retNotOk;
+    if(hclk == 0 || hclk > FLASH_MAX_HCLK)
+    {
+        errorStatus = flash_retInvalidLatency;
+    }
+    else
+    {
+        errorStatus = flash_setLatency(latency_0WS + getLatencyOfClock(hclk));
+    }
+    return errorStatus;
+}
+
+FLASH_ErrorStatus_t flash_enableArt()
+{
+    u32 temp = flashRegs->FLASH_ACR;
+    /* caches can be reset only while disabled */
+    temp &= ~MSK_ART_CACHES;
+    flashRegs->FLASH_ACR = temp;
+    flashRegs->FLASH_ACR = temp | MSK_ART_RESETS;
+    flashRegs->FLASH_ACR = temp;
+    flashRegs->FLASH_ACR = temp | MSK_ART_CACHES | (1 << ACR_PRFTEN);
+    return flash_retOk;
+}
+
+FLASH_ErrorStatus_t flash_clockChangeHook(u32 hclk)
+{
+    FLASH_ErrorStatus_t errorStatus = flash_retNotOk;
+    if(hclk == 0 || hclk > FLASH_MAX_HCLK)
+    {
+        errorStatus = flash_retInvalidLatency;
+    }
+    else if(getLatencyOfClock(hclk) <= (flashRegs->FLASH_ACR & MSK_READ_LATENCY))
+    {
+        /* enough wait states for the new clock, lowering them now would be too few for the current one */
+        errorStatus = flash_enableArt();
+    }
+    else
+    {
+        errorStatus = flash_setLatency(latency_0WS + getLatencyOfClock(hclk));
+        if(errorStatus == flash_retOk)
+        {
+            errorStatus = flash_enableArt();
+        }
+    }
+    return errorStatus;
+}
+
 FLASH_ErrorStatus_t flash_enableOperationErrorInterrupt(operationErrorCbf_t cbf)
 {
     FLASH_ErrorStatus_t errorStatus = checkBusyFlag();
@@ -180,36 +345,31 @@ FLASH_ErrorStatus_t flash_enableOperationErrorInterrupt(operationErrorCbf_t cbf)
     return errorStatus;
 }
 
-FLASH_ErrorStatus_t flash_eraseSector(u8 sectorNo)
+RAM_FUNC FLASH_ErrorStatus_t flash_eraseSector(u8 sectorNo)
 {
     FLASH_ErrorStatus_t errorStatus = checkBusyFlag();
-    if((sectorNo & MSK_CHECK_VALID_SECTOR_NO) == MSK_VALID_SECTOR_NO)
+    if(IS_VALID_SECTOR_NO(sectorNo))
     {
         if(errorStatus == flash_retBusy)
         {
-            u16 timeout = FLASH_WAIT_TIMEOUT;
-            while((flashRegs->FLASH_SR & MSK_SR_BSY) && timeout > 0)
-            {
-                timeout--;
-            }
+            errorStatus = waitWhileBusy();
         }
         if(errorStatus == flash_retNotBusy)
         {
             u32 temp = flashRegs->FLASH_CR;
-            u16 timeout = FLASH_WAIT_TIMEOUT;
             temp &= MSK_CLR_SNB;
             sectorNo &= MSK_CLR_CHECK_VALID_SECTOR_NO;
             temp |= sectorNo << CR_SNB_SHIFT;
             temp |= (1 << CR_SER);
             flashRegs->FLASH_CR = temp;
             flashRegs->FLASH_CR |= (1 << CR_STRT);
-            while((flashRegs->FLASH_SR & MSK_SR_BSY) && timeout > 0)
-            {
-                timeout--;
-            }
+            FLASH_START_HOOK();
+            waitWhileBusy();
             if(!(flashRegs->FLASH_SR & MSK_SR_BSY))
             {
-                errorStatus = flash_retOk;
+                /* SER left set would make the next PG a sequence error */
+                flashRegs->FLASH_CR &= ~(1 << CR_SER);
+                errorStatus = readRequestErrors();
             }
             else
             {
@@ -233,21 +393,14 @@ FLASH_ErrorStatus_t flash_massErase()
     FLASH_ErrorStatus_t errorStatus = checkBusyFlag();
     if(errorStatus == flash_retBusy)
     {
-        u16 timeout = FLASH_WAIT_TIMEOUT;
-        while((flashRegs->FLASH_SR & MSK_SR_BSY) && timeout > 0)
-        {
-            timeout--;
-        }
+        waitWhileBusy();
     }
     if(!(flashRegs->FLASH_SR & MSK_SR_BSY))
     {
-        u16 timeout = FLASH_WAIT_TIMEOUT;
         flashRegs->FLASH_CR |= (1 << CR_MER);
         flashRegs->FLASH_CR |= (1 << CR_STRT);
-        while((flashRegs->FLASH_SR & MSK_SR_BSY) && timeout > 0)
-        {
-            timeout--;
-        }
+        FLASH_START_HOOK();
+        waitWhileBusy();
         if(!(flashRegs->FLASH_SR & MSK_SR_BSY))
         {
             errorStatus = flash_retOk;
@@ -267,35 +420,106 @@ FLASH_ErrorStatus_t flash_massErase()
 FLASH_ErrorStatus_t flash_calculateSectorStartAddress(u8 sectorNo, pu32 result)
 {
     FLASH_ErrorStatus_t errorStatus = flash_retNotOk;
-    if((sectorNo & MSK_CHECK_VALID_SECTOR_NO) == MSK_VALID_SECTOR_NO)
+    if(!IS_VALID_SECTOR_NO(sectorNo))
     {
-        if(result)
-        {
-            sectorNo &= MSK_CLR_CHECK_VALID_SECTOR_NO;
-            if(sectorNo == sectorNo_0 || sectorNo == sectorNo_1 
-                || sectorNo == sectorNo_2 || sectorNo == sectorNo_3)
-            {
-                result = (pu32) (FLASH_BASE_ADD + (sectorNo * 16 * 1024));
-            }
-            else if(sectorNo == sectorNo_4)
-            {
-                result = (pu32) (FLASH_BASE_ADD + (sectorNo * 64 * 1024));
-            }
-            else
-            {
-                result = (pu32) (FLASH_BASE_ADD + (sectorNo * 128 * 1024));
-            }
-            errorStatus = flash_retOk;
-        }
-        else
-        {
-            errorStatus = flash_retNullPointer;
-        }
+        errorStatus = flash_retInvalidSectorNumber;
+    }
+    else if(!result)
+    {
+        errorStatus = flash_retNullPointer;
     }
     else
+    {
+        *result = sectors[sectorNo & MSK_CLR_CHECK_VALID_SECTOR_NO].startAddress;
+        errorStatus = flash_retOk;
+    }
+    return errorStatus;
+}
+
+FLASH_ErrorStatus_t flash_getSectorRange(u8 sectorNo, pu32 startAddress, pu32 size)
+{
+    FLASH_ErrorStatus_t errorStatus = flash_retNotOk;
+    if(!IS_VALID_SECTOR_NO(sectorNo))
     {
         errorStatus = flash_retInvalidSectorNumber;
     }
+    else if(!startAddress || !size)
+    {
+        errorStatus = flash_retNullPointer;
+    }
+    else
+    {
+        *startAddress = sectors[sectorNo & MSK_CLR_CHECK_VALID_SECTOR_NO].startAddress;
+        *size = sectors[sectorNo & MSK_CLR_CHECK_VALID_SECTOR_NO].size;
+        errorStatus = flash_retOk;
+    }
+    return errorStatus;
+}
+
+FLASH_ErrorStatus_t flash_getSectorOfAddress(u32 address, pu8 sectorNo)
+{
+    FLASH_ErrorStatus_t errorStatus = flash_retNotOk;
+    if(!sectorNo)
+    {
+        errorStatus = flash_retNullPointer;
+    }
+    else if(address < FLASH_BASE_ADD || address >= FLASH_END_ADD)
+    {
+        errorStatus = flash_retInvalidAddress;
+    }
+    else
+    {
+        *sectorNo = sectorNo_0 + sectorOfBlock[(address - FLASH_BASE_ADD) >> FLASH_BLOCK_SHIFT];
+        errorStatus = flash_retOk;
+    }
+    return errorStatus;
+}
+
+FLASH_ErrorStatus_t flash_planErase(u32 address, u32 length, flashErasePlan_t* plan)
+{
+    FLASH_ErrorStatus_t errorStatus = flash_retNotOk;
+    if(!plan)
+    {
+        errorStatus = flash_retNullPointer;
+    }
+    else if(length == 0)
+    {
+        errorStatus = flash_retInvalidLength;
+    }
+    else if(address < FLASH_BASE_ADD || address >= FLASH_END_ADD || length > FLASH_END_ADD - address)
+    {
+        errorStatus = flash_retInvalidAddress;
+    }
+    else
+    {
+        u8 first = sectorOfBlock[(address - FLASH_BASE_ADD) >> FLASH_BLOCK_SHIFT];
+        u8 last = sectorOfBlock[(address + length - 1 - FLASH_BASE_ADD) >> FLASH_BLOCK_SHIFT];
+        plan->firstSector = sectorNo_0 + first;
+        plan->sectorsCount = last - first + 1;
+        plan->startAddress = sectors[first].startAddress;
+        plan->endAddress = sectors[last].startAddress + sectors[last].size;
+        errorStatus = flash_retOk;
+    }
+    return errorStatus;
+}
+
+FLASH_ErrorStatus_t flash_eraseRange(u32 address, u32 length)
+{
+    flashErasePlan_t plan;
+    FLASH_ErrorStatus_t errorStatus = flash_planErase(address, length, &plan);
+    if(errorStatus == flash_retOk && (flashRegs->FLASH_CR & (1 << CR_LOCK)))
+    {
+        errorStatus = flash_retFlashLocked;
+    }
+    else if(errorStatus == flash_retOk)
+    {
+        u8 sectorNo = plan.firstSector;
+        while(sectorNo < plan.firstSector + plan.sectorsCount && errorStatus == flash_retOk)
+        {
+            errorStatus = flash_eraseSector(sectorNo);
+            sectorNo++;
+        }
+    }
     return errorStatus;
 }
 
@@ -304,11 +528,7 @@ FLASH_ErrorStatus_t flash_startProgramming()
     FLASH_ErrorStatus_t errorStatus = checkBusyFlag();
     if(errorStatus == flash_retBusy)
     {
-        u16 timeout = FLASH_WAIT_TIMEOUT;
-        while((flashRegs->FLASH_SR & MSK_SR_BSY) && timeout > 0)
-        {
-            timeout--;
-        }
+        waitWhileBusy();
     }
     if(!(flashRegs->FLASH_SR & MSK_SR_BSY))
     {
@@ -327,11 +547,7 @@ FLASH_ErrorStatus_t flash_stopProgramming()
     FLASH_ErrorStatus_t errorStatus = checkBusyFlag();
     if(errorStatus == flash_retBusy)
     {
-        u16 timeout = FLASH_WAIT_TIMEOUT;
-        while((flashRegs->FLASH_SR & MSK_SR_BSY) && timeout > 0)
-        {
-            timeout--;
-        }
+        waitWhileBusy();
     }
     if(!(flashRegs->FLASH_SR & MSK_SR_BSY))
     {
@@ -345,7 +561,7 @@ FLASH_ErrorStatus_t flash_stopProgramming()
     return errorStatus;
 }
 
-FLASH_ErrorStatus_t flash_writeData(u32 data, pu32 address)
+RAM_FUNC FLASH_ErrorStatus_t flash_writeData(u32 data, pu32 address)
 {
     FLASH_ErrorStatus_t errorStatus = checkBusyFlag();
     if(flashRegs->FLASH_CR >> CR_PG)
@@ -358,40 +574,32 @@ FLASH_ErrorStatus_t flash_writeData(u32 data, pu32 address)
         {
             if(errorStatus == flash_retBusy)
             {
-                u16 timeout = FLASH_WAIT_TIMEOUT;
-                while((flashRegs->FLASH_SR & MSK_SR_BSY) && timeout > 0)
-                {
-                    timeout--;
-                }
+                waitWhileBusy();
             }
             if(!(flashRegs->FLASH_SR & MSK_SR_BSY))
             {
-                u16 timeout = FLASH_WAIT_TIMEOUT;
-                *address = data;
-                while((flashRegs->FLASH_SR & MSK_SR_BSY) && timeout > 0)
-                {
-                    timeout--;
-                }
+                PROGRAM_WORD(address, data);
+                waitWhileBusy();
                 if(!(flashRegs->FLASH_SR & MSK_SR_BSY))
                 {
                     if(flashRegs->FLASH_SR & MSK_SR_PGAERR)
                     {
-                        flashRegs->FLASH_SR &= ~MSK_SR_PGAERR;
+                        CLEAR_SR_FLAGS(MSK_SR_PGAERR);
                         errorStatus = flash_retProgrammingAlignmentError;
                     }
                     else if(flashRegs->FLASH_SR & MSK_SR_PGSERR)
                     {
-                        flashRegs->FLASH_SR &= ~MSK_SR_PGSERR;
+                        CLEAR_SR_FLAGS(MSK_SR_PGSERR);
                         errorStatus = flash_retProgrammingSequenceError;
                     }
                     else if(flashRegs->FLASH_SR & MSK_SR_PGPERR)
                     {
-                        flashRegs->FLASH_SR &= ~MSK_SR_PGPERR;
+                        CLEAR_SR_FLAGS(MSK_SR_PGPERR);
                         errorStatus = flash_retProgrammingParallelismError;
                     }
                     else if(flashRegs->FLASH_SR & MSK_SR_WRPERR)
                     {
-                        flashRegs->FLASH_SR &= ~MSK_SR_WRPERR;
+                        CLEAR_SR_FLAGS(MSK_SR_WRPERR);
                         errorStatus = flash_retWriteProtectionError;
                     }
                     else
@@ -428,18 +636,14 @@ FLASH_ErrorStatus_t flash_readData(pu32 address, pu32 data)
     {
         if(errorStatus == flash_retBusy)
         {
-            u16 timeout = FLASH_WAIT_TIMEOUT;
-            while((flashRegs->FLASH_SR & MSK_SR_BSY) && timeout > 0)
-            {
-                timeout--;
-            }
+            waitWhileBusy();
         }
         if(!(flashRegs->FLASH_SR & MSK_SR_BSY))
         {
             *data = *address;
             if(flashRegs->FLASH_SR & MSK_SR_RDERR)
             {
-                flashRegs->FLASH_SR &= ~MSK_SR_RDERR;
+                CLEAR_SR_FLAGS(MSK_SR_RDERR);
                 errorStatus = flash_retReadProtectionError;
             }
             else
@@ -455,7 +659,270 @@ FLASH_ErrorStatus_t flash_readData(pu32 address, pu32 data)
     return errorStatus;
 }
 
-static FLASH_ErrorStatus_t checkBusyFlag()
+RAM_FUNC FLASH_ErrorStatus_t flash_writeBuffer(void* destination, const void* source, u32 length)
+{
+    FLASH_ErrorStatus_t errorStatus = flash_retNotOk;
+    u32 address = TO_ADDRESS(destination);
+    const u8* data = (const u8*) source;
+    if(!destination || !source)
+    {
+        errorStatus = flash_retNullPointer;
+    }
+    else if(address < FLASH_BASE_ADD || address > FLASH_END_ADD || length > FLASH_END_ADD - address)
+    {
+        errorStatus = flash_retInvalidAddress;
+    }
+    else if(flashRegs->FLASH_CR & (1 << CR_LOCK))
+    {
+        errorStatus = flash_retFlashLocked;
+    }
+    else if(engineBusy || waitWhileBusy() != flash_retNotBusy)
+    {
+        errorStatus = flash_retBusy;
+    }
+    else
+    {
+        u32 chunkEnd;
+        /* SER/MER left by the blocking erase APIs would end in a sequence error */
+        flashRegs->FLASH_CR &= ~((1 << CR_SER) | (1 << CR_MER));
+        CLEAR_SR_FLAGS(MSK_SR_ALL_FLAGS);
+        errorStatus = flash_retOk;
+        while(length > 0 && errorStatus == flash_retOk)
+        {
+            /* chunks end on a program width boundary, only the head and tail of the buffer are programmed by x8 */
+            chunkEnd = (address + FLASH_WRITE_CHUNK_SIZE) & ~(PROGRAM_WIDTH - 1);
+            if(chunkEnd - address > length)
+            {
+                chunkEnd = address + length;
+            }
+            length -= chunkEnd - address;
+            while(address < chunkEnd && errorStatus == flash_retOk)
+            {
+                if((address & (PROGRAM_WIDTH - 1)) || chunkEnd - address < PROGRAM_WIDTH)
+                {
+                    /* unaligned head or tail */
+                    selectPsize(MSK_PSIZE_HEAD_TAIL);
+                    PROGRAM_BYTE(address, *data);
+                    address++;
+                    data++;
+                }
+                else
+                {
+                    selectPsize(MSK_PSIZE_PROGRAM_WIDTH);
+#if FLASH_VOLTAGE_RANGE == voltageRange_2V7_3V6
+                    PROGRAM_WORD(address, (u32) data[0] | ((u32) data[1] << 8)
+                                            | ((u32) data[2] << 16) | ((u32) data[3] << 24));
+#elif FLASH_VOLTAGE_RANGE == voltageRange_2V1_2V7
+                    PROGRAM_HALF_WORD(address, (u16) (data[0] | (data[1] << 8)));
+#else
+                    PROGRAM_BYTE(address, *data);
+#endif
+                    address += PROGRAM_WIDTH;
+                    data += PROGRAM_WIDTH;
+                }
+                if(waitWhileBusy() != flash_retNotBusy)
+                {
+                    errorStatus = flash_retTimeout;
+                }
+            }
+            if(errorStatus == flash_retOk)
+            {
+                errorStatus = readRequestErrors();
+            }
+        }
+        flashRegs->FLASH_CR &= ~(1 << CR_PG);
+    }
+    return errorStatus;
+}
+
+FLASH_ErrorStatus_t flash_eraseSectorAsync(u8 sectorNo, flashJobCbf_t cbf)
+{
+    FLASH_ErrorStatus_t errorStatus = flash_retNotOk;
+    if(!IS_VALID_SECTOR_NO(sectorNo))
+    {
+        errorStatus = flash_retInvalidSectorNumber;
+    }
+    else if(!cbf)
+    {
+        errorStatus = flash_retNullPointer;
+    }
+    else
+    {
+        flashJob_t job = {NULL, NULL, 0, NULL, FLASH_JOB_ERASE, 0};
+        job.sectorNo = sectorNo & MSK_CLR_CHECK_VALID_SECTOR_NO;
+        job.cbf = cbf;
+        errorStatus = pushJob(&job);
+    }
+    return errorStatus;
+}
+
+FLASH_ErrorStatus_t flash_programAsync(pu32 address, const u32* data, u32 wordsCount, flashJobCbf_t cbf)
+{
+    FLASH_ErrorStatus_t errorStatus = flash_retNotOk;
+    if(!address || !data || !cbf)
+    {
+        errorStatus = flash_retNullPointer;
+    }
+    else if((TO_ADDRESS(address) & 0x3) || wordsCount == 0)
+    {
+        errorStatus = flash_retProgrammingAlignmentError;
+    }
+    else
+    {
+        flashJob_t job = {NULL, NULL, 0, NULL, FLASH_JOB_PROGRAM, 0};
+        job.address = address;
+        job.data = data;
+        job.wordsCount = wordsCount;
+        job.cbf = cbf;
+        errorStatus = pushJob(&job);
+    }
+    return errorStatus;
+}
+
+FLASH_ErrorStatus_t flash_getAsyncStatus()
+{
+    FLASH_ErrorStatus_t errorStatus = flash_retNotBusy;
+    FLASH_POLL_HOOK();
+    if(engineBusy)
+    {
+        errorStatus = flash_retBusy;
+    }
+    return errorStatus;
+}
+
+static FLASH_ErrorStatus_t pushJob(const flashJob_t* job)
+{
+    FLASH_ErrorStatus_t errorStatus = flash_retNotOk;
+    u32 primask;
+    if(flashRegs->FLASH_CR & (1 << CR_LOCK))
+    {
+        errorStatus = flash_retFlashLocked;
+    }
+    else
+    {
+        ENTER_CRITICAL(primask);
+        if(jobsCount < FLASH_JOBS_QUEUE_SIZE)
+        {
+            jobsQueue[(jobsHead + jobsCount) % FLASH_JOBS_QUEUE_SIZE] = *job;
+            jobsCount++;
+            errorStatus = flash_retOk;
+        }
+        else
+        {
+            errorStatus = flash_retQueueFull;
+        }
+        if(errorStatus == flash_retOk && !engineBusy)
+        {
+            engineBusy = 1;
+            programmedWords = 0;
+            userPsize = flashRegs->FLASH_CR & ~MSK_CLR_PSIZE;
+            EXIT_CRITICAL(primask);
+            runEngine();
+        }
+        else
+        {
+            EXIT_CRITICAL(primask);
+        }
+    }
+    return errorStatus;
+}
+
+/* requests the next operation of the job at the head of the queue, its end raises EOP */
+static RAM_FUNC FLASH_ErrorStatus_t issueOperation(void)
+{
+    flashJob_t* job = &jobsQueue[jobsHead];
+    u32 temp = flashRegs->FLASH_CR;
+    temp &= ~MSK_CR_OPERATION & MSK_CLR_PSIZE;
+    temp |= MSK_PSIZE_x32 | (1 << CR_EOPIE) | (1 << CR_ERRIE);
+    CLEAR_SR_FLAGS(MSK_SR_ALL_FLAGS);
+    if(job->type == FLASH_JOB_ERASE)
+    {
+        temp |= (job->sectorNo << CR_SNB_SHIFT) | (1 << CR_SER);
+        flashRegs->FLASH_CR = temp;
+        flashRegs->FLASH_CR = temp | (1 << CR_STRT);
+        FLASH_START_HOOK();
+    }
+    else
+    {
+        flashRegs->FLASH_CR = temp | (1 << CR_PG);
+        PROGRAM_WORD(&job->address[programmedWords], job->data[programmedWords]);
+    }
+    return readRequestErrors();
+}
+
+static RAM_FUNC FLASH_ErrorStatus_t readRequestErrors(void)
+{
+    FLASH_ErrorStatus_t errorStatus = flash_retOk;
+    u32 flags = flashRegs->FLASH_SR;
+    if(flags & MSK_SR_WRPERR)
+    {
+        errorStatus = flash_retWriteProtectionError;
+    }
+    else if(flags & MSK_SR_PGAERR)
+    {
+        errorStatus = flash_retProgrammingAlignmentError;
+    }
+    else if(flags & MSK_SR_PGPERR)
+    {
+        errorStatus = flash_retProgrammingParallelismError;
+    }
+    else if(flags & MSK_SR_PGSERR)
+    {
+        errorStatus = flash_retProgrammingSequenceError;
+    }
+    CLEAR_SR_FLAGS(flags & MSK_SR_REQUEST_ERRORS);
+    return errorStatus;
+}
+
+/* pops the head job, must be called in a critical section, returns the callback of its owner */
+static RAM_FUNC flashJobCbf_t popJob(void)
+{
+    flashJobCbf_t cbf = jobsQueue[jobsHead].cbf;
+    flashRegs->FLASH_CR &= ~MSK_CR_OPERATION;
+    jobsHead = (jobsHead + 1) % FLASH_JOBS_QUEUE_SIZE;
+    jobsCount--;
+    programmedWords = 0;
+    return cbf;
+}
+
+/* pops the head job then tells its owner out of the critical section, the callback may push again */
+static RAM_FUNC void completeJob(FLASH_ErrorStatus_t jobStatus)
+{
+    flashJobCbf_t cbf;
+    u32 primask;
+    ENTER_CRITICAL(primask);
+    cbf = popJob();
+    EXIT_CRITICAL(primask);
+    cbf(jobStatus);
+}
+
+/* starts queued jobs until one is running, jobs refused by the flash are completed by their error */
+static RAM_FUNC void runEngine(void)
+{
+    FLASH_ErrorStatus_t errorStatus = flash_retNotOk;
+    flashJobCbf_t cbf;
+    u32 primask;
+    ENTER_CRITICAL(primask);
+    while(jobsCount && errorStatus != flash_retOk)
+    {
+        errorStatus = issueOperation();
+        if(errorStatus != flash_retOk)
+        {
+            cbf = popJob();
+            EXIT_CRITICAL(primask);
+            cbf(errorStatus);
+            ENTER_CRITICAL(primask);
+        }
+    }
+    if(!jobsCount)
+    {
+        flashRegs->FLASH_CR = (flashRegs->FLASH_CR & ~((1 << CR_EOPIE) | (1 << CR_ERRIE)) & MSK_CLR_PSIZE) | userPsize;
+        engineBusy = 0;
+    }
+    EXIT_CRITICAL(primask);
+}
+
+static RAM_FUNC FLASH_ErrorStatus_t checkBusyFlag()
 {
     FLASH_ErrorStatus_t errorStatus = flash_retNotBusy;
     if(flashRegs->FLASH_SR & MSK_SR_BSY)
@@ -465,14 +932,73 @@ static FLASH_ErrorStatus_t checkBusyFlag()
     return errorStatus;
 }
 
+static RAM_FUNC FLASH_ErrorStatus_t waitWhileBusy(void)
+{
+    u32 timeout = FLASH_WAIT_TIMEOUT;
+    while((flashRegs->FLASH_SR & MSK_SR_BSY) && timeout > 0)
+    {
+        FLASH_POLL_HOOK();
+        timeout--;
+    }
+    return checkBusyFlag();
+}
+
+/* minimum wait states of hclk (1 : FLASH_MAX_HCLK) at FLASH_VOLTAGE_RANGE */
+static u32 getLatencyOfClock(u32 hclk)
+{
+    u32 latency = (hclk - 1) / waitStateStepHz[FLASH_VOLTAGE_RANGE];
+    if(latency > MAX_LATENCY)
+    {
+        latency = MAX_LATENCY;
+    }
+    return latency;
+}
+
+/* PG stays set, only psize is changed when the access width changes */
+static RAM_FUNC void selectPsize(u32 psizeMask)
+{
+    u32 temp = flashRegs->FLASH_CR;
+    if((temp & ~MSK_CLR_PSIZE) != psizeMask || !(temp & (1 << CR_PG)))
+    {
+        temp &= MSK_CLR_PSIZE;
+        temp |= psizeMask | (1 << CR_PG);
+        flashRegs->FLASH_CR = temp;
+    }
+}
+
 /* IRQ No 4 */
-void FLASH_IRQHandler(void)
+RAM_FUNC void FLASH_IRQHandler(void)
 {
-    if(flashRegs->FLASH_SR & MSK_SR_OPERR)
+    u32 flags = flashRegs->FLASH_SR;
+    if(flags & MSK_SR_OPERR)
     {
+        CLEAR_SR_FLAGS(MSK_SR_OPERR | MSK_SR_EOP);
         if(operationErrorCallBack)
         {
             operationErrorCallBack(flash_retOperationError);
         }
+        if(engineBusy)
+        {
+            completeJob(flash_retOperationError);
+            runEngine();
+        }
+    }
+    else if((flags & MSK_SR_EOP) && engineBusy)
+    {
+        CLEAR_SR_FLAGS(MSK_SR_EOP);
+        if(jobsQueue[jobsHead].type == FLASH_JOB_PROGRAM && ++programmedWords < jobsQueue[jobsHead].wordsCount)
+        {
+            FLASH_ErrorStatus_t errorStatus = issueOperation();
+            if(errorStatus != flash_retOk)
+            {
+                completeJob(errorStatus);
+                runEngine();
+            }
+        }
+        else
+        {
+            completeJob(flash_retOk);
+            runEngine();
+        }
     }
 }
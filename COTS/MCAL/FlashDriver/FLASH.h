@@ -12,6 +12,7 @@
 #define FLASH_H
 
 #include "../../LIB/Std_types.h"
+#include "../../LIB/Ram_func.h"
 
 #define psize_x8            0x000000EE
 #define pszie_x16           0x000001EE
@@ -24,6 +25,18 @@
 #define sectorNo_3          0xB3        /* Sector3 is 16KB */
 #define sectorNo_4          0xB4        /* Sector4 is 64KB */
 #define sectorNo_5          0xB5        /* Sector5 is 128KB */
+#define sectorNo_6          0xB6        /* Sector6 is 128KB (xD/xE only) */
+#define sectorNo_7          0xB7        /* Sector7 is 128KB (xE only) */
+
+/* flash size of the part, sectors layout is the same and only the count changes */
+#define flashVariant_xB     0           /* 128KB, sectors 0:4 */
+#define flashVariant_xC     1           /* 256KB, sectors 0:5 */
+#define flashVariant_xD     2           /* 384KB, sectors 0:6 */
+#define flashVariant_xE     3           /* 512KB, sectors 0:7 */
+#define FLASH_VARIANT       flashVariant_xC
+
+#define FLASH_SECTORS_COUNT (5 + FLASH_VARIANT)
+#define FLASH_SIZE          (0x20000 * (FLASH_VARIANT + 1))
 
 #define latency_0WS         0xD0
 #define latency_1WS         0xD1
@@ -32,6 +45,17 @@
 #define latency_4WS         0xD4
 #define latency_5WS         0xD5
 
+/* supply voltage of the board, it limits the programming parallelism (x64 needs VPP, not on F401) */
+#define voltageRange_1V7_2V1    0x0     /* x8 */
+#define voltageRange_2V1_2V7    0x1     /* x16 */
+#define voltageRange_2V7_3V6    0x2     /* x32 */
+#define FLASH_VOLTAGE_RANGE     voltageRange_2V7_3V6
+
+#ifndef FLASH_WRITE_CHUNK_SIZE
+#define FLASH_WRITE_CHUNK_SIZE  256     /* bytes programmed by flash_writeBuffer between error checks */
+#endif
+#define FLASH_JOBS_QUEUE_SIZE   8       /* max number of erase/program jobs waiting the async engine */
+
 typedef enum
 {
     flash_retNotOk,
@@ -51,15 +75,30 @@ typedef enum
     flash_retOperationError,
     flash_retTimeout,
     flash_retPGNotSet,
+    flash_retQueueFull,
+    flash_retInvalidAddress,
+    flash_retInvalidLength,
 }FLASH_ErrorStatus_t;
 
+typedef struct
+{
+    u8 firstSector;             /* sectorNo_x */
+    u8 sectorsCount;
+    u32 startAddress;           /* start of firstSector */
+    u32 endAddress;             /* end (exclusive) of the last sector */
+}flashErasePlan_t;
+
 typedef void (*operationErrorCbf_t) (FLASH_ErrorStatus_t);
+typedef void (*flashJobCbf_t) (FLASH_ErrorStatus_t);
 
 FLASH_ErrorStatus_t flash_lock();
 FLASH_ErrorStatus_t flash_unlock();
 FLASH_ErrorStatus_t flash_getStatus();
 FLASH_ErrorStatus_t flash_setPsize(u32 psize);
 FLASH_ErrorStatus_t flash_setLatency(u8 latency);
+FLASH_ErrorStatus_t flash_setLatencyForClock(u32 hclk);
+FLASH_ErrorStatus_t flash_enableArt();
+FLASH_ErrorStatus_t flash_clockChangeHook(u32 hclk);
 FLASH_ErrorStatus_t flash_enableOperationErrorInterrupt(operationErrorCbf_t cbf);
 FLASH_ErrorStatus_t flash_eraseSector(u8 sectorNo);
 FLASH_ErrorStatus_t flash_massErase();
@@ -69,4 +108,60 @@ FLASH_ErrorStatus_t flash_stopProgramming();
 FLASH_ErrorStatus_t flash_writeData(u32 data, pu32 address);
 FLASH_ErrorStatus_t flash_readData(pu32 address, pu32 data);
 
+/*
+    Sectors geometry of FLASH_VARIANT (constant tables, O(1) lookups):
+        - flash_getSectorRange gives start address and size of sectorNo
+        - flash_getSectorOfAddress gives sectorNo_x of any address in flash
+        - flash_planErase gives the sectors covering [address, address + length), nothing is erased,
+          data of the plan range outside the given one is lost by the erase
+        - flash_eraseRange erases only the sectors of the plan (blocking), the flash must be unlocked
+          it stops at the first sector refused by the flash (write protection or sequence error)
+*/
+FLASH_ErrorStatus_t flash_getSectorRange(u8 sectorNo, pu32 startAddress, pu32 size);
+FLASH_ErrorStatus_t flash_getSectorOfAddress(u32 address, pu8 sectorNo);
+FLASH_ErrorStatus_t flash_planErase(u32 address, u32 length, flashErasePlan_t* plan);
+FLASH_ErrorStatus_t flash_eraseRange(u32 address, u32 length);
+
+/*
+    flash_writeBuffer programs length bytes from source (any alignment) to destination in flash:
+        - the widest psize of FLASH_VOLTAGE_RANGE is used, unaligned head/tail bytes are programmed by x8
+        - status flags are checked once every FLASH_WRITE_CHUNK_SIZE bytes, programming stops at the first error
+        - the flash must be unlocked and the destination erased, psize is left as the widest one
+*/
+FLASH_ErrorStatus_t flash_writeBuffer(void* destination, const void* source, u32 length);
+
+/*
+    Wait states and ART accelerator:
+        - flash_setLatencyForClock sets the minimum wait states of hclk (Hz, max 84MHz) at FLASH_VOLTAGE_RANGE,
+          call it with the new clock before switching to a faster clock and after switching to a slower one
+        - flash_enableArt resets then enables instruction cache, data cache and prefetch
+        - flash_clockChangeHook must be called with the new hclk before every clock switch: it only raises
+          the wait states (enough for both clocks during the switch) then enables ART, after a switch to a
+          slower clock flash_setLatencyForClock can lower them
+        - the hook returns flash_retBusy if the wait states must be raised while the flash is busy, the
+          clock must not be switched until it returns flash_retOk
+        - rcc_selectSystemClock and rcc_setBusPrescaler (AHB) call the hook before the switch and
+          flash_setLatencyForClock after it, code switching the clock by RCC registers must do the same
+*/
+
+/*
+    Async engine (flash_eraseSectorAsync, flash_programAsync):
+        - jobs are queued and run one after the other from FLASH_IRQHandler on end of operation,
+          the flash must be unlocked and FLASH IRQ (No 4) enabled in NVIC by the user
+        - programming is done by words (psize x32) so the supply must be 2.7V:3.6V, the psize of
+          flash_setPsize is set again when the queue is empty
+        - cbf gets flash_retOk or the error which stopped the job, it's called from the interrupt
+          or from the caller if the job couldn't be started at all, never with interrupts masked
+        - data to program must stay valid until the job callback
+        - don't use the blocking APIs while flash_getAsyncStatus returns flash_retBusy
+*/
+/*
+    Program/erase paths (flash_eraseSector, flash_writeData, flash_writeBuffer, the async engine
+    and FLASH_IRQHandler) are RAM_FUNC, with the vector table in SRAM (nvic_relocateVectorTableToRam)
+    interrupts whose handlers are in SRAM too keep running while the blocking APIs wait for the flash
+*/
+FLASH_ErrorStatus_t flash_eraseSectorAsync(u8 sectorNo, flashJobCbf_t cbf);
+FLASH_ErrorStatus_t flash_programAsync(pu32 address, const u32* data, u32 wordsCount, flashJobCbf_t cbf);
+FLASH_ErrorStatus_t flash_getAsyncStatus();
+
 #endif  /* FLASH_H */
\ No newline at end of file
@@ -0,0 +1,466 @@
+/**
+ * @file FLASH_Sim.c
+ * @author Ibrahim Saad
+ * @brief This is the source file of the NOR flash simulator which replaces the flash
+ *        registers and memory array of STM32F401CC when FLASH.c is built for Linux
+ * @version 0.1
+ * @date 2023-06-13
+ * @copyright Copyright (c) 2023
+ */
+
+#ifdef FLASH_HOST_SIM
+
+#include "FLASH_Sim.h"
+#include "FLASH.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE     0x100000        /* Linux 4.17, older kernels take it as a hint */
+#endif
+
+#define SIM_FLASH_BASE_ADD      0x08000000
+#define SIM_FLASH_SIZE          ((u32) FLASH_SIZE)
+#define SIM_SECTORS_COUNT       FLASH_SECTORS_COUNT
+
+#define REG_ACR                 0
+#define REG_KEYR                1
+#define REG_SR                  3
+#define REG_CR                  4
+#define REG_OPTCR               5
+
+#define KEYR_KEY2               0xCDEF89AB
+#define OPTCR_RESET_VALUE       0x0FFFAAED      /* no write protection, RDP level 0 */
+#define OPTCR_NWRP_SHIFT        16
+#define MSK_NWRP_ALL            (((1 << SIM_SECTORS_COUNT) - 1) << OPTCR_NWRP_SHIFT)
+
+#define SR_BSY                  0x00010000
+#define SR_PGSERR               0x00000080
+#define SR_PGPERR               0x00000040
+#define SR_PGAERR               0x00000020
+#define SR_WRPERR               0x00000010
+#define SR_EOP                  0x00000001
+#define SR_W1C_FLAGS            0x000001F3
+
+#define CR_LOCK                 0x80000000
+#define CR_ERRIE                0x02000000
+#define CR_EOPIE                0x01000000
+#define CR_STRT                 0x00010000
+#define CR_PSIZE_SHIFT          8
+#define CR_PSIZE_MASK           0x3
+#define CR_SNB_SHIFT            3
+#define CR_SNB_MASK             0xF
+#define CR_MER                  0x00000004
+#define CR_SER                  0x00000002
+#define CR_PG                   0x00000001
+
+#define OPERATION_NONE          0
+#define OPERATION_PROGRAM       1
+#define OPERATION_ERASE         2
+
+/* typical values of the datasheet (table 42), erase times are by psize x8, x16, x32 (x64 as x32) */
+#define PROGRAM_TIME_NS         16000ULL
+#define MS_TO_NS                1000000ULL
+#define SPIN_LIMIT_NS           200000ULL
+#define TORN_PROGRAM_MASK       0xAAAAAAAA      /* bits kept by a torn program */
+
+typedef struct
+{
+    u32 address;
+    u32 size;
+    u32 eraseTimeMs [3];
+}simSector_t;
+
+typedef struct
+{
+    u8 type;
+    u8 width;
+    u32 address;
+    u32 value;
+    u32 length;
+    u64 deadline;
+}simOperation_t;
+
+volatile u32 flashSim_registers [6];
+
+static const simSector_t sectors [] =
+{
+    {0x08000000, 0x04000, {400, 300, 250}},
+    {0x08004000, 0x04000, {400, 300, 250}},
+    {0x08008000, 0x04000, {400, 300, 250}},
+    {0x0800C000, 0x04000, {400, 300, 250}},
+    {0x08010000, 0x10000, {1200, 700, 550}},
+    {0x08020000, 0x20000, {2000, 1300, 1000}},
+    {0x08040000, 0x20000, {2000, 1300, 1000}},
+    {0x08060000, 0x20000, {2000, 1300, 1000}},
+};
+static const u32 massEraseTimeMs [3] = {16000, 11000, 8000};
+
+static int imageFile = -1;
+static u8* readView = NULL;
+static u8* writeView = NULL;
+static u32 timeScale = 100;
+static simOperation_t pending = {OPERATION_NONE, 0, 0, 0, 0, 0};
+static flashSimStats_t stats;
+static u32 powerFailCountdown = 0;
+static u8 powerLost = 0;
+static u8 inInterrupt = 0;
+
+extern void FLASH_IRQHandler(void);
+
+static u64 nowNs(void);
+static void sleepUntil(u64 deadline);
+static void resetRegisters(void);
+static u8 psizeWidth(void);
+static u8 countOperation(void);
+static void beginOperation(u8 type, u32 address, u32 value, u32 length, u64 typicalNs);
+static void completeOperation(void);
+
+FLASH_Sim_ErrorStatus_t flashSim_init(const char* imagePath, u32 timeScalePercent)
+{
+    FLASH_Sim_ErrorStatus_t errorStatus = flashSim_retNotOk;
+    struct stat fileStat;
+    if(!imagePath)
+    {
+        errorStatus = flashSim_retNullPointer;
+    }
+    else if(readView)
+    {
+        fprintf(stderr, "flashSim_init: the flash image is mapped, call flashSim_deinit first\n");
+        errorStatus = flashSim_retMapError;
+    }
+    else if((imageFile = open(imagePath, O_RDWR | O_CREAT, 0644)) < 0 || fstat(imageFile, &fileStat) != 0)
+    {
+        errorStatus = flashSim_retFileError;
+    }
+    else
+    {
+        u32 oldSize = (fileStat.st_size < SIM_FLASH_SIZE) ? (u32) fileStat.st_size : SIM_FLASH_SIZE;
+        errorStatus = flashSim_retOk;
+        if(oldSize < SIM_FLASH_SIZE && ftruncate(imageFile, SIM_FLASH_SIZE) != 0)
+        {
+            errorStatus = flashSim_retFileError;
+        }
+        if(errorStatus == flashSim_retOk)
+        {
+            /* the CPU view sits at the real address so pointers to flash work unchanged, a mapping
+               already there (another init, the heap of the process) is never replaced */
+            readView = mmap((void*) SIM_FLASH_BASE_ADD, SIM_FLASH_SIZE, PROT_READ, MAP_SHARED | MAP_FIXED_NOREPLACE, imageFile, 0);
+            writeView = mmap(NULL, SIM_FLASH_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, imageFile, 0);
+            if(readView != (u8*) SIM_FLASH_BASE_ADD || writeView == MAP_FAILED)
+            {
+                fprintf(stderr, "flashSim_init: can't map the flash image at 0x%08X: %s\n", SIM_FLASH_BASE_ADD,
+                        (readView == MAP_FAILED || writeView == MAP_FAILED) ? strerror(errno) : "address taken");
+                errorStatus = flashSim_retMapError;
+            }
+            else
+            {
+                /* bytes added to a new or short image are erased */
+                memset(writeView + oldSize, 0xFF, SIM_FLASH_SIZE - oldSize);
+                memset(&stats, 0, sizeof(stats));
+                timeScale = timeScalePercent;
+                powerFailCountdown = 0;
+                powerLost = 0;
+                resetRegisters();
+            }
+        }
+    }
+    return errorStatus;
+}
+
+void flashSim_deinit(void)
+{
+    if(writeView && writeView != MAP_FAILED)
+    {
+        msync(writeView, SIM_FLASH_SIZE, MS_SYNC);
+        munmap(writeView, SIM_FLASH_SIZE);
+    }
+    if(readView && readView != MAP_FAILED)
+    {
+        munmap(readView, SIM_FLASH_SIZE);
+    }
+    if(imageFile >= 0)
+    {
+        close(imageFile);
+    }
+    readView = NULL;
+    writeView = NULL;
+    imageFile = -1;
+}
+
+void flashSim_processEvents(void)
+{
+    if(pending.type != OPERATION_NONE && nowNs() >= pending.deadline)
+    {
+        completeOperation();
+        if((flashSim_registers[REG_SR] & SR_EOP) && (flashSim_registers[REG_CR] & CR_EOPIE) && !inInterrupt)
+        {
+            inInterrupt = 1;
+            FLASH_IRQHandler();
+            inInterrupt = 0;
+        }
+    }
+}
+
+void flashSim_schedulePowerFail(u32 operationsCount)
+{
+    powerFailCountdown = operationsCount;
+}
+
+u8 flashSim_isPowerLost(void)
+{
+    return powerLost;
+}
+
+void flashSim_powerOn(void)
+{
+    powerLost = 0;
+    powerFailCountdown = 0;
+    pending.type = OPERATION_NONE;
+    resetRegisters();
+}
+
+FLASH_Sim_ErrorStatus_t flashSim_getStats(flashSimStats_t* statsOut)
+{
+    FLASH_Sim_ErrorStatus_t errorStatus = flashSim_retNullPointer;
+    if(statsOut)
+    {
+        *statsOut = stats;
+        errorStatus = flashSim_retOk;
+    }
+    return errorStatus;
+}
+
+void flashSim_unlock(void)
+{
+    if(flashSim_registers[REG_KEYR] == KEYR_KEY2)
+    {
+        flashSim_registers[REG_CR] &= ~CR_LOCK;
+    }
+    flashSim_registers[REG_KEYR] = 0;
+}
+
+void flashSim_startOperation(void)
+{
+    u32 cr = flashSim_registers[REG_CR];
+    flashSim_registers[REG_CR] &= ~CR_STRT;
+    if((cr & CR_LOCK) || powerLost)
+    {
+        /* CR writes are ignored while locked, nothing starts */
+    }
+    else if(flashSim_registers[REG_SR] & SR_BSY)
+    {
+        flashSim_waitWhileBusy();
+        flashSim_startOperation();
+    }
+    else if((cr & CR_PG) || ((cr & CR_SER) && (cr & CR_MER))
+            || ((cr & CR_SER) && ((cr >> CR_SNB_SHIFT) & CR_SNB_MASK) >= SIM_SECTORS_COUNT))
+    {
+        flashSim_registers[REG_SR] |= SR_PGSERR;
+        stats.sequenceErrors++;
+    }
+    else if(cr & CR_MER)
+    {
+        u8 psize = (u8) ((cr >> CR_PSIZE_SHIFT) & CR_PSIZE_MASK);
+        if((flashSim_registers[REG_OPTCR] & MSK_NWRP_ALL) != MSK_NWRP_ALL)
+        {
+            flashSim_registers[REG_SR] |= SR_WRPERR;
+        }
+        else
+        {
+            beginOperation(OPERATION_ERASE, SIM_FLASH_BASE_ADD, 0xFFFFFFFF, SIM_FLASH_SIZE,
+                           massEraseTimeMs[(psize > 2) ? 2 : psize] * MS_TO_NS);
+        }
+    }
+    else if(cr & CR_SER)
+    {
+        u8 sectorNo = (u8) ((cr >> CR_SNB_SHIFT) & CR_SNB_MASK);
+        u8 psize = (u8) ((cr >> CR_PSIZE_SHIFT) & CR_PSIZE_MASK);
+        if(!(flashSim_registers[REG_OPTCR] & (1 << (OPTCR_NWRP_SHIFT + sectorNo))))
+        {
+            flashSim_registers[REG_SR] |= SR_WRPERR;
+        }
+        else
+        {
+            beginOperation(OPERATION_ERASE, sectors[sectorNo].address, 0xFFFFFFFF, sectors[sectorNo].size,
+                           sectors[sectorNo].eraseTimeMs[(psize > 2) ? 2 : psize] * MS_TO_NS);
+        }
+    }
+}
+
+void flashSim_program(u32 address, u32 value, u8 width)
+{
+    u32 cr = flashSim_registers[REG_CR];
+    if(flashSim_registers[REG_SR] & SR_BSY)
+    {
+        /* the bus is stalled until the running operation ends */
+        flashSim_waitWhileBusy();
+    }
+    if(powerLost)
+    {
+        /* dropped */
+    }
+    else if((cr & CR_LOCK) || !(cr & CR_PG) || (cr & (CR_SER | CR_MER)))
+    {
+        flashSim_registers[REG_SR] |= SR_PGSERR;
+        stats.sequenceErrors++;
+    }
+    else if(address < SIM_FLASH_BASE_ADD || address > SIM_FLASH_BASE_ADD + SIM_FLASH_SIZE - width
+            || (address & (width - 1)))
+    {
+        flashSim_registers[REG_SR] |= SR_PGAERR;
+        stats.alignmentErrors++;
+    }
+    else if(width != psizeWidth())
+    {
+        flashSim_registers[REG_SR] |= SR_PGPERR;
+        stats.parallelismErrors++;
+    }
+    else
+    {
+        u8 sectorNo = 0;
+        while(sectorNo < SIM_SECTORS_COUNT - 1 && address >= sectors[sectorNo + 1].address)
+        {
+            sectorNo++;
+        }
+        if(!(flashSim_registers[REG_OPTCR] & (1 << (OPTCR_NWRP_SHIFT + sectorNo))))
+        {
+            flashSim_registers[REG_SR] |= SR_WRPERR;
+        }
+        else
+        {
+            beginOperation(OPERATION_PROGRAM, address, value, width, PROGRAM_TIME_NS);
+        }
+    }
+}
+
+void flashSim_clearStatus(u32 flags)
+{
+    flashSim_registers[REG_SR] &= ~(flags & SR_W1C_FLAGS);
+}
+
+void flashSim_waitWhileBusy(void)
+{
+    if(pending.type != OPERATION_NONE)
+    {
+        sleepUntil(pending.deadline);
+        flashSim_processEvents();
+    }
+}
+
+static u64 nowNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (u64) now.tv_sec * 1000000000ULL + (u64) now.tv_nsec;
+}
+
+/* short waits spin, the sleep granularity is far longer than a word program */
+static void sleepUntil(u64 deadline)
+{
+    u64 now = nowNs();
+    if(deadline > now + SPIN_LIMIT_NS)
+    {
+        struct timespec delay;
+        delay.tv_sec = (time_t) ((deadline - now) / 1000000000ULL);
+        delay.tv_nsec = (long) ((deadline - now) % 1000000000ULL);
+        nanosleep(&delay, NULL);
+    }
+    while(nowNs() < deadline)
+    {
+    }
+}
+
+static void resetRegisters(void)
+{
+    flashSim_registers[REG_ACR] = 0;
+    flashSim_registers[REG_KEYR] = 0;
+    flashSim_registers[2] = 0;
+    flashSim_registers[REG_SR] = 0;
+    flashSim_registers[REG_CR] = CR_LOCK;
+    flashSim_registers[REG_OPTCR] = OPTCR_RESET_VALUE;
+}
+
+static u8 psizeWidth(void)
+{
+    u8 psize = (u8) ((flashSim_registers[REG_CR] >> CR_PSIZE_SHIFT) & CR_PSIZE_MASK);
+    return (u8) (1 << psize);
+}
+
+/* returns 1 if the power fails during this operation */
+static u8 countOperation(void)
+{
+    u8 failNow = 0;
+    if(powerFailCountdown)
+    {
+        powerFailCountdown--;
+        failNow = (powerFailCountdown == 0);
+    }
+    return failNow;
+}
+
+static void beginOperation(u8 type, u32 address, u32 value, u32 length, u64 typicalNs)
+{
+    pending.type = type;
+    pending.address = address;
+    pending.value = value;
+    pending.length = length;
+    pending.width = (type == OPERATION_PROGRAM) ? (u8) length : 0;
+    stats.busyTimeNs += typicalNs;
+    if(countOperation())
+    {
+        /* torn: half of the program bits or the first half of the erased range */
+        if(type == OPERATION_PROGRAM)
+        {
+            pending.value |= TORN_PROGRAM_MASK;
+        }
+        else
+        {
+            pending.length /= 2;
+        }
+        completeOperation();
+        flashSim_registers[REG_SR] &= ~SR_EOP;
+        powerLost = 1;
+    }
+    else
+    {
+        pending.deadline = nowNs() + typicalNs * timeScale / 100;
+        flashSim_registers[REG_SR] |= SR_BSY;
+    }
+}
+
+static void completeOperation(void)
+{
+    u8* cell = writeView + (pending.address - SIM_FLASH_BASE_ADD);
+    if(pending.type == OPERATION_PROGRAM)
+    {
+        /* NOR: programming only clears bits */
+        u8 byteIndex;
+        for(byteIndex = 0; byteIndex < pending.width; byteIndex++)
+        {
+            cell[byteIndex] &= (u8) (pending.value >> (8 * byteIndex));
+        }
+        stats.programOperations++;
+        stats.programmedBytes += pending.width;
+    }
+    else
+    {
+        memset(cell, 0xFF, pending.length);
+        stats.erasedSectors += (pending.length == SIM_FLASH_SIZE) ? SIM_SECTORS_COUNT : 1;
+    }
+    pending.type = OPERATION_NONE;
+    flashSim_registers[REG_SR] &= ~SR_BSY;
+    if(flashSim_registers[REG_CR] & CR_EOPIE)
+    {
+        flashSim_registers[REG_SR] |= SR_EOP;
+    }
+}
+
+#endif  /* FLASH_HOST_SIM */
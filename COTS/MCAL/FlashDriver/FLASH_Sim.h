@@ -0,0 +1,68 @@
+/**
+ * @file FLASH_Sim.h
+ * @author Ibrahim Saad
+ * @brief This is the interface of the NOR flash simulator used to build FLASH.c and the
+ *        modules on top of it for Linux (FLASH_HOST_SIM defined), the flash array is an image
+ *        file of FLASH_SIZE mapped read only at 0x08000000 and flash registers are emulated in memory
+ * @version 0.1
+ * @date 2023-06-13
+ * @copyright Copyright (c) 2023
+ */
+
+#ifndef FLASH_SIM_H
+#define FLASH_SIM_H
+
+#include "../../LIB/Std_types.h"
+
+/*
+    Emulated behaviour:
+        - reads are plain reads of the mapped image, writes must go through flash registers
+        - programming only clears bits, erase sets the whole sector to 0xFF (at its end)
+        - lock/keys, PG/SER/MER sequence, PSIZE against access width and alignment errors
+        - program and erase latencies from the datasheet typical values scaled by timeScalePercent
+          (100: real time, 0: instant), blocking waits of FLASH.c sleep, the async engine needs
+          flashSim_processEvents to be called to complete operations and run FLASH_IRQHandler
+        - power fail: the operation number operationsCount is torn (half of the bits/sector)
+          and all operations after it are dropped until flashSim_powerOn
+*/
+
+typedef enum
+{
+    flashSim_retNotOk = 0,
+    flashSim_retOk,
+    flashSim_retNullPointer,
+    flashSim_retFileError,
+    flashSim_retMapError,
+}FLASH_Sim_ErrorStatus_t;
+
+typedef struct
+{
+    u64 programmedBytes;
+    u64 busyTimeNs;             /* simulated time spent in operations */
+    u32 programOperations;
+    u32 erasedSectors;
+    u32 sequenceErrors;
+    u32 parallelismErrors;
+    u32 alignmentErrors;
+}flashSimStats_t;
+
+/* ACR, KEYR, OPTKEYR, SR, CR, OPTCR as seen by FLASH.c */
+extern volatile u32 flashSim_registers [6];
+
+/* flashSim_retMapError (printed to stderr) if 0x08000000 is already mapped, flashSim_deinit must be called between two inits */
+FLASH_Sim_ErrorStatus_t flashSim_init(const char* imagePath, u32 timeScalePercent);
+void flashSim_deinit(void);
+void flashSim_processEvents(void);
+void flashSim_schedulePowerFail(u32 operationsCount);
+u8 flashSim_isPowerLost(void);
+void flashSim_powerOn(void);
+FLASH_Sim_ErrorStatus_t flashSim_getStats(flashSimStats_t* stats);
+
+/* hooks called by FLASH.c */
+void flashSim_unlock(void);
+void flashSim_startOperation(void);
+void flashSim_program(u32 address, u32 value, u8 width);
+void flashSim_clearStatus(u32 flags);
+void flashSim_waitWhileBusy(void);
+
+#endif  /* FLASH_SIM_H */
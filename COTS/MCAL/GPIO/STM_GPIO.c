@@ -140,12 +140,12 @@ GPIO_ErrorStatus_t gpio_writePinValue(u32 gpioPort, u8 pin, u8 value)
             pin &= MSK_CLR_CHECK_VALID_PIN;
             if(value == gpioVal_SET || value == HIGH)
             {
-                CAST_GPIO_REGS(port)->GPIOx_BSRR |= (1 << pin);
+                CAST_GPIO_REGS(port)->GPIOx_BSRR = (1 << pin);
                 errorStatus = gpio_retOk;
             }
             else if(value == gpioVal_RESET || value == LOW)
             {
-                CAST_GPIO_REGS(port)->GPIOx_BSRR |= (1 << (pin + RESET_BIT_SHIFT));
+                CAST_GPIO_REGS(port)->GPIOx_BSRR = (1 << (pin + RESET_BIT_SHIFT));
                 errorStatus = gpio_retOk;
             }
             else
@@ -80,6 +80,12 @@
 #define gpioVal_SET         1
 #define gpioVal_RESET       0
 
+/* offsets of the data registers from the port base, for the fast pin handles */
+#define GPIO_IDR_OFFSET     0x10
+#define GPIO_ODR_OFFSET     0x14
+#define GPIO_BSRR_OFFSET    0x18
+#define GPIO_BSRR_RESET_SHIFT   16
+
 typedef enum
 {
     gpio_retNotOk = 0,
@@ -100,6 +106,16 @@ typedef struct
     u8 mode;
 }gpioCfg_t;
 
+/* fast pin handle: port base address and pin mask, made once by GPIO_PIN */
+typedef struct
+{
+    u32 base;
+    u32 mask;
+}gpioPin_t;
+
+/* handle of a pin from gpioPortX and PINx (not checked), e.g. static const gpioPin_t led = GPIO_PIN(gpioPortC, PIN13); */
+#define GPIO_PIN(gpioPort, pin)     {((gpioPort) & 0xFFFFFF00), (1UL << ((pin) & 0x0F))}
+
 /* Default of all I/O pins is input push pull*/
 
 /**********************************************************
@@ -229,4 +245,36 @@ GPIO_ErrorStatus_t gpio_readPort(u32 gpioPort, pu16 value);
 ***********************************************************/
 GPIO_ErrorStatus_t gpio_togglePin(u32 gpioPort, u8 pin);
 
+
+
+
+/*
+    Fast path on pin handles for bit banged protocols and control loops, nothing is validated:
+        - set and clear are one store to BSRR
+        - toggle is a load of ODR and a store to BSRR, other pins of the port written by an interrupt
+          between them are not changed back (as with ODR ^=)
+        - read is a load of IDR, returns HIGH or LOW
+    With a constant handle they inline to the load/store only, the pin must be initialized by gpio_initPin.
+*/
+static inline void gpio_setPinFast(gpioPin_t pin)
+{
+    *(volatile u32*) (pin.base + GPIO_BSRR_OFFSET) = pin.mask;
+}
+
+static inline void gpio_clearPinFast(gpioPin_t pin)
+{
+    *(volatile u32*) (pin.base + GPIO_BSRR_OFFSET) = pin.mask << GPIO_BSRR_RESET_SHIFT;
+}
+
+static inline void gpio_togglePinFast(gpioPin_t pin)
+{
+    u32 odr = *(volatile u32*) (pin.base + GPIO_ODR_OFFSET);
+    *(volatile u32*) (pin.base + GPIO_BSRR_OFFSET) = ((odr & pin.mask) << GPIO_BSRR_RESET_SHIFT) | (~odr & pin.mask);
+}
+
+static inline u8 gpio_readPinFast(gpioPin_t pin)
+{
+    return (*(volatile u32*) (pin.base + GPIO_IDR_OFFSET) & pin.mask) ? HIGH : LOW;
+}
+
 #endif
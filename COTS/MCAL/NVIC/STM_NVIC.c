@@ -24,10 +24,14 @@
 /* In AIRCR priority group bits [10:8] */
 
 #define NORMAL_REG_WIDTH        32U
+#define IRQ_REGS_COUNT          8U
+#define MSK_ALL_IRQS            0xFFFFFFFF
 #define BITS_IMPLMENTED_NO      4U
 #define MAX_PRIORITY_LEVEL      16U
-#define M4_VOTR_SHIFT           9U
-#define M4_VOTR_MSK             0xC00001FF
+/* 16 system exceptions + 85 IRQs of STM32F401, table is aligned to its size rounded up to a power of 2 */
+#define VECTOR_TABLE_ENTRIES    101
+#define VECTOR_TABLE_ALIGNMENT  512
+#define MSK_VTOR_ALIGNMENT      (VECTOR_TABLE_ALIGNMENT - 1)
 #define AIRCR_ACCSESS_KEY       0x05FA0000
 #define PRIORITY_GROUP_SHIFT    8
 #define GET_PRIORITY_GROUPING   0xAF
@@ -60,6 +64,8 @@ typedef struct
 
 static volatile NVICRegisters_t* const nvicRegs = (volatile NVICRegisters_t* const) (0xE000E100);
 
+static u32 ramVectorTable [VECTOR_TABLE_ENTRIES] __attribute__((aligned(VECTOR_TABLE_ALIGNMENT)));
+
 static NVIC_ErrorStatus_t getPriorityGrouping(pu8 priorityGroup);
 
 NVIC_ErrorStatus_t nvic_enableIRQ(IRQ_Type_t nvic_IRQ)
@@ -130,6 +136,21 @@ NVIC_ErrorStatus_t nvic_clearPendingIRQ(IRQ_Type_t nvic_IRQ)
     return errorStatus;
 }
 
+NVIC_ErrorStatus_t nvic_disableAllIRQs(void)
+{
+    u8 regNo;
+    /* ICER and ICPR are write 1 to clear, zeros don't change the other IRQs */
+    for(regNo = 0; regNo < IRQ_REGS_COUNT; regNo++)
+    {
+        nvicRegs->ICER[regNo] = MSK_ALL_IRQS;
+        nvicRegs->ICPR[regNo] = MSK_ALL_IRQS;
+    }
+    SCB_ICSR = (1 << ICSR_PENDSTCLR) | (1 << ICSR_PENDSVCLR);
+    __asm("DSB");
+    __asm("ISB");
+    return nvic_retOk;
+}
+
 NVIC_ErrorStatus_t nvic_getPendingState(IRQ_Type_t nvic_IRQ, pu8 pendingState)
 {
     NVIC_ErrorStatus_t errorStatus = nvic_retNotOk;
@@ -423,8 +444,29 @@ NVIC_ErrorStatus_t nvic_getPriorityGrouping(pu8 priorityGroup)
 
 NVIC_ErrorStatus_t nvic_reallocateVectorTable(u32 vectAddress)
 {
-    SCB_VTOR &= (vectAddress << M4_VOTR_SHIFT) | M4_VOTR_MSK;
-    return nvic_retOk;
+    NVIC_ErrorStatus_t errorStatus = nvic_retNotOk;
+    if(vectAddress & MSK_VTOR_ALIGNMENT)
+    {
+        errorStatus = nvic_retInvalidVectorTableAddress;
+    }
+    else
+    {
+        SCB_VTOR = vectAddress;
+        __asm("DSB");
+        errorStatus = nvic_retOk;
+    }
+    return errorStatus;
+}
+
+NVIC_ErrorStatus_t nvic_relocateVectorTableToRam(void)
+{
+    const u32* currentTable = (const u32*) SCB_VTOR;
+    u8 index;
+    for(index = 0; index < VECTOR_TABLE_ENTRIES; index++)
+    {
+        ramVectorTable[index] = currentTable[index];
+    }
+    return nvic_reallocateVectorTable((u32) ramVectorTable);
 }
 
 NVIC_ErrorStatus_t nvic_getRunningISR(pu16 runningISR)
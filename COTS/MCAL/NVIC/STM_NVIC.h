@@ -27,6 +27,7 @@ typedef enum
     nvic_retInvalidPriorityGroup,
     nvic_retInvalidPrioritySetting,
     nvic_retInvalidPreemptionSetting,
+    nvic_retInvalidVectorTableAddress,
 }NVIC_ErrorStatus_t;
 
 typedef enum
@@ -281,6 +282,9 @@ NVIC_ErrorStatus_t nvic_setPendingIRQ(IRQ_Type_t nvic_IRQ);
 
 NVIC_ErrorStatus_t nvic_clearPendingIRQ(IRQ_Type_t nvic_IRQ);
 
+/* disables and clears pending all IRQs, clears pending SysTick and PendSV (before jumping to another image) */
+NVIC_ErrorStatus_t nvic_disableAllIRQs(void);
+
 NVIC_ErrorStatus_t nvic_getPendingState(IRQ_Type_t nvic_IRQ, pu8 pendingState);
 
 NVIC_ErrorStatus_t nvic_getActiveState(IRQ_Type_t nvic_IRQ, pu8 activateState);
@@ -301,6 +305,9 @@ NVIC_ErrorStatus_t nvic_getPriorityGrouping(pu8 priorityGroup);
 
 NVIC_ErrorStatus_t nvic_reallocateVectorTable(u32 vectAddress);
 
+/* copies the running vector table to a 512 bytes aligned SRAM table and moves VTOR to it */
+NVIC_ErrorStatus_t nvic_relocateVectorTableToRam(void);
+
 NVIC_ErrorStatus_t nvic_getRunningISR(pu16 runningISR);
 
 NVIC_ErrorStatus_t nvic_setPRIMASK(void);
@@ -6,6 +6,7 @@
 *   Version: v1.0
 *******************************************************************/
 #include "STM_RCC.h"
+#include "../FlashDriver/FLASH.h"
 
 #define TIME_OUT                      ((u32) 20000)
 
@@ -30,6 +31,11 @@
 
 #define RTC_PRESC_SHIFT               16
 
+#define RCC_HSI_CLOCK                 ((u32) 16000000)
+#define MSK_READ_HPRE                 0x000000F0
+#define HPRE_SHIFT                    4
+#define HPRE_DIVIDED                  8       /* HPRE values below it don't divide SYSCLK */
+
 #define MSK_HSI_RDY                   0x00000002
 #define MSK_HSE_RDY                   0x00020000
 #define MSK_PLL_RDY                   0x02000000
@@ -185,6 +191,10 @@ typedef struct
 volatile rccRegisters_t* const rccRegs = (volatile rccRegisters_t* const)  0x40023800;
 
 static RCC_ErrorStatus_t rcc_getRunningSyetmClock(pu32 clock);
+static u32 rcc_calculateHclk(u32 systemClock, u32 cfgr);
+
+/* HCLK = SYSCLK >> shift of HPRE 1000:1111 (/2 to /512, /32 doesn't exist) */
+static const u8 hpreShift [] = {1, 2, 3, 4, 6, 7, 8, 9};
 
 RCC_ErrorStatus_t rcc_selectSystemClock(u32 systemClock)
 {
@@ -196,7 +206,17 @@ RCC_ErrorStatus_t rcc_selectSystemClock(u32 systemClock)
         errorStatus = rcc_retClockAlreadySelected;
     }
     else{
-        if((systemClock & MSK_CHECK_VALID_SYS_CLK) == MSK_VALID_SYS_CLK)
+        u32 newHclk = rcc_calculateHclk(systemClock, rccRegs->RCC_CFGR);
+        if((systemClock & MSK_CHECK_VALID_SYS_CLK) != MSK_VALID_SYS_CLK)
+        {
+            errorStatus = rcc_retInvalidSystemClock;
+        }
+        else if(flash_clockChangeHook(newHclk) != flash_retOk)
+        {
+            /* running the new clock with the wait states of the current one would corrupt flash reads */
+            errorStatus = rcc_retFlashLatencyError;
+        }
+        else
         {
             u32 timeOutCounter = TIME_OUT;
             rccRegs->RCC_CR |= (systemClock & MSK_CHECL_VALID_SYS_CLK_CLR);
@@ -266,10 +286,11 @@ RCC_ErrorStatus_t rcc_selectSystemClock(u32 systemClock)
                     }
                     break;
             }
-        }
-        else
-        {
-            errorStatus = rcc_retInvalidSystemClock;
+            if(errorStatus == rcc_retOk)
+            {
+                /* wait states left raised (flash busy) are only slower */
+                flash_setLatencyForClock(newHclk);
+            }
         }
     }
     return errorStatus;
@@ -611,6 +632,7 @@ RCC_ErrorStatus_t rcc_setBusPrescaler(u8 prescalerBus, u8 busPrescaler)
         if ((busPrescaler & MSK_CHECK_VALID_PRESC) == MSK_VALID_PRESC)
         {
             u32 temp = rccRegs->RCC_CFGR;
+            u32 clock = systemClock_HSI;
             busPrescaler &= MSK_CHECK_VALID_PRESC_CLR;
             switch (prescalerBus)
             {
@@ -628,8 +650,23 @@ RCC_ErrorStatus_t rcc_setBusPrescaler(u8 prescalerBus, u8 busPrescaler)
                     temp |= busPrescaler << (prescalerBus & MSK_CHECK_VALID_BUS_PRE_CLR);
                     break;
             }
-            rccRegs->RCC_CFGR = temp;
-            errorStatus = rcc_retOk;
+            if(prescalerBus != prescalerBus_AHB)
+            {
+                rccRegs->RCC_CFGR = temp;
+                errorStatus = rcc_retOk;
+            }
+            else if(rcc_getRunningSyetmClock(&clock) != rcc_retOk
+                    || flash_clockChangeHook(rcc_calculateHclk(clock, temp)) != flash_retOk)
+            {
+                /* HCLK raised by a smaller prescaler needs the wait states first */
+                errorStatus = rcc_retFlashLatencyError;
+            }
+            else
+            {
+                rccRegs->RCC_CFGR = temp;
+                flash_setLatencyForClock(rcc_calculateHclk(clock, temp));
+                errorStatus = rcc_retOk;
+            }
         }
         else
         {
@@ -780,3 +817,36 @@ static RCC_ErrorStatus_t rcc_getRunningSyetmClock(pu32 clock)
     }
     return errorStatus;
 }
+
+/* HCLK (Hz) of systemClock with the AHB prescaler of cfgr, 0 for an invalid clock or PLL config */
+static u32 rcc_calculateHclk(u32 systemClock, u32 cfgr)
+{
+    u32 sysclk = 0;
+    u32 pllcfgr = rccRegs->RCC_PLLCFGR;
+    u32 hpre = (cfgr & MSK_READ_HPRE) >> HPRE_SHIFT;
+    u32 m = (pllcfgr & MSK_READ_M_VAL) >> PLL_MVAL_SHIFT;
+    u32 n = (pllcfgr & MSK_READ_N_VAL) >> PLL_NVAL_SHIFT;
+    /* PLLP 00: /2, 01: /4, 10: /6, 11: /8 */
+    u32 p = (((pllcfgr & MSK_READ_P_VAL) >> PLL_PVAL_SHIFT) + 1) * 2;
+    switch (systemClock)
+    {
+        case systemClock_HSI:
+            sysclk = RCC_HSI_CLOCK;
+            break;
+        case systemClock_HSE:
+            sysclk = RCC_HSE_CLOCK;
+            break;
+        case systemClock_PLL:
+            if(m >= PLL_MIN_MVAL)
+            {
+                sysclk = (pllcfgr & MSK_READ_PLL_SRC) ? RCC_HSE_CLOCK : RCC_HSI_CLOCK;
+                sysclk = (u32) (((u64) sysclk * n) / (m * p));
+            }
+            break;
+    }
+    if(hpre >= HPRE_DIVIDED)
+    {
+        sysclk >>= hpreShift[hpre - HPRE_DIVIDED];
+    }
+    return sysclk;
+}
@@ -10,6 +10,11 @@
 
 #include "../../LIB/Std_types.h"
 
+/* frequency of the HSE crystal of the board (Hz), used for the flash wait states of a clock switch */
+#ifndef RCC_HSE_CLOCK
+#define RCC_HSE_CLOCK           ((u32) 25000000)
+#endif
+
 #define systemClock_HSI         0x10000001
 #define systemClock_HSE         0x10010000
 #define systemClock_PLL         0x11000000
@@ -119,6 +124,7 @@ typedef enum
     rcc_retClockNotReady,
     rcc_retConfigError,
     rcc_retInvalidPrescaler,
+    rcc_retFlashLatencyError,
 }RCC_ErrorStatus_t;
 
 /**********************************************************
@@ -132,6 +138,11 @@ typedef enum
                       - rcc_retInvalidSystemClock (for invalid input from mentioned above)
                       - rcc_retNotOk (if couldn't select clock as system clock)
                       - rcc_retSelectSystemClockTimeOut (if clock didn't be ready within timeout, so can't be selected as system clock)
+                      - rcc_retFlashLatencyError (if the flash wait states couldn't be raised for the new HCLK, flash busy
+                        or HCLK above 84MHz, the clock isn't switched)
+
+    Note:             The flash wait states are raised (flash_clockChangeHook) before the switch and set to the
+                      minimum of the new HCLK (flash_setLatencyForClock) after it, FLASH.c must be linked
 ***********************************************************/
 RCC_ErrorStatus_t rcc_selectSystemClock(u32 systemClock);
 
@@ -324,6 +335,7 @@ RCC_ErrorStatus_t rcc_resetPeripheral(u32 peripheralBus, u32 peripheral);
                        - rcc_retInvalidBus (if got an input  is different from the accepted inputs mentioned above)
                        - rcc_retOk (if the prescaler is selected successfully)
                        - rcc_retNotOk (if couldn't set prescaler)       
+                       - rcc_retFlashLatencyError (AHB only, as for rcc_selectSystemClock, the prescaler isn't changed)
 ***********************************************************/
 RCC_ErrorStatus_t rcc_setBusPrescaler(u8 prescalerBus, u8 busPrescaler);
 
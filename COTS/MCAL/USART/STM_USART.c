@@ -7,6 +7,7 @@
 *******************************************************************/
 
 #include "STM_USART.h"
+#include "../../LIB/Ram_func.h"
 #include <math.h>
 
 #define USART_TIME_OUT          600000UL
@@ -148,9 +149,9 @@ typedef struct
     u32 USART_GTPR;
 }USARTRegs_t;
 
-extern void USART1_IRQHandler(void);
-extern void USART2_IRQHandler(void);
-extern void USART6_IRQHandler(void);
+extern RAM_FUNC void USART1_IRQHandler(void);
+extern RAM_FUNC void USART2_IRQHandler(void);
+extern RAM_FUNC void USART6_IRQHandler(void);
 
 static u8 asyncTxFlag[USART_HANDLERS], asyncRxFlag[USART_HANDLERS], sendDmaFlag[USART_HANDLERS], recieveDmaFlag[USART_HANDLERS];
 static usartSendCallBack_t asyncTxCharCallback[USART_HANDLERS], sendBufferCallbacks[USART_HANDLERS], sendDmaCallbacks[USART_HANDLERS];
@@ -992,7 +993,7 @@ static USART_ErrorStatus_t recieveCharSync(u32 usartId, pu8 usartChar)
     return errorStatus;
 }
 
-void USART1_IRQHandler(void)
+RAM_FUNC void USART1_IRQHandler(void)
 {
     if(CAST_USART_REG(USART1_BASE_ADD)->USART_SR & MSK_LBD)
     {
@@ -1104,7 +1105,7 @@ void USART1_IRQHandler(void)
     }
 }
 
-void USART2_IRQHandler(void)
+RAM_FUNC void USART2_IRQHandler(void)
 {
     if(CAST_USART_REG(USART2_BASE_ADD)->USART_SR & MSK_LBD)
     {
@@ -1215,7 +1216,7 @@ void USART2_IRQHandler(void)
     }
 }
 
-void USART6_IRQHandler(void)
+RAM_FUNC void USART6_IRQHandler(void)
 {
     if(CAST_USART_REG(USART6_BASE_ADD)->USART_SR & MSK_LBD)
     {
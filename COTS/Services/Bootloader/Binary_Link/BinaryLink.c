@@ -0,0 +1,484 @@
+/**
+ * @file BinaryLink.c
+ * @author Ibrahim Saad
+ * @brief This is the source file of the binary transfer stage of the bootloader
+ * @version 0.1
+ * @date 2023-06-18
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "BinaryLink.h"
+#include "../Flash_Writer/FlashWriter.h"
+#include "../Lzss_Stream/LzssStream.h"
+#include "../Delta_Patch/DeltaPatch.h"
+#include "../../../LIB/Soft_CRC/Soft_crc.h"
+#include "../../../LIB/Address.h"
+
+#define START_PAYLOAD_SIZE          8
+#define START_FORMAT_PAYLOAD_SIZE   16
+#define START_DELTA_PAYLOAD_SIZE    20
+#define END_PAYLOAD_SIZE            4
+#define ERROR_PAYLOAD_SIZE          1
+
+#define OFFSET_TYPE                 0           /* offsets in frame[], the SOF isn't stored */
+#define OFFSET_SEQUENCE             1
+#define OFFSET_LENGTH               3
+#define OFFSET_PAYLOAD              5
+
+#define STATE_IDLE                  0           /* binaryLink_init not called */
+#define STATE_WAIT_START            1
+#define STATE_RUNNING               2
+#define STATE_DONE                  3
+#define STATE_STOPPED               4           /* error sent, waiting for a new start */
+
+static u8 state = STATE_IDLE;
+static BinaryLink_ErrorStatus_t stopStatus = binaryLink_retNotOk;
+static binaryLinkSend_t sendFrame = NULL;
+static u32 windowStart = 0;
+static u32 windowEnd = 0;
+static u32 baseAddress = 0;
+static u32 baseSize = 0;
+static u32 imageAddress = 0;
+static u32 imageSize = 0;
+static u32 streamSize = 0;                      /* bytes sent in data frames */
+static u32 imageFormat = BINARY_LINK_FORMAT_RAW;
+static u32 writtenSize = 0;                     /* bytes given to the flash writer by a decoder */
+static BinaryLink_ErrorStatus_t sinkWriteStatus = binaryLink_retOk;
+static u16 chunksCount = 0;
+static u16 expectedChunk = 0;
+static u8 nakSent = 0;                          /* one NAK per expected chunk */
+
+static u8 frame [BINARY_LINK_FRAME_SIZE - 1];
+static u16 frameSize = 0;                       /* received bytes after the SOF */
+static u16 frameEnd = 0;                        /* frame size after the SOF, 0 out of a frame */
+static u8 answer [BINARY_LINK_HEADER_SIZE + ERROR_PAYLOAD_SIZE + BINARY_LINK_CRC_SIZE];
+
+static void handleFrame(void);
+static void handleStart(const u8* payload, u16 length);
+static void handleData(u16 sequence, const u8* payload, u16 length);
+static void handleEnd(const u8* payload, u16 length);
+static BinaryLink_ErrorStatus_t writeChunk(u32 offset, const u8* payload, u16 length);
+static u8 imageSink(const u8* data, u32 length);
+static void stopTransfer(BinaryLink_ErrorStatus_t errorStatus);
+static BinaryLink_ErrorStatus_t writerToLinkStatus(FlashWriter_ErrorStatus_t writerStatus);
+static void sendAnswer(u8 type, u16 sequence, const u8* payload, u16 length);
+static u16 readU16(const u8* bytes);
+static u32 readU32(const u8* bytes);
+static void writeU16(u8* bytes, u16 value);
+static void writeU32(u8* bytes, u32 value);
+
+BinaryLink_ErrorStatus_t binaryLink_init(u32 startAddress, u32 endAddress, binaryLinkSend_t send)
+{
+    BinaryLink_ErrorStatus_t errorStatus = binaryLink_retNotOk;
+    if(!send)
+    {
+        errorStatus = binaryLink_retNullPointer;
+    }
+    else if(endAddress <= startAddress)
+    {
+        errorStatus = binaryLink_retInvalidAddress;
+    }
+    else
+    {
+        sendFrame = send;
+        windowStart = startAddress;
+        windowEnd = endAddress;
+        frameEnd = 0;
+        state = STATE_WAIT_START;
+        errorStatus = binaryLink_retOk;
+    }
+    return errorStatus;
+}
+
+BinaryLink_ErrorStatus_t binaryLink_setBaseImage(u32 address, u32 size)
+{
+    BinaryLink_ErrorStatus_t errorStatus = binaryLink_retNotOk;
+    if(state == STATE_RUNNING)
+    {
+        errorStatus = binaryLink_retBusy;
+    }
+    else
+    {
+        baseAddress = address;
+        baseSize = size;
+        errorStatus = binaryLink_retOk;
+    }
+    return errorStatus;
+}
+
+BinaryLink_ErrorStatus_t binaryLink_feed(const u8* bytes, u32 count)
+{
+    BinaryLink_ErrorStatus_t errorStatus = binaryLink_retNotOk;
+    if(!bytes)
+    {
+        errorStatus = binaryLink_retNullPointer;
+    }
+    else if(state == STATE_IDLE)
+    {
+        errorStatus = binaryLink_retNotStarted;
+    }
+    else
+    {
+        u32 i;
+        for(i = 0; i < count; i++)
+        {
+            if(!frameEnd)
+            {
+                if(bytes[i] == BINARY_LINK_SOF)
+                {
+                    frameSize = 0;
+                    frameEnd = BINARY_LINK_HEADER_SIZE - 1;
+                }
+            }
+            else
+            {
+                frame[frameSize] = bytes[i];
+                frameSize++;
+                if(frameSize == BINARY_LINK_HEADER_SIZE - 1)
+                {
+                    u16 length = readU16(&frame[OFFSET_LENGTH]);
+                    /* a too long frame is a corrupted header, look for the next SOF */
+                    frameEnd = (length <= BINARY_LINK_CHUNK_SIZE) ? frameSize + length + BINARY_LINK_CRC_SIZE : 0;
+                }
+                else if(frameSize == frameEnd)
+                {
+                    frameEnd = 0;
+                    handleFrame();
+                }
+            }
+        }
+        errorStatus = binaryLink_getStatus();
+    }
+    return errorStatus;
+}
+
+BinaryLink_ErrorStatus_t binaryLink_getStatus(void)
+{
+    BinaryLink_ErrorStatus_t errorStatus = binaryLink_retNotOk;
+    switch(state)
+    {
+        case STATE_IDLE:
+            errorStatus = binaryLink_retNotStarted;
+            break;
+        case STATE_DONE:
+            errorStatus = binaryLink_retDone;
+            break;
+        case STATE_STOPPED:
+            errorStatus = stopStatus;
+            break;
+        default:
+            errorStatus = binaryLink_retBusy;
+            break;
+    }
+    return errorStatus;
+}
+
+static void handleFrame(void)
+{
+    u16 length = readU16(&frame[OFFSET_LENGTH]);
+    u32 crc = softCrc_updateBytes(SOFT_CRC_INIT, frame, OFFSET_PAYLOAD + length);
+    if(crc != readU32(&frame[OFFSET_PAYLOAD + length]))
+    {
+        /* the sequence of a corrupted frame can't be trusted, ask for the expected one */
+        if(state == STATE_RUNNING && !nakSent)
+        {
+            nakSent = 1;
+            sendAnswer(BINARY_LINK_FRAME_NAK, expectedChunk, NULL, 0);
+        }
+    }
+    else if(frame[OFFSET_TYPE] == BINARY_LINK_FRAME_START)
+    {
+        handleStart(&frame[OFFSET_PAYLOAD], length);
+    }
+    else if(frame[OFFSET_TYPE] == BINARY_LINK_FRAME_DATA)
+    {
+        handleData(readU16(&frame[OFFSET_SEQUENCE]), &frame[OFFSET_PAYLOAD], length);
+    }
+    else if(frame[OFFSET_TYPE] == BINARY_LINK_FRAME_END)
+    {
+        handleEnd(&frame[OFFSET_PAYLOAD], length);
+    }
+    else
+    {
+        /* unknown frames are dropped */
+    }
+}
+
+/* a new start in any state begins a new transfer, so the host can restart after an error or a reset */
+static void handleStart(const u8* payload, u16 length)
+{
+    u32 address = readU32(&payload[0]);
+    u32 size = readU32(&payload[4]);
+    u32 stream = (length >= START_FORMAT_PAYLOAD_SIZE) ? readU32(&payload[8]) : size;
+    u32 format = (length >= START_FORMAT_PAYLOAD_SIZE) ? readU32(&payload[12]) : BINARY_LINK_FORMAT_RAW;
+    if((length != START_PAYLOAD_SIZE && length != START_FORMAT_PAYLOAD_SIZE && length != START_DELTA_PAYLOAD_SIZE)
+       || (format == BINARY_LINK_FORMAT_RAW && stream != size) || format > BINARY_LINK_FORMAT_DELTA || !stream
+       || ((format == BINARY_LINK_FORMAT_DELTA) != (length == START_DELTA_PAYLOAD_SIZE)))
+    {
+        stopTransfer(binaryLink_retInvalidFrame);
+    }
+    else if(state == STATE_RUNNING && !expectedChunk && address == imageAddress && size == imageSize
+            && stream == streamSize && format == imageFormat)
+    {
+        /* the ACK was lost, the range is already erased */
+        sendAnswer(BINARY_LINK_FRAME_ACK, expectedChunk, NULL, 0);
+    }
+    else if(address < windowStart || address >= windowEnd || !size || size > windowEnd - address
+            || (stream + BINARY_LINK_CHUNK_SIZE - 1) / BINARY_LINK_CHUNK_SIZE > 0xFFFF)
+    {
+        stopTransfer(binaryLink_retInvalidAddress);
+    }
+    else if(format == BINARY_LINK_FORMAT_DELTA && (!baseSize || (address < baseAddress + baseSize && baseAddress < address + size)))
+    {
+        /* the new image can't be written over the image it's made from */
+        stopTransfer(binaryLink_retInvalidAddress);
+    }
+    else if(format == BINARY_LINK_FORMAT_DELTA
+            && softCrc_updateBytes(SOFT_CRC_INIT, TO_POINTER(baseAddress), baseSize) != readU32(&payload[16]))
+    {
+        stopTransfer(binaryLink_retBaseImageMismatch);
+    }
+    else
+    {
+        BinaryLink_ErrorStatus_t errorStatus = binaryLink_retBusy;
+        while(errorStatus == binaryLink_retBusy)
+        {
+            /* blocks of a previous transfer may still be in programming */
+            errorStatus = writerToLinkStatus(flashWriter_begin(address, address + size));
+        }
+        if(errorStatus != binaryLink_retOk)
+        {
+            stopTransfer(errorStatus);
+        }
+        else
+        {
+            imageAddress = address;
+            imageSize = size;
+            streamSize = stream;
+            imageFormat = format;
+            writtenSize = 0;
+            chunksCount = (u16) ((stream + BINARY_LINK_CHUNK_SIZE - 1) / BINARY_LINK_CHUNK_SIZE);
+            if(format == BINARY_LINK_FORMAT_LZSS)
+            {
+                lzssStream_begin(size, imageSink);
+            }
+            else if(format == BINARY_LINK_FORMAT_DELTA)
+            {
+                deltaPatch_begin(baseAddress, baseSize, size, imageSink);
+            }
+            expectedChunk = 0;
+            nakSent = 0;
+            state = STATE_RUNNING;
+            sendAnswer(BINARY_LINK_FRAME_ACK, expectedChunk, NULL, 0);
+        }
+    }
+}
+
+static void handleData(u16 sequence, const u8* payload, u16 length)
+{
+    if(state == STATE_RUNNING && sequence == expectedChunk)
+    {
+        u32 offset = (u32) sequence * BINARY_LINK_CHUNK_SIZE;
+        u32 chunkSize = (streamSize - offset < BINARY_LINK_CHUNK_SIZE) ? streamSize - offset : BINARY_LINK_CHUNK_SIZE;
+        if(sequence >= chunksCount || length != chunkSize)
+        {
+            stopTransfer(binaryLink_retInvalidFrame);
+        }
+        else
+        {
+            BinaryLink_ErrorStatus_t errorStatus = writeChunk(offset, payload, length);
+            if(errorStatus != binaryLink_retOk)
+            {
+                stopTransfer(errorStatus);
+            }
+            else
+            {
+                expectedChunk++;
+                nakSent = 0;
+                sendAnswer(BINARY_LINK_FRAME_ACK, expectedChunk, NULL, 0);
+            }
+        }
+    }
+    else if(state == STATE_RUNNING && sequence > expectedChunk)
+    {
+        /* a chunk was lost, next ones are dropped until the expected one is sent again */
+        if(!nakSent)
+        {
+            nakSent = 1;
+            sendAnswer(BINARY_LINK_FRAME_NAK, expectedChunk, NULL, 0);
+        }
+    }
+    else if(state == STATE_RUNNING || state == STATE_DONE)
+    {
+        /* duplicate, the ACK was lost or the host went back too far */
+        sendAnswer(BINARY_LINK_FRAME_ACK, expectedChunk, NULL, 0);
+    }
+    else
+    {
+        /* no transfer, dropped */
+    }
+}
+
+static void handleEnd(const u8* payload, u16 length)
+{
+    if(state == STATE_DONE)
+    {
+        /* the last ACK was lost */
+        sendAnswer(BINARY_LINK_FRAME_ACK, expectedChunk, NULL, 0);
+    }
+    else if(state != STATE_RUNNING)
+    {
+        /* no transfer, dropped */
+    }
+    else if(length != END_PAYLOAD_SIZE || expectedChunk != chunksCount)
+    {
+        stopTransfer(binaryLink_retInvalidFrame);
+    }
+    else
+    {
+        BinaryLink_ErrorStatus_t errorStatus = binaryLink_retOk;
+        if((imageFormat == BINARY_LINK_FORMAT_LZSS && lzssStream_feed(payload, 0) != lzssStream_retDone)
+           || (imageFormat == BINARY_LINK_FORMAT_DELTA && deltaPatch_getStatus() != deltaPatch_retDone))
+        {
+            /* the stream ended before the image */
+            errorStatus = binaryLink_retDecodeError;
+        }
+        if(errorStatus == binaryLink_retOk)
+        {
+            errorStatus = writerToLinkStatus(flashWriter_flush());
+        }
+        while(errorStatus == binaryLink_retOk && flashWriter_getStatus() == flashWriter_retBusy)
+        {
+        }
+        if(errorStatus == binaryLink_retOk)
+        {
+            errorStatus = writerToLinkStatus(flashWriter_getStatus());
+        }
+        if(errorStatus != binaryLink_retOk)
+        {
+            stopTransfer(errorStatus);
+        }
+        else if(softCrc_updateBytes(SOFT_CRC_INIT, TO_POINTER(imageAddress), imageSize) != readU32(payload))
+        {
+            stopTransfer(binaryLink_retImageCrcError);
+        }
+        else
+        {
+            state = STATE_DONE;
+            sendAnswer(BINARY_LINK_FRAME_ACK, expectedChunk, NULL, 0);
+        }
+    }
+}
+
+/* data of a chunk at offset of the stream, decoded first if the image is compressed or a patch */
+static BinaryLink_ErrorStatus_t writeChunk(u32 offset, const u8* payload, u16 length)
+{
+    BinaryLink_ErrorStatus_t errorStatus = binaryLink_retNotOk;
+    if(imageFormat == BINARY_LINK_FORMAT_RAW)
+    {
+        errorStatus = writerToLinkStatus(flashWriter_write(imageAddress + offset, payload, length));
+    }
+    else if(imageFormat == BINARY_LINK_FORMAT_LZSS)
+    {
+        LzssStream_ErrorStatus_t streamStatus = lzssStream_feed(payload, length);
+        if(streamStatus == lzssStream_retBusy || streamStatus == lzssStream_retDone)
+        {
+            errorStatus = binaryLink_retOk;
+        }
+        else
+        {
+            errorStatus = (streamStatus == lzssStream_retSinkError) ? sinkWriteStatus : binaryLink_retDecodeError;
+        }
+    }
+    else
+    {
+        DeltaPatch_ErrorStatus_t patchStatus = deltaPatch_feed(payload, length);
+        if(patchStatus == deltaPatch_retBusy || patchStatus == deltaPatch_retDone)
+        {
+            errorStatus = binaryLink_retOk;
+        }
+        else
+        {
+            errorStatus = (patchStatus == deltaPatch_retSinkError) ? sinkWriteStatus : binaryLink_retDecodeError;
+        }
+    }
+    return errorStatus;
+}
+
+static u8 imageSink(const u8* data, u32 length)
+{
+    sinkWriteStatus = writerToLinkStatus(flashWriter_write(imageAddress + writtenSize, data, length));
+    writtenSize += length;
+    return (sinkWriteStatus == binaryLink_retOk);
+}
+
+static void stopTransfer(BinaryLink_ErrorStatus_t errorStatus)
+{
+    u8 code = (u8) errorStatus;
+    stopStatus = errorStatus;
+    state = STATE_STOPPED;
+    sendAnswer(BINARY_LINK_FRAME_ERROR, expectedChunk, &code, ERROR_PAYLOAD_SIZE);
+}
+
+static BinaryLink_ErrorStatus_t writerToLinkStatus(FlashWriter_ErrorStatus_t writerStatus)
+{
+    BinaryLink_ErrorStatus_t errorStatus = binaryLink_retFlashError;
+    switch(writerStatus)
+    {
+        case flashWriter_retOk:
+            errorStatus = binaryLink_retOk;
+            break;
+        case flashWriter_retBusy:
+            errorStatus = binaryLink_retBusy;
+            break;
+        case flashWriter_retInvalidAddress:
+            errorStatus = binaryLink_retInvalidAddress;
+            break;
+        default:
+            errorStatus = binaryLink_retFlashError;
+            break;
+    }
+    return errorStatus;
+}
+
+static void sendAnswer(u8 type, u16 sequence, const u8* payload, u16 length)
+{
+    u16 i;
+    answer[0] = BINARY_LINK_SOF;
+    answer[1 + OFFSET_TYPE] = type;
+    writeU16(&answer[1 + OFFSET_SEQUENCE], sequence);
+    writeU16(&answer[1 + OFFSET_LENGTH], length);
+    for(i = 0; i < length; i++)
+    {
+        answer[BINARY_LINK_HEADER_SIZE + i] = payload[i];
+    }
+    writeU32(&answer[BINARY_LINK_HEADER_SIZE + length],
+             softCrc_updateBytes(SOFT_CRC_INIT, &answer[1], BINARY_LINK_HEADER_SIZE - 1 + length));
+    sendFrame(answer, BINARY_LINK_HEADER_SIZE + length + BINARY_LINK_CRC_SIZE);
+}
+
+static u16 readU16(const u8* bytes)
+{
+    return (u16) (bytes[0] | (bytes[1] << 8));
+}
+
+static u32 readU32(const u8* bytes)
+{
+    return (u32) bytes[0] | ((u32) bytes[1] << 8) | ((u32) bytes[2] << 16) | ((u32) bytes[3] << 24);
+}
+
+static void writeU16(u8* bytes, u16 value)
+{
+    bytes[0] = (u8) value;
+    bytes[1] = (u8) (value >> 8);
+}
+
+static void writeU32(u8* bytes, u32 value)
+{
+    bytes[0] = (u8) value;
+    bytes[1] = (u8) (value >> 8);
+    bytes[2] = (u8) (value >> 16);
+    bytes[3] = (u8) (value >> 24);
+}
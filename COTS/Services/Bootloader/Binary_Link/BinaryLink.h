@@ -0,0 +1,112 @@
+/**
+ * @file BinaryLink.h
+ * @author Ibrahim Saad
+ * @brief This is the interface of the binary transfer stage of the bootloader, the image comes
+ *        in chunks of raw bytes with sequence numbers and a CRC per frame (no ASCII like Intel HEX)
+ *        and is given to the flash writer
+ * @version 0.1
+ * @date 2023-06-18
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef BINARY_LINK_H
+#define BINARY_LINK_H
+
+#include "../../../LIB/Std_types.h"
+
+#define BINARY_LINK_CHUNK_SIZE          256         /* data bytes of a full data frame */
+
+/* frame: SOF, type, sequence (u16), payload length (u16), payload, CRC (u32), fields are little endian */
+#define BINARY_LINK_SOF                 0x5A
+#define BINARY_LINK_HEADER_SIZE         6           /* SOF, type, sequence, length */
+#define BINARY_LINK_CRC_SIZE            4
+#define BINARY_LINK_FRAME_SIZE          (BINARY_LINK_HEADER_SIZE + BINARY_LINK_CHUNK_SIZE + BINARY_LINK_CRC_SIZE)
+
+/* host to device */
+#define BINARY_LINK_FRAME_START         0x01        /* payload: address, size [, stream size, format [, base image CRC]] (u32s) */
+#define BINARY_LINK_FRAME_DATA          0x02        /* sequence: chunk number, payload: data of the chunk */
+#define BINARY_LINK_FRAME_END           0x03        /* payload: softCrc_updateBytes of the image (u32) */
+/* format of the data frames, the image is sent as it is when the start frame has no format */
+#define BINARY_LINK_FORMAT_RAW          0
+#define BINARY_LINK_FORMAT_LZSS         1           /* LzssStream.h stream decoding to size bytes */
+#define BINARY_LINK_FORMAT_DELTA        2           /* DeltaPatch.h patch of the base image, the start frame has its CRC */
+
+/* device to host */
+#define BINARY_LINK_FRAME_ACK           0x81        /* sequence: next expected chunk, all chunks before it are written */
+#define BINARY_LINK_FRAME_NAK           0x82        /* sequence: next expected chunk, send again from it */
+#define BINARY_LINK_FRAME_ERROR         0x83        /* payload: BinaryLink_ErrorStatus_t (u8), the transfer is stopped */
+
+typedef enum
+{
+    binaryLink_retNotOk = 0,
+    binaryLink_retOk,
+    binaryLink_retNullPointer,
+    binaryLink_retNotStarted,
+    binaryLink_retInvalidAddress,       /* image out of the window of binaryLink_init */
+    binaryLink_retInvalidFrame,         /* frame not expected now (data before start, bad length) */
+    binaryLink_retFlashError,
+    binaryLink_retImageCrcError,        /* programmed image doesn't match the CRC of the end frame */
+    binaryLink_retDecodeError,          /* compressed stream or patch is corrupted or doesn't give size bytes */
+    binaryLink_retBaseImageMismatch,    /* base image isn't the one the patch was made from */
+    binaryLink_retBusy,                 /* transfer in progress */
+    binaryLink_retDone,                 /* image programmed and verified */
+}BinaryLink_ErrorStatus_t;
+
+/* sends a frame of size bytes to the host, the frame buffer is reused after the function returns */
+typedef void (*binaryLinkSend_t)(const u8* frame, u16 size);
+
+/*
+    Protocol (go-back-N):
+        - the host sends START and waits for ACK 0 (the device erases the sectors of the image first)
+        - the host sends up to its window of DATA frames ahead of the last ACK, the device takes only the
+          expected chunk and answers each frame by ACK (next expected), a duplicate is acknowledged again
+        - a bad CRC or a gap gives one NAK for the expected chunk, the host goes back to it, a lost frame
+          or answer is resent by the host after its timeout
+        - a compressed image (LZSS format) is decoded as its chunks come, in order, so the link carries
+          the stream size and the flash gets the image size
+        - a patch (DELTA format) is applied to the base image as its chunks come, the base image CRC of the
+          start frame is checked before the erase and the new image can't overlap the base image
+        - the host sends END with the CRC of the image, the device waits for the flash, checks the CRC
+          over the programmed image and answers ACK or ERROR
+    binaryLink_feed must be called from the main loop (not from the USART interrupt), the receiver buffers
+    the bytes coming while a frame is handled.
+*/
+
+/**********************************************************
+    Description:       This function is used to wait for a new transfer, images are accepted only in
+                       [startAddress, endAddress), answers are sent by send
+***********************************************************/
+BinaryLink_ErrorStatus_t binaryLink_init(u32 startAddress, u32 endAddress, binaryLinkSend_t send);
+
+
+
+
+/**********************************************************
+    Description:       This function is used to set the installed image (memory mapped) that patches
+                       are applied to, not while a transfer is running
+***********************************************************/
+BinaryLink_ErrorStatus_t binaryLink_setBaseImage(u32 address, u32 size);
+
+
+
+
+/**********************************************************
+    Description:       This function is used to pass count received bytes, complete frames are handled
+                       on their last byte
+
+    Return:            Returns BinaryLink_ErrorStatus_t
+                       - binaryLink_retBusy (if the transfer is going on)
+                       - binaryLink_retDone (if the image is programmed and verified)
+                       - the error sent to the host (if the transfer is stopped)
+***********************************************************/
+BinaryLink_ErrorStatus_t binaryLink_feed(const u8* bytes, u32 count);
+
+
+
+
+/* status of the transfer, as returned by binaryLink_feed */
+BinaryLink_ErrorStatus_t binaryLink_getStatus(void);
+
+#endif  /* BINARY_LINK_H */
@@ -0,0 +1,311 @@
+/**
+ * @file BootManager.c
+ * @author Ibrahim Saad
+ * @brief This is the source file of the A/B boot stage of the bootloader
+ * @version 0.1
+ * @date 2023-06-18
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "BootManager.h"
+#include "../../../MCAL/CRC_Unit/CRC.h"
+#include "../../../MCAL/NVIC/STM_NVIC.h"
+#include "../../../MCAL/SysTick/SysTick.h"
+
+#define MSK_THUMB_BIT               0x00000001
+
+/* value of a slot key in the key/value store */
+typedef struct
+{
+    u32 imageSize;
+    u32 imageCrc;
+    u32 sequence;                   /* +1 each commit, the highest one is the newest image */
+}bootSlotDescriptor_t;
+
+typedef struct
+{
+    u32 address;
+    u32 size;
+}bootSlot_t;
+
+static const bootSlot_t slots [BOOT_SLOTS_COUNT] =
+{
+    {BOOT_SLOT_A_ADDRESS, BOOT_SLOT_A_SIZE},
+    {BOOT_SLOT_B_ADDRESS, BOOT_SLOT_B_SIZE},
+};
+
+static bootSlotDescriptor_t descriptors [BOOT_SLOTS_COUNT];
+static u8 hasDescriptor [BOOT_SLOTS_COUNT];
+static u8 initialized = 0;
+static u8 activeSlot = BOOT_NO_SLOT;
+static u8 activeSelected = 0;               /* activeSlot is known, its CRC was checked once */
+static u8 updateSlot = BOOT_NO_SLOT;
+
+static BootManager_ErrorStatus_t checkImage(u8 slot, u32 imageSize, u32 imageCrc);
+static BootManager_ErrorStatus_t selectActiveSlot(void);
+static BootManager_ErrorStatus_t jumpToImage(u32 address);
+
+BootManager_ErrorStatus_t bootManager_init(void)
+{
+    BootManager_ErrorStatus_t errorStatus = bootManager_retOk;
+    u8 slot;
+    for(slot = 0; slot < BOOT_SLOTS_COUNT; slot++)
+    {
+        u16 length = 0;
+        KV_ErrorStatus_t kvStatus = kv_read(BOOT_FIRST_KV_KEY + slot, &descriptors[slot], sizeof(bootSlotDescriptor_t), &length);
+        hasDescriptor[slot] = (kvStatus == kv_retOk && length == sizeof(bootSlotDescriptor_t));
+        if(kvStatus != kv_retOk && kvStatus != kv_retKeyNotFound && kvStatus != kv_retBufferTooSmall)
+        {
+            errorStatus = bootManager_retStoreError;
+        }
+    }
+    activeSlot = BOOT_NO_SLOT;
+    activeSelected = 0;
+    updateSlot = BOOT_NO_SLOT;
+    initialized = (errorStatus == bootManager_retOk);
+    return errorStatus;
+}
+
+BootManager_ErrorStatus_t bootManager_checkSlot(u8 slot)
+{
+    BootManager_ErrorStatus_t errorStatus = bootManager_retNotOk;
+    if(!initialized)
+    {
+        errorStatus = bootManager_retNotInitialized;
+    }
+    else if(slot >= BOOT_SLOTS_COUNT)
+    {
+        errorStatus = bootManager_retInvalidSlot;
+    }
+    else if(!hasDescriptor[slot])
+    {
+        errorStatus = bootManager_retNoImage;
+    }
+    else
+    {
+        errorStatus = checkImage(slot, descriptors[slot].imageSize, descriptors[slot].imageCrc);
+    }
+    return errorStatus;
+}
+
+BootManager_ErrorStatus_t bootManager_boot(void)
+{
+    BootManager_ErrorStatus_t errorStatus = selectActiveSlot();
+    if(errorStatus == bootManager_retOk)
+    {
+        errorStatus = jumpToImage(slots[activeSlot].address);
+    }
+    return errorStatus;
+}
+
+BootManager_ErrorStatus_t bootManager_getActiveSlot(pu8 slot, pu32 address, pu32 imageSize)
+{
+    BootManager_ErrorStatus_t errorStatus = bootManager_retNotOk;
+    if(!slot || !address || !imageSize)
+    {
+        errorStatus = bootManager_retNullPointer;
+    }
+    else
+    {
+        errorStatus = selectActiveSlot();
+        *slot = activeSlot;
+        *address = (activeSlot == BOOT_NO_SLOT) ? 0 : slots[activeSlot].address;
+        *imageSize = (activeSlot == BOOT_NO_SLOT) ? 0 : descriptors[activeSlot].imageSize;
+    }
+    return errorStatus;
+}
+
+BootManager_ErrorStatus_t bootManager_beginUpdate(pu32 address, pu32 slotSize)
+{
+    BootManager_ErrorStatus_t errorStatus = bootManager_retNotOk;
+    if(!address || !slotSize)
+    {
+        errorStatus = bootManager_retNullPointer;
+    }
+    else
+    {
+        errorStatus = selectActiveSlot();
+        if(errorStatus == bootManager_retOk || errorStatus == bootManager_retNoValidImage)
+        {
+            /* first image goes to slot A */
+            u8 slot = (activeSlot == BOOT_SLOT_A) ? BOOT_SLOT_B : BOOT_SLOT_A;
+            KV_ErrorStatus_t kvStatus = hasDescriptor[slot] ? kv_delete(BOOT_FIRST_KV_KEY + slot) : kv_retOk;
+            if(kvStatus == kv_retBusy)
+            {
+                errorStatus = bootManager_retBusy;
+            }
+            else if(kvStatus != kv_retOk && kvStatus != kv_retKeyNotFound)
+            {
+                errorStatus = bootManager_retStoreError;
+            }
+            else
+            {
+                hasDescriptor[slot] = 0;
+                updateSlot = slot;
+                *address = slots[slot].address;
+                *slotSize = slots[slot].size;
+                errorStatus = bootManager_retOk;
+            }
+        }
+    }
+    return errorStatus;
+}
+
+BootManager_ErrorStatus_t bootManager_commitUpdate(u32 imageSize, u32 imageCrc)
+{
+    BootManager_ErrorStatus_t errorStatus = bootManager_retNotOk;
+    if(!initialized)
+    {
+        errorStatus = bootManager_retNotInitialized;
+    }
+    else if(updateSlot == BOOT_NO_SLOT)
+    {
+        errorStatus = bootManager_retInvalidSlot;
+    }
+    else
+    {
+        errorStatus = checkImage(updateSlot, imageSize, imageCrc);
+        if(errorStatus == bootManager_retOk)
+        {
+            bootSlotDescriptor_t descriptor;
+            u8 otherSlot = (updateSlot == BOOT_SLOT_A) ? BOOT_SLOT_B : BOOT_SLOT_A;
+            KV_ErrorStatus_t kvStatus;
+            descriptor.imageSize = imageSize;
+            descriptor.imageCrc = imageCrc;
+            descriptor.sequence = hasDescriptor[otherSlot] ? descriptors[otherSlot].sequence + 1 : 0;
+            kvStatus = kv_write(BOOT_FIRST_KV_KEY + updateSlot, &descriptor, sizeof(descriptor));
+            if(kvStatus == kv_retBusy)
+            {
+                errorStatus = bootManager_retBusy;
+            }
+            else if(kvStatus != kv_retOk)
+            {
+                errorStatus = bootManager_retStoreError;
+            }
+            else
+            {
+                descriptors[updateSlot] = descriptor;
+                hasDescriptor[updateSlot] = 1;
+                activeSlot = updateSlot;
+                activeSelected = 1;
+                updateSlot = BOOT_NO_SLOT;
+            }
+        }
+    }
+    return errorStatus;
+}
+
+/* vector table of the image then its CRC by the CPU feeding the CRC unit (the flash is read at its full speed) */
+static BootManager_ErrorStatus_t checkImage(u8 slot, u32 imageSize, u32 imageCrc)
+{
+    BootManager_ErrorStatus_t errorStatus = bootManager_retNotOk;
+    const u32* vectorTable = (const u32*) slots[slot].address;
+    if(imageSize < 2 * sizeof(u32) || imageSize > slots[slot].size)
+    {
+        errorStatus = bootManager_retInvalidLength;
+    }
+    else if(vectorTable[0] <= BOOT_SRAM_START || vectorTable[0] > BOOT_SRAM_END
+            || !(vectorTable[1] & MSK_THUMB_BIT)
+            || vectorTable[1] < slots[slot].address || vectorTable[1] >= slots[slot].address + imageSize)
+    {
+        errorStatus = bootManager_retInvalidImage;
+    }
+    else
+    {
+        crcContext_t context;
+        u32 crc = 0;
+        CRC_ErrorStatus_t crcStatus = crc_begin(&context);
+        if(crcStatus == crc_retOk)
+        {
+            crcStatus = crc_update(&context, vectorTable, imageSize);
+        }
+        if(crcStatus == crc_retOk)
+        {
+            crcStatus = crc_finish(&context, &crc);
+        }
+        if(crcStatus == crc_retBusy)
+        {
+            errorStatus = bootManager_retBusy;
+        }
+        else if(crcStatus != crc_retOk || crc != imageCrc)
+        {
+            errorStatus = bootManager_retCrcError;
+        }
+        else
+        {
+            errorStatus = bootManager_retOk;
+        }
+    }
+    return errorStatus;
+}
+
+/* newest slot first, the other one if it fails, the result is kept so a slot is checked once */
+static BootManager_ErrorStatus_t selectActiveSlot(void)
+{
+    BootManager_ErrorStatus_t errorStatus = bootManager_retNotOk;
+    if(!initialized)
+    {
+        errorStatus = bootManager_retNotInitialized;
+    }
+    else if(activeSelected)
+    {
+        errorStatus = (activeSlot == BOOT_NO_SLOT) ? bootManager_retNoValidImage : bootManager_retOk;
+    }
+    else
+    {
+        u8 newest = BOOT_SLOT_A;
+        u8 order;
+        /* sequences wrap, the newest is ahead by less than half of the range */
+        if(hasDescriptor[BOOT_SLOT_B]
+           && (!hasDescriptor[BOOT_SLOT_A] || (s32) (descriptors[BOOT_SLOT_B].sequence - descriptors[BOOT_SLOT_A].sequence) > 0))
+        {
+            newest = BOOT_SLOT_B;
+        }
+        errorStatus = bootManager_retNoValidImage;
+        for(order = 0; order < BOOT_SLOTS_COUNT && errorStatus == bootManager_retNoValidImage; order++)
+        {
+            u8 slot = order ? !newest : newest;
+            BootManager_ErrorStatus_t slotStatus = bootManager_checkSlot(slot);
+            if(slotStatus == bootManager_retOk)
+            {
+                activeSlot = slot;
+                errorStatus = bootManager_retOk;
+            }
+            else if(slotStatus == bootManager_retBusy)
+            {
+                errorStatus = bootManager_retBusy;
+            }
+        }
+        activeSelected = (errorStatus != bootManager_retBusy);
+    }
+    return errorStatus;
+}
+
+/* the peripherals and NVIC interrupts of the bootloader must be stopped before, the image starts as from reset */
+/* returns only if VTOR can't be moved to the image, the bootloader goes on as before */
+static BootManager_ErrorStatus_t jumpToImage(u32 address)
+{
+    BootManager_ErrorStatus_t errorStatus = bootManager_retInvalidImage;
+    const u32* vectorTable = (const u32*) address;
+    u32 stackPointer = vectorTable[0];
+    u32 resetHandler = vectorTable[1];
+    nvic_setPRIMASK();
+    if(nvic_reallocateVectorTable(address) != nvic_retOk)
+    {
+        nvic_clearPRIMASK();
+    }
+    else
+    {
+        /* IRQs of the bootloader (USART, FLASH, DMA) and SysTick must not reach the handlers of the
+           image before its reset code has run */
+        systick_stop();
+        nvic_disableAllIRQs();
+        nvic_clearPRIMASK();
+        /* nothing on the old stack is used after MSP is loaded */
+        __asm volatile("MSR msp, %0\n\tBX %1" :: "r"(stackPointer), "r"(resetHandler) : "memory");
+        errorStatus = bootManager_retOk;
+    }
+    return errorStatus;
+}
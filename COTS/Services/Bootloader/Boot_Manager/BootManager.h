@@ -0,0 +1,147 @@
+/**
+ * @file BootManager.h
+ * @author Ibrahim Saad
+ * @brief This is the interface of the A/B boot stage of the bootloader, it keeps two application
+ *        slots, boots the newest valid one after checking its CRC by the CRC unit and falls back to
+ *        the other one, updates go to the slot not booted
+ * @version 0.1
+ * @date 2023-06-18
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef BOOT_MANAGER_H
+#define BOOT_MANAGER_H
+
+#include "../../../LIB/Std_types.h"
+#include "../../../MCAL/FlashDriver/FLASH.h"
+#include "../../KV_Store/KV_Store.h"
+
+/*
+    Flash map: sector 0 is the bootloader, sectors 1:3 the key/value store (slot descriptors), the
+    slots start at sector 4, each one is whole sectors and is linked (vector table first) at its address
+*/
+#if FLASH_VARIANT == flashVariant_xC
+#define BOOT_SLOT_A_ADDRESS         0x08010000      /* sector 4 */
+#define BOOT_SLOT_A_SIZE            0x10000
+#define BOOT_SLOT_B_ADDRESS         0x08020000      /* sector 5 */
+#define BOOT_SLOT_B_SIZE            0x20000
+#elif FLASH_VARIANT == flashVariant_xD
+#define BOOT_SLOT_A_ADDRESS         0x08010000      /* sectors 4:5 */
+#define BOOT_SLOT_A_SIZE            0x30000
+#define BOOT_SLOT_B_ADDRESS         0x08040000      /* sector 6 */
+#define BOOT_SLOT_B_SIZE            0x20000
+#elif FLASH_VARIANT == flashVariant_xE
+#define BOOT_SLOT_A_ADDRESS         0x08010000      /* sectors 4:5 */
+#define BOOT_SLOT_A_SIZE            0x30000
+#define BOOT_SLOT_B_ADDRESS         0x08040000      /* sectors 6:7 */
+#define BOOT_SLOT_B_SIZE            0x40000
+#else
+#error "two application slots need sectors 4 and 5 (xC parts and bigger)"
+#endif
+
+#define BOOT_SLOTS_COUNT            2
+#define BOOT_SLOT_A                 0
+#define BOOT_SLOT_B                 1
+#define BOOT_NO_SLOT                0xFF
+
+/* key/value store keys of the slot descriptors (size, CRC, sequence), BOOT_SLOT_A then BOOT_SLOT_B */
+#define BOOT_FIRST_KV_KEY           (KV_MAX_KEYS - BOOT_SLOTS_COUNT)
+
+/* SRAM the initial stack pointer of an image must be in (64KB xB/xC, 96KB xD/xE) */
+#define BOOT_SRAM_START             0x20000000
+#define BOOT_SRAM_END               ((FLASH_VARIANT >= flashVariant_xD) ? 0x20018000 : 0x20010000)
+
+typedef enum
+{
+    bootManager_retNotOk = 0,
+    bootManager_retOk,
+    bootManager_retNullPointer,
+    bootManager_retNotInitialized,
+    bootManager_retInvalidSlot,
+    bootManager_retInvalidLength,       /* image bigger than its slot */
+    bootManager_retNoImage,             /* slot has no descriptor */
+    bootManager_retInvalidImage,        /* vector table out of the slot/SRAM */
+    bootManager_retCrcError,            /* slot doesn't match the CRC of its descriptor */
+    bootManager_retNoValidImage,        /* no slot can be booted, stay in the bootloader */
+    bootManager_retBusy,                /* CRC unit or key/value store busy, call again */
+    bootManager_retStoreError,
+}BootManager_ErrorStatus_t;
+
+/*
+    Boot and update:
+        - a slot is bootable when it has a descriptor, its vector table points into the slot (reset handler)
+          and SRAM (stack) and the CRC unit gives the CRC of the descriptor over its size bytes
+        - the slot with the highest sequence is tried first, the other one if it fails
+        - bootManager_beginUpdate removes the descriptor of the slot not booted before its erase, so a
+          partial image is never booted, bootManager_commitUpdate checks the new image and writes its
+          descriptor with the next sequence (the old image stays as the fallback)
+        - the image CRC is the one of the binary link end frame (softCrc_updateBytes, the last partial
+          word padded by zeros), the booted slot is the base image of delta patches
+    Boot time is the CRC of the image: the unit takes 4 AHB cycles a word, 192KB is ~2.5ms at 84MHz (set the
+    clock, flash_setLatencyForClock and flash_enableArt first) and ~13ms at the 16MHz HSI of reset.
+*/
+
+/**********************************************************
+    Description:       This function is used to read the slot descriptors, the key/value store must be
+                       mounted (kv_init) and the CRC clock enabled by the user
+***********************************************************/
+BootManager_ErrorStatus_t bootManager_init(void);
+
+
+
+
+/**********************************************************
+    Description:       This function is used to check slot (BOOT_SLOT_A, BOOT_SLOT_B) as it would be
+                       booted, the flash is read by the CPU into the CRC unit
+***********************************************************/
+BootManager_ErrorStatus_t bootManager_checkSlot(u8 slot);
+
+
+
+
+/**********************************************************
+    Description:       This function is used to boot the newest valid slot: VTOR is moved to the slot,
+                       SysTick is stopped, all IRQs are disabled and their pending flags cleared (pending
+                       SysTick and PendSV too), MSP is loaded and its reset handler is called
+
+    Return:            Doesn't return if an image is booted
+                       - bootManager_retNoValidImage (if no slot passes bootManager_checkSlot)
+                       - bootManager_retInvalidImage (if VTOR can't be moved to the slot, nothing is stopped)
+***********************************************************/
+BootManager_ErrorStatus_t bootManager_boot(void);
+
+
+
+
+/**********************************************************
+    Description:       This function is used to get the slot booted (newest valid one), BOOT_NO_SLOT
+                       if there is none, with its address and image size (base image of delta patches)
+***********************************************************/
+BootManager_ErrorStatus_t bootManager_getActiveSlot(pu8 slot, pu32 address, pu32 imageSize);
+
+
+
+
+/**********************************************************
+    Description:       This function is used to get the slot a new image goes to (the one not active)
+                       and its size, its descriptor is removed so it isn't booted until the commit
+***********************************************************/
+BootManager_ErrorStatus_t bootManager_beginUpdate(pu32 address, pu32 slotSize);
+
+
+
+
+/**********************************************************
+    Description:       This function is used to make the new image of the update slot the one booted,
+                       after checking imageSize bytes of the slot against imageCrc
+
+    Return:            Returns BootManager_ErrorStatus_t
+                       - bootManager_retCrcError (if the slot doesn't have the image)
+                       - bootManager_retBusy (if the store waits for kv_runnable, call again)
+                       - bootManager_retOk (if the new image is the active one)
+***********************************************************/
+BootManager_ErrorStatus_t bootManager_commitUpdate(u32 imageSize, u32 imageCrc);
+
+#endif  /* BOOT_MANAGER_H */
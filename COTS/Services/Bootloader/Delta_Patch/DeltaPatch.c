@@ -0,0 +1,209 @@
+/**
+ * @file DeltaPatch.c
+ * @author Ibrahim Saad
+ * @brief This is the source file of the delta patch stage of the bootloader
+ * @version 0.1
+ * @date 2023-06-18
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "DeltaPatch.h"
+#include "../../../LIB/Address.h"
+
+#define MSK_VARINT_VALUE            0x7F
+#define MSK_VARINT_MORE             0x80
+#define VARINT_MAX_SHIFT            28      /* 5 bytes give 32 bits */
+
+#define STATE_OPERATION             0
+#define STATE_ARGUMENT              1
+#define STATE_ADD_BYTES             2
+#define STATE_INSERT_BYTES          3
+
+static const u8* oldImage = NULL;
+static u32 oldImageSize = 0;
+static u32 oldPosition = 0;
+static u32 newImageSize = 0;
+static u32 produced = 0;
+static u8 state = STATE_OPERATION;
+static u8 operation = DELTA_OP_COPY;
+static u32 argument = 0;
+static u8 argumentShift = 0;
+static u32 remaining = 0;                   /* bytes of the ADD/INSERT operation not received */
+static u8 buffer [DELTA_BUFFER_SIZE];
+static deltaPatchSink_t outputSink = NULL;
+static DeltaPatch_ErrorStatus_t patchStatus = deltaPatch_retNotStarted;
+
+static DeltaPatch_ErrorStatus_t runOperation(void);
+static DeltaPatch_ErrorStatus_t output(const u8* data, u32 length);
+
+DeltaPatch_ErrorStatus_t deltaPatch_begin(u32 oldAddress, u32 oldSize, u32 newSize, deltaPatchSink_t sink)
+{
+    DeltaPatch_ErrorStatus_t errorStatus = deltaPatch_retNotOk;
+    if(!sink)
+    {
+        errorStatus = deltaPatch_retNullPointer;
+    }
+    else
+    {
+        oldImage = (const u8*) TO_POINTER(oldAddress);
+        oldImageSize = oldSize;
+        oldPosition = 0;
+        newImageSize = newSize;
+        produced = 0;
+        state = STATE_OPERATION;
+        outputSink = sink;
+        patchStatus = newSize ? deltaPatch_retBusy : deltaPatch_retDone;
+        errorStatus = deltaPatch_retOk;
+    }
+    return errorStatus;
+}
+
+DeltaPatch_ErrorStatus_t deltaPatch_feed(const u8* bytes, u32 count)
+{
+    DeltaPatch_ErrorStatus_t errorStatus = deltaPatch_retNotOk;
+    if(!bytes)
+    {
+        errorStatus = deltaPatch_retNullPointer;
+    }
+    else
+    {
+        u32 i = 0;
+        if(patchStatus == deltaPatch_retDone && count)
+        {
+            /* data after the end of the new image */
+            patchStatus = deltaPatch_retCorrupted;
+        }
+        while(i < count && patchStatus == deltaPatch_retBusy)
+        {
+            if(state == STATE_OPERATION)
+            {
+                operation = bytes[i];
+                argument = 0;
+                argumentShift = 0;
+                state = STATE_ARGUMENT;
+                i++;
+                if(operation > DELTA_OP_SEEK)
+                {
+                    patchStatus = deltaPatch_retCorrupted;
+                }
+            }
+            else if(state == STATE_ARGUMENT)
+            {
+                argument |= (u32) (bytes[i] & MSK_VARINT_VALUE) << argumentShift;
+                if(bytes[i] & MSK_VARINT_MORE)
+                {
+                    argumentShift += 7;
+                    if(argumentShift > VARINT_MAX_SHIFT)
+                    {
+                        patchStatus = deltaPatch_retCorrupted;
+                    }
+                }
+                else
+                {
+                    patchStatus = runOperation();
+                }
+                i++;
+            }
+            else
+            {
+                u32 length = count - i;
+                if(length > remaining)
+                {
+                    length = remaining;
+                }
+                if(state == STATE_INSERT_BYTES)
+                {
+                    patchStatus = output(&bytes[i], length);
+                }
+                else
+                {
+                    /* ADD bytes are summed in buffer, DELTA_BUFFER_SIZE at a time */
+                    u32 j;
+                    if(length > DELTA_BUFFER_SIZE)
+                    {
+                        length = DELTA_BUFFER_SIZE;
+                    }
+                    for(j = 0; j < length; j++)
+                    {
+                        buffer[j] = (u8) (oldImage[oldPosition + j] + bytes[i + j]);
+                    }
+                    oldPosition += length;
+                    patchStatus = output(buffer, length);
+                }
+                i += length;
+                remaining -= length;
+                if(!remaining)
+                {
+                    state = STATE_OPERATION;
+                }
+            }
+            if(patchStatus == deltaPatch_retBusy && state == STATE_OPERATION && produced == newImageSize)
+            {
+                patchStatus = (i < count) ? deltaPatch_retCorrupted : deltaPatch_retDone;
+            }
+        }
+        errorStatus = patchStatus;
+    }
+    return errorStatus;
+}
+
+DeltaPatch_ErrorStatus_t deltaPatch_getStatus(void)
+{
+    return patchStatus;
+}
+
+/* the argument of operation is complete, bounds are checked once for the whole operation */
+static DeltaPatch_ErrorStatus_t runOperation(void)
+{
+    DeltaPatch_ErrorStatus_t errorStatus = deltaPatch_retBusy;
+    state = STATE_OPERATION;
+    if(operation == DELTA_OP_SEEK)
+    {
+        /* zigzag, the new position is checked as unsigned so moving before 0 wraps out of the image */
+        u32 position = (argument & 1) ? oldPosition - (argument >> 1) - 1 : oldPosition + (argument >> 1);
+        if(position > oldImageSize)
+        {
+            errorStatus = deltaPatch_retCorrupted;
+        }
+        else
+        {
+            oldPosition = position;
+        }
+    }
+    else if(argument > newImageSize - produced
+            || (operation != DELTA_OP_INSERT && argument > oldImageSize - oldPosition))
+    {
+        errorStatus = deltaPatch_retCorrupted;
+    }
+    else if(operation == DELTA_OP_COPY)
+    {
+        errorStatus = output(&oldImage[oldPosition], argument);
+        oldPosition += argument;
+    }
+    else if(argument)
+    {
+        remaining = argument;
+        state = (operation == DELTA_OP_ADD) ? STATE_ADD_BYTES : STATE_INSERT_BYTES;
+    }
+    else
+    {
+        /* empty ADD/INSERT */
+    }
+    return errorStatus;
+}
+
+static DeltaPatch_ErrorStatus_t output(const u8* data, u32 length)
+{
+    DeltaPatch_ErrorStatus_t errorStatus = deltaPatch_retBusy;
+    if(length)
+    {
+        if(!outputSink(data, length))
+        {
+            errorStatus = deltaPatch_retSinkError;
+        }
+        produced += length;
+    }
+    return errorStatus;
+}
@@ -0,0 +1,82 @@
+/**
+ * @file DeltaPatch.h
+ * @author Ibrahim Saad
+ * @brief This is the interface of the delta patch stage of the bootloader, it rebuilds the new
+ *        image from the installed one (read from flash) and a patch coming in pieces of any size,
+ *        the new image bytes are given in order to a sink (the flash writer of the staging area)
+ * @version 0.1
+ * @date 2023-06-18
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef DELTA_PATCH_H
+#define DELTA_PATCH_H
+
+#include "../../../LIB/Std_types.h"
+
+/*
+    Patch format (Tools/Delta_Diff makes it), a list of operations, each is an operation byte then
+    its argument as a varint (7 bits a byte, least significant first, bit 7 set if more bytes follow):
+        - COPY n: n bytes of the old image from the old position, the old position moves by n
+        - ADD n, n bytes: each byte is the old byte at the old position plus the patch byte (mod 256),
+          the old position moves by n (code moved by a few bytes differs only in addresses/offsets)
+        - INSERT n, n bytes: the patch bytes as they are, the old position doesn't move
+        - SEEK d: the old position moves by d, signed (zigzag: d >= 0 is 2d, d < 0 is -2d - 1)
+    The old position starts at 0 and the patch ends when the new image size is reached.
+*/
+#define DELTA_OP_COPY               0x00
+#define DELTA_OP_ADD                0x01
+#define DELTA_OP_INSERT             0x02
+#define DELTA_OP_SEEK               0x03
+
+#define DELTA_BUFFER_SIZE           64      /* bytes of ADD results given to the sink at a time */
+
+/* header of the patch files of the host tools, it isn't part of the patch */
+#define DELTA_FILE_MAGIC            0x31544C44      /* "DLT1" little endian */
+#define DELTA_FILE_HEADER_SIZE      20              /* magic, new size, new CRC, old size, old CRC (u32s) */
+
+typedef enum
+{
+    deltaPatch_retNotOk = 0,
+    deltaPatch_retOk,
+    deltaPatch_retNullPointer,
+    deltaPatch_retNotStarted,
+    deltaPatch_retCorrupted,            /* unknown operation, out of the old image or past the new size */
+    deltaPatch_retSinkError,
+    deltaPatch_retBusy,                 /* more patch bytes are needed */
+    deltaPatch_retDone,                 /* new image size reached */
+}DeltaPatch_ErrorStatus_t;
+
+/* takes length bytes of the new image, returns 0 to stop the patch (deltaPatch_retSinkError) */
+typedef u8 (*deltaPatchSink_t)(const u8* data, u32 length);
+
+/**********************************************************
+    Description:       This function is used to start a patch of the old image at oldAddress (oldSize
+                       bytes, memory mapped) giving newSize bytes to sink, the sink must not write
+                       over the old image
+***********************************************************/
+DeltaPatch_ErrorStatus_t deltaPatch_begin(u32 oldAddress, u32 oldSize, u32 newSize, deltaPatchSink_t sink);
+
+
+
+
+/**********************************************************
+    Description:       This function is used to apply count bytes of the patch, COPY and INSERT
+                       bytes go to the sink from where they are (flash, bytes) without copying
+
+    Return:            Returns DeltaPatch_ErrorStatus_t
+                       - deltaPatch_retBusy (if the new image isn't complete)
+                       - deltaPatch_retDone (if the new image size is reached by the last byte)
+                       - deltaPatch_retCorrupted, deltaPatch_retSinkError (patch stopped)
+***********************************************************/
+DeltaPatch_ErrorStatus_t deltaPatch_feed(const u8* bytes, u32 count);
+
+
+
+
+/* status of the patch, as returned by deltaPatch_feed */
+DeltaPatch_ErrorStatus_t deltaPatch_getStatus(void);
+
+#endif  /* DELTA_PATCH_H */
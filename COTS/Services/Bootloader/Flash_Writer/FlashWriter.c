@@ -0,0 +1,237 @@
+/**
+ * @file FlashWriter.c
+ * @author Ibrahim Saad
+ * @brief This is the source file of the flash writer stage of the bootloader
+ * @version 0.1
+ * @date 2023-06-18
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "FlashWriter.h"
+#include "../../../MCAL/FlashDriver/FLASH.h"
+#include "../../../LIB/Address.h"
+
+#define BLOCK_WORDS             (FLASH_WRITER_BLOCK_SIZE / 4)
+#define MSK_BLOCK_ADDRESS       (~(u32) (FLASH_WRITER_BLOCK_SIZE - 1))
+#define ERASED_WORD             0xFFFFFFFF
+
+typedef struct
+{
+    u32 words [BLOCK_WORDS];
+    u32 address;
+    u16 firstWord;              /* written words are [firstWord, lastWord) */
+    u16 lastWord;               /* 0 if the block is empty */
+    volatile u8 pending;        /* given to the flash engine */
+}writerBlock_t;
+
+static writerBlock_t blocks [2];
+static u8 fillIndex = 0;
+static u8 programIndex = 0;
+static u8 started = 0;
+static volatile u8 flashError = 0;
+static u32 windowStart = 0;
+static u32 windowEnd = 0;
+
+static void openBlock(writerBlock_t* block, u32 address);
+static FlashWriter_ErrorStatus_t sendBlock(void);
+static void blockDoneCallback(FLASH_ErrorStatus_t result);
+
+FlashWriter_ErrorStatus_t flashWriter_begin(u32 startAddress, u32 endAddress)
+{
+    FlashWriter_ErrorStatus_t errorStatus = flashWriter_retNotOk;
+    if(blocks[0].pending || blocks[1].pending)
+    {
+        errorStatus = flashWriter_retBusy;
+    }
+    else if(endAddress <= startAddress)
+    {
+        errorStatus = flashWriter_retInvalidAddress;
+    }
+    else
+    {
+        FLASH_ErrorStatus_t flashStatus = flash_unlock();
+        if(flashStatus == flash_retOk)
+        {
+            flashStatus = flash_eraseRange(startAddress, endAddress - startAddress);
+        }
+        if(flashStatus == flash_retInvalidAddress || flashStatus == flash_retInvalidLength)
+        {
+            errorStatus = flashWriter_retInvalidAddress;
+        }
+        else if(flashStatus != flash_retOk)
+        {
+            errorStatus = flashWriter_retFlashError;
+        }
+        else
+        {
+            windowStart = startAddress;
+            windowEnd = endAddress;
+            blocks[0].lastWord = 0;
+            blocks[1].lastWord = 0;
+            fillIndex = 0;
+            flashError = 0;
+            started = 1;
+            errorStatus = flashWriter_retOk;
+        }
+    }
+    return errorStatus;
+}
+
+FlashWriter_ErrorStatus_t flashWriter_write(u32 address, const u8* data, u32 length)
+{
+    FlashWriter_ErrorStatus_t errorStatus = flashWriter_retNotOk;
+    if(!started)
+    {
+        errorStatus = flashWriter_retNotStarted;
+    }
+    else if(!data)
+    {
+        errorStatus = flashWriter_retNullPointer;
+    }
+    else if(address < windowStart || address > windowEnd || length > windowEnd - address)
+    {
+        errorStatus = flashWriter_retInvalidAddress;
+    }
+    else if(flashError)
+    {
+        errorStatus = flashWriter_retFlashError;
+    }
+    else
+    {
+        errorStatus = flashWriter_retOk;
+        while(length && errorStatus == flashWriter_retOk)
+        {
+            writerBlock_t* block = &blocks[fillIndex];
+            u32 offset, count, i;
+            if(block->lastWord && block->address != (address & MSK_BLOCK_ADDRESS))
+            {
+                errorStatus = sendBlock();
+                block = &blocks[fillIndex];
+            }
+            if(errorStatus == flashWriter_retOk)
+            {
+                if(!block->lastWord)
+                {
+                    openBlock(block, address & MSK_BLOCK_ADDRESS);
+                }
+                offset = address - block->address;
+                count = FLASH_WRITER_BLOCK_SIZE - offset;
+                if(count > length)
+                {
+                    count = length;
+                }
+                /* words are programmed from memory as they are, so bytes keep the little endian order */
+                for(i = 0; i < count; i++)
+                {
+                    ((u8*) block->words)[offset + i] = data[i];
+                }
+                if(offset / 4 < block->firstWord)
+                {
+                    block->firstWord = offset / 4;
+                }
+                if((offset + count + 3) / 4 > block->lastWord)
+                {
+                    block->lastWord = (offset + count + 3) / 4;
+                }
+                address += count;
+                data += count;
+                length -= count;
+            }
+        }
+    }
+    return errorStatus;
+}
+
+FlashWriter_ErrorStatus_t flashWriter_flush(void)
+{
+    FlashWriter_ErrorStatus_t errorStatus = flashWriter_retOk;
+    if(!started)
+    {
+        errorStatus = flashWriter_retNotStarted;
+    }
+    else if(flashError)
+    {
+        errorStatus = flashWriter_retFlashError;
+    }
+    else if(blocks[fillIndex].lastWord)
+    {
+        errorStatus = sendBlock();
+    }
+    return errorStatus;
+}
+
+FlashWriter_ErrorStatus_t flashWriter_getStatus(void)
+{
+    FlashWriter_ErrorStatus_t errorStatus = flashWriter_retOk;
+    if(flashError)
+    {
+        errorStatus = flashWriter_retFlashError;
+    }
+    else if((blocks[0].pending || blocks[1].pending) && flash_getAsyncStatus() == flash_retBusy)
+    {
+        errorStatus = flashWriter_retBusy;
+    }
+    return errorStatus;
+}
+
+u8 flashWriter_isReady(void)
+{
+    return !blocks[fillIndex ^ 1].pending;
+}
+
+static void openBlock(writerBlock_t* block, u32 address)
+{
+    u32 i;
+    for(i = 0; i < BLOCK_WORDS; i++)
+    {
+        block->words[i] = ERASED_WORD;
+    }
+    block->address = address;
+    block->firstWord = BLOCK_WORDS;
+    block->lastWord = 0;
+}
+
+/* the filled block goes to the flash engine and the other one (once programmed) becomes the fill block */
+static FlashWriter_ErrorStatus_t sendBlock(void)
+{
+    FlashWriter_ErrorStatus_t errorStatus = flashWriter_retOk;
+    writerBlock_t* block = &blocks[fillIndex];
+    u8 spare = fillIndex ^ 1;
+    while(blocks[spare].pending && flash_getAsyncStatus() == flash_retBusy)
+    {
+    }
+    if(blocks[spare].pending || flashError)
+    {
+        errorStatus = flashWriter_retFlashError;
+    }
+    else
+    {
+        block->pending = 1;
+        programIndex = fillIndex;
+        if(flash_programAsync((pu32) TO_POINTER(block->address + 4 * block->firstWord), &block->words[block->firstWord],
+                              block->lastWord - block->firstWord, blockDoneCallback) != flash_retOk)
+        {
+            block->pending = 0;
+            flashError = 1;
+            errorStatus = flashWriter_retFlashError;
+        }
+        else
+        {
+            fillIndex = spare;
+            blocks[spare].lastWord = 0;
+        }
+    }
+    return errorStatus;
+}
+
+/* at most one block is in the flash engine at a time */
+static void blockDoneCallback(FLASH_ErrorStatus_t result)
+{
+    if(result != flash_retOk)
+    {
+        flashError = 1;
+    }
+    blocks[programIndex].pending = 0;
+}
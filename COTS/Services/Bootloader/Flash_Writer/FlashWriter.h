@@ -0,0 +1,85 @@
+/**
+ * @file FlashWriter.h
+ * @author Ibrahim Saad
+ * @brief This is the interface of the flash writer stage of the bootloader which coalesces
+ *        data of any size and alignment into aligned blocks programmed in the background
+ * @version 0.1
+ * @date 2023-06-18
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef FLASH_WRITER_H
+#define FLASH_WRITER_H
+
+#include "../../../LIB/Std_types.h"
+
+#define FLASH_WRITER_BLOCK_SIZE     256     /* bytes, power of 2, one async program job each */
+
+typedef enum
+{
+    flashWriter_retNotOk = 0,
+    flashWriter_retOk,
+    flashWriter_retNullPointer,
+    flashWriter_retNotStarted,
+    flashWriter_retInvalidAddress,
+    flashWriter_retBusy,
+    flashWriter_retFlashError,
+}FlashWriter_ErrorStatus_t;
+
+/*
+    Two block buffers are used: one is filled by flashWriter_write while the other one is programmed
+    by the async flash engine (flash_programAsync, FLASH IRQ must be enabled in NVIC):
+        - bytes of a block not written are 0xFF, programming 0xFF keeps the flash as it is, only the words
+          from the first to the last written one are programmed
+        - a block is sent when data goes to another block, flashWriter_write waits for the block in
+          programming only if the flash is behind the data source (flashWriter_isReady tells it)
+        - the first flash error stops the writer, next calls return flashWriter_retFlashError
+*/
+
+/**********************************************************
+    Description:       This function is used to start a new image, it unlocks the flash and erases
+                       the sectors of [startAddress, endAddress) (blocking), writes outside it are refused
+
+    Return:            Returns FlashWriter_ErrorStatus_t
+                       - flashWriter_retInvalidAddress (if the range isn't in flash)
+                       - flashWriter_retFlashError (if erase failed)
+                       - flashWriter_retOk (if ready to write)
+***********************************************************/
+FlashWriter_ErrorStatus_t flashWriter_begin(u32 startAddress, u32 endAddress);
+
+
+
+
+/**********************************************************
+    Description:       This function is used to add length bytes of data to be programmed at address,
+                       data is copied so its buffer is free on return
+***********************************************************/
+FlashWriter_ErrorStatus_t flashWriter_write(u32 address, const u8* data, u32 length);
+
+
+
+
+/**********************************************************
+    Description:       This function is used to send the block being filled to the flash, the writer
+                       is done when flashWriter_getStatus doesn't return flashWriter_retBusy
+***********************************************************/
+FlashWriter_ErrorStatus_t flashWriter_flush(void);
+
+
+
+
+/**********************************************************
+    Description:       This function returns flashWriter_retBusy while blocks are programmed,
+                       flashWriter_retFlashError after a failed block or flashWriter_retOk
+***********************************************************/
+FlashWriter_ErrorStatus_t flashWriter_getStatus(void);
+
+
+
+
+/* returns 1 if a block can be sent now, so flashWriter_write won't wait */
+u8 flashWriter_isReady(void);
+
+#endif  /* FLASH_WRITER_H */
@@ -11,20 +11,39 @@
 
 #include "HexParser.h"
 
+#define INVALID_DIGIT       0xFF
+#define MSK_INVALID_DIGIT   0xF0
+#define RECORD_HEADER_SIZE  4           /* length, address high and low, type */
+
+/* value of each ASCII hex digit, INVALID_DIGIT for other characters */
+static const u8 hexDigits [256] =
+{
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+};
+
+static u8 decodeByte(const u8* characters, pu8 invalid);
+
 u8 hexParser_asciiToDigit(u8 ascii)
 {
-    u8 digit = 0;
-    if(ascii >= '0' && ascii <= '9')
-    {
-        digit = ascii - '0';
-    }
-    else if(ascii >= 'A' && ascii <= 'F')
+    u8 digit = hexDigits[ascii];
+    if(digit == INVALID_DIGIT)
     {
-        digit = ascii - 'A' + 10;
-    }
-    else if(ascii >= 'a' && ascii <= 'f')
-    {
-        digit = ascii - 'a' + 10;
+        digit = 0;
     }
     return digit;
 }
@@ -49,37 +68,40 @@ u8 hexParser_calculateChecksum(const HexRecord_t* record)
     return checksum;
 }
 
+/* each byte is decoded once, characters are validated and the checksum summed in the same pass,
+   decoding stops at the first invalid character (the '\0' of a short buffer) so nothing after it is read */
 u8 hexParser_parseHexRecord(u8 *buffer, HexRecord_t *record)
 {
     u8 retVal = 0;
-    if (buffer[0] != ':') 
+    if(buffer[0] == ':')
     {
-    	retVal = 0;
-    }
-    else
-    {
-        record->length = hexParser_hexByteToDecimal(&buffer[1]);
-        record->address = (hexParser_hexByteToDecimal(&buffer[3]) << 8) | hexParser_hexByteToDecimal(&buffer[5]);
-        record->type = hexParser_hexByteToDecimal(&buffer[7]);
-        int i;
-        for (i = 0; i < record->length; i++) 
+        u8 invalid = 0, sum = 0, i;
+        u8 header [RECORD_HEADER_SIZE];
+        const u8* characters = &buffer[1];
+        for(i = 0; i < RECORD_HEADER_SIZE && !invalid; i++)
         {
-            record->data[i] = hexParser_hexByteToDecimal(&buffer[9 + i * 2]);
+            header[i] = decodeByte(characters, &invalid);
+            sum += header[i];
+            characters += 2;
         }
-        record->checksum = hexParser_hexByteToDecimal(&buffer[9 + i * 2]);
-        u8 sum = record->length + (record->address >> 8) + (record->address & 0xFF) + record->type;
-        for (i = 0; i < record->length; i++) 
+        if(!invalid)
         {
-            sum += record->data[i];
+            record->length = header[0];
+            record->address = (header[1] << 8) | header[2];
+            record->type = header[3];
         }
-        sum = ~sum + 1;
-        if (sum != record->checksum) 
+        for(i = 0; !invalid && i < record->length; i++)
         {
-        	retVal = 0;
+            record->data[i] = decodeByte(characters, &invalid);
+            sum += record->data[i];
+            characters += 2;
         }
-        else
+        if(!invalid)
         {
-            retVal = 1;
+            record->checksum = decodeByte(characters, &invalid);
+            sum += record->checksum;
+            /* the checksum makes the sum of all bytes 0 */
+            retVal = (!invalid && sum == 0);
         }
     }
     return retVal;
@@ -93,6 +115,11 @@ u32 hexParser_parse16UpperBitsAddRecord(const pu8 record)
         /* extended linear address record */
         address = (hexParser_hexByteToDecimal(&record[9]) << 24) | (hexParser_hexByteToDecimal(&record[11]) << 16);
     }
+    else if(record[8] == '2')
+    {
+        /* extended segment address record, the segment is in paragraphs of 16 bytes */
+        address = ((hexParser_hexByteToDecimal(&record[9]) << 8) | hexParser_hexByteToDecimal(&record[11])) << 4;
+    }
     return address;
 }
 
@@ -101,16 +128,23 @@ u32 hexParser_getStartExecutionAdrress(const pu8 record)
     u32 ret = 0xFFFFFFFF;
     if(record[8] == '5')
     {
-        /* extended linear address record */
+        /* start linear address record */
         ret = (hexParser_hexByteToDecimal(&record[9]) << 24) | (hexParser_hexByteToDecimal(&record[11]) << 16)
                 | (hexParser_hexByteToDecimal(&record[13]) << 8) | hexParser_hexByteToDecimal(&record[15]);
     }
+    else if(record[8] == '3')
+    {
+        /* start segment address record, CS:IP */
+        ret = (((hexParser_hexByteToDecimal(&record[9]) << 8) | hexParser_hexByteToDecimal(&record[11])) << 4)
+                + ((hexParser_hexByteToDecimal(&record[13]) << 8) | hexParser_hexByteToDecimal(&record[15]));
+    }
     return ret;
 }
 
 void hexParser_bytesTo32Bits(const pu8 bytes, pu32 words, u8 size, pu8 sizeWords)
 {
-    u8 i, j;
+    u16 i;
+    u8 j;
     for (i = 0, j = 0; i < size; i += 4, j++) {
         u32 val = 0;
         if (i < size) val |= ((u32)bytes[i]);
@@ -122,6 +156,14 @@ void hexParser_bytesTo32Bits(const pu8 bytes, pu32 words, u8 size, pu8 sizeWords
     *sizeWords = j;
 }
 
+static u8 decodeByte(const u8* characters, pu8 invalid)
+{
+    u8 high = hexDigits[characters[0]];
+    u8 low = (high == INVALID_DIGIT) ? INVALID_DIGIT : hexDigits[characters[1]];
+    *invalid |= (high | low) & MSK_INVALID_DIGIT;
+    return (u8) ((high << 4) | (low & 0x0F));
+}
+
 /*
 int main(void)
 {
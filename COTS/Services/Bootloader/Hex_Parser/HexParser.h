@@ -12,10 +12,10 @@
 #ifndef HEX_PARSER_H
 #define HEX_PARSER_H
 
-#include "../../COTS/LIB/Std_types.h"
+#include "../../../LIB/Std_types.h"
 
-#define MAX_DATA_SIZE                       16
-#define MAX_BUFFER_SIZE                     45
+#define MAX_DATA_SIZE                       255     /* longest record data, the length field is one byte */
+#define MAX_BUFFER_SIZE                     (11 + 2 * MAX_DATA_SIZE + 2)    /* ':', fields, data, checksum, CR LF */
 #define DATA_RECORD                         0x00
 #define END_OF_FILE_RECORD                  0x01
 #define EXTENDED_SEGMENT_ADDRESS_RECORD     0x02
@@ -36,7 +36,9 @@ u8 hexParser_asciiToDigit(u8 ascii);
 u8 hexParser_hexByteToDecimal(const pu8 byte);
 u8 hexParser_calculateChecksum(const HexRecord_t* record);
 u8 hexParser_parseHexRecord(u8 *buffer, HexRecord_t *record);
+/* base address of the next data records from an extended linear (04) or extended segment (02) record */
 u32 hexParser_parse16UpperBitsAddRecord(const pu8 record);
+/* start address from a start linear (05) or start segment (03, CS * 16 + IP) record, 0xFFFFFFFF otherwise */
 u32 hexParser_getStartExecutionAdrress(const pu8 record);
 void hexParser_bytesTo32Bits(const pu8 bytes, pu32 words, u8 size, pu8 sizeWords);
 
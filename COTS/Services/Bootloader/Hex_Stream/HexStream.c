@@ -0,0 +1,253 @@
+/**
+ * @file HexStream.c
+ * @author Ibrahim Saad
+ * @brief This is the source file of the Intel HEX stage of the bootloader
+ * @version 0.1
+ * @date 2023-06-18
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "HexStream.h"
+#include "../Flash_Writer/FlashWriter.h"
+
+#define RECORD_OVERHEAD_CHARS       11          /* ':' + length, address, type and checksum */
+#define NO_ENTRY_POINT              0xFFFFFFFF
+#define RECORD_OFFSET_RANGE         0x10000     /* 16-bit address field of the records */
+
+#define STATE_IDLE                  0
+#define STATE_RUNNING               1
+#define STATE_END_OF_FILE           2
+
+#define ADDRESSING_LINEAR           0           /* base from an extended linear (04) record, or none */
+#define ADDRESSING_SEGMENT          1           /* base from an extended segment (02) record */
+
+static u8 state = STATE_IDLE;
+static u32 upperAddress = 0;
+static u8 addressingMode = ADDRESSING_LINEAR;
+static u32 entryPoint = NO_ENTRY_POINT;
+static u8 line [HEX_STREAM_LINE_SIZE + 1];
+static u16 lineLength = 0;
+static u8 lineOverflow = 0;
+
+static HexStream_ErrorStatus_t writerToStreamStatus(FlashWriter_ErrorStatus_t writerStatus);
+static u8 isEndOfLine(u8 character);
+static HexStream_ErrorStatus_t writeData(const HexRecord_t* hexRecord);
+
+HexStream_ErrorStatus_t hexStream_begin(u32 startAddress, u32 endAddress)
+{
+    HexStream_ErrorStatus_t errorStatus = writerToStreamStatus(flashWriter_begin(startAddress, endAddress));
+    if(errorStatus == hexStream_retOk)
+    {
+        state = STATE_RUNNING;
+        upperAddress = 0;
+        addressingMode = ADDRESSING_LINEAR;
+        entryPoint = NO_ENTRY_POINT;
+        lineLength = 0;
+        lineOverflow = 0;
+    }
+    return errorStatus;
+}
+
+HexStream_ErrorStatus_t hexStream_feed(const u8* characters, u32 count)
+{
+    HexStream_ErrorStatus_t errorStatus = hexStream_retOk;
+    if(!characters)
+    {
+        errorStatus = hexStream_retNullPointer;
+    }
+    else if(state == STATE_IDLE)
+    {
+        errorStatus = hexStream_retNotStarted;
+    }
+    else
+    {
+        u32 i;
+        for(i = 0; i < count && (errorStatus == hexStream_retOk || errorStatus == hexStream_retBusy); i++)
+        {
+            if(characters[i] == ':')
+            {
+                lineLength = 0;
+                lineOverflow = 0;
+            }
+            if(isEndOfLine(characters[i]))
+            {
+                if(lineLength)
+                {
+                    line[lineLength] = '\0';
+                    errorStatus = lineOverflow ? hexStream_retInvalidRecord : hexStream_pushRecord(line);
+                }
+                lineLength = 0;
+                lineOverflow = 0;
+            }
+            else if(lineLength < HEX_STREAM_LINE_SIZE)
+            {
+                line[lineLength] = characters[i];
+                lineLength++;
+            }
+            else
+            {
+                lineOverflow = 1;
+            }
+        }
+    }
+    return errorStatus;
+}
+
+HexStream_ErrorStatus_t hexStream_pushRecord(u8* record)
+{
+    HexStream_ErrorStatus_t errorStatus = hexStream_retNotOk;
+    HexRecord_t hexRecord;
+    u32 length = 0;
+    if(!record)
+    {
+        errorStatus = hexStream_retNullPointer;
+    }
+    else if(state == STATE_IDLE)
+    {
+        errorStatus = hexStream_retNotStarted;
+    }
+    else if(state == STATE_END_OF_FILE)
+    {
+        errorStatus = hexStream_retBusy;
+    }
+    else
+    {
+        while(length <= HEX_STREAM_LINE_SIZE && !isEndOfLine(record[length]))
+        {
+            length++;
+        }
+        /* the length field must match the characters before parsing, so data can't overflow the record */
+        if(length < RECORD_OVERHEAD_CHARS || record[0] != ':'
+           || length != RECORD_OVERHEAD_CHARS + 2 * (u32) hexParser_hexByteToDecimal(&record[1])
+           || !hexParser_parseHexRecord(record, &hexRecord))
+        {
+            errorStatus = hexStream_retInvalidRecord;
+        }
+        else if(hexRecord.type == DATA_RECORD)
+        {
+            errorStatus = writeData(&hexRecord);
+        }
+        else if((hexRecord.type == EXTENDED_LINEAR_ADDRESS_RECORD || hexRecord.type == EXTENDED_SEGMENT_ADDRESS_RECORD)
+                && hexRecord.length == 2)
+        {
+            upperAddress = hexParser_parse16UpperBitsAddRecord(record);
+            addressingMode = (hexRecord.type == EXTENDED_SEGMENT_ADDRESS_RECORD) ? ADDRESSING_SEGMENT : ADDRESSING_LINEAR;
+            errorStatus = hexStream_retOk;
+        }
+        else if((hexRecord.type == START_LINEAR_ADDRESS_RECORD || hexRecord.type == START_SEGMENT_ADDRESS_RECORD)
+                && hexRecord.length == 4)
+        {
+            entryPoint = hexParser_getStartExecutionAdrress(record);
+            errorStatus = hexStream_retOk;
+        }
+        else if(hexRecord.type == END_OF_FILE_RECORD)
+        {
+            errorStatus = writerToStreamStatus(flashWriter_flush());
+            state = STATE_END_OF_FILE;
+            if(errorStatus == hexStream_retOk)
+            {
+                errorStatus = hexStream_retBusy;
+            }
+        }
+        else
+        {
+            errorStatus = hexStream_retUnsupportedRecord;
+        }
+    }
+    return errorStatus;
+}
+
+HexStream_ErrorStatus_t hexStream_getStatus(void)
+{
+    HexStream_ErrorStatus_t errorStatus = hexStream_retNotOk;
+    if(state == STATE_IDLE)
+    {
+        errorStatus = hexStream_retNotStarted;
+    }
+    else
+    {
+        errorStatus = writerToStreamStatus(flashWriter_getStatus());
+        if(errorStatus == hexStream_retOk)
+        {
+            errorStatus = (state == STATE_END_OF_FILE) ? hexStream_retDone : hexStream_retBusy;
+        }
+    }
+    return errorStatus;
+}
+
+HexStream_ErrorStatus_t hexStream_getEntryPoint(pu32 entry)
+{
+    HexStream_ErrorStatus_t errorStatus = hexStream_retNullPointer;
+    if(entry)
+    {
+        *entry = entryPoint;
+        errorStatus = hexStream_retOk;
+    }
+    return errorStatus;
+}
+
+static HexStream_ErrorStatus_t writerToStreamStatus(FlashWriter_ErrorStatus_t writerStatus)
+{
+    HexStream_ErrorStatus_t errorStatus = hexStream_retFlashError;
+    switch(writerStatus)
+    {
+        case flashWriter_retOk:
+            errorStatus = hexStream_retOk;
+            break;
+        case flashWriter_retBusy:
+            errorStatus = hexStream_retBusy;
+            break;
+        case flashWriter_retInvalidAddress:
+            errorStatus = hexStream_retInvalidAddress;
+            break;
+        case flashWriter_retNotStarted:
+            errorStatus = hexStream_retNotStarted;
+            break;
+        default:
+            errorStatus = hexStream_retFlashError;
+            break;
+    }
+    return errorStatus;
+}
+
+/*
+    Intel HEX address of data byte i of a record:
+        - segment (02) mode: base + ((offset + i) mod 64KB), a long record goes back to the base address
+        - linear (04) mode: (base + offset + i) mod 4GB
+*/
+static HexStream_ErrorStatus_t writeData(const HexRecord_t* hexRecord)
+{
+    HexStream_ErrorStatus_t errorStatus = hexStream_retOk;
+    u32 address = upperAddress + hexRecord->address;
+    u32 firstPart = hexRecord->length;
+    u32 wrapAddress = 0;
+    if(addressingMode == ADDRESSING_SEGMENT)
+    {
+        wrapAddress = upperAddress;
+        if(hexRecord->address + firstPart > RECORD_OFFSET_RANGE)
+        {
+            firstPart = RECORD_OFFSET_RANGE - hexRecord->address;
+        }
+    }
+    else if(address && (u32) (0 - address) < firstPart)
+    {
+        firstPart = 0 - address;
+    }
+    if(firstPart)
+    {
+        errorStatus = writerToStreamStatus(flashWriter_write(address, hexRecord->data, firstPart));
+    }
+    if(errorStatus == hexStream_retOk && firstPart < hexRecord->length)
+    {
+        errorStatus = writerToStreamStatus(flashWriter_write(wrapAddress, &hexRecord->data[firstPart],
+                                                             hexRecord->length - firstPart));
+    }
+    return errorStatus;
+}
+
+static u8 isEndOfLine(u8 character)
+{
+    return (character == '\r' || character == '\n' || character == '\0');
+}
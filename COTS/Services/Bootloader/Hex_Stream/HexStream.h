@@ -0,0 +1,87 @@
+/**
+ * @file HexStream.h
+ * @author Ibrahim Saad
+ * @brief This is the interface of the Intel HEX stage of the bootloader which takes records
+ *        as they come from the link and gives their data to the flash writer
+ * @version 0.1
+ * @date 2023-06-18
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef HEX_STREAM_H
+#define HEX_STREAM_H
+
+#include "../../../LIB/Std_types.h"
+#include "../Hex_Parser/HexParser.h"
+
+#define HEX_STREAM_LINE_SIZE        MAX_BUFFER_SIZE
+
+typedef enum
+{
+    hexStream_retNotOk = 0,
+    hexStream_retOk,
+    hexStream_retNullPointer,
+    hexStream_retNotStarted,
+    hexStream_retInvalidRecord,         /* bad format or checksum */
+    hexStream_retUnsupportedRecord,
+    hexStream_retInvalidAddress,        /* data out of the image range */
+    hexStream_retFlashError,
+    hexStream_retBusy,                  /* end of file received, last blocks are programmed */
+    hexStream_retDone,                  /* end of file received and all data programmed */
+}HexStream_ErrorStatus_t;
+
+/*
+    Pipeline: link -> hexStream_feed (lines) -> hexStream_pushRecord (parse, extended linear/segment address)
+              -> flashWriter_write (aligned blocks) -> async flash engine
+    The block of a record is programmed in the background while the next records are received and
+    parsed, hexStream_feed/hexStream_pushRecord must be called from the main loop (not from the
+    USART interrupt) since they wait for the flash if it's behind the link.
+*/
+
+/**********************************************************
+    Description:       This function is used to start a new image in [startAddress, endAddress),
+                       the range is erased (blocking) by the flash writer
+***********************************************************/
+HexStream_ErrorStatus_t hexStream_begin(u32 startAddress, u32 endAddress);
+
+
+
+
+/**********************************************************
+    Description:       This function is used to pass count received characters, complete lines
+                       (':' to CR/LF) are given to hexStream_pushRecord, the first error is returned
+                       and the rest of the characters are dropped
+***********************************************************/
+HexStream_ErrorStatus_t hexStream_feed(const u8* characters, u32 count);
+
+
+
+
+/**********************************************************
+    Description:       This function is used to process one record (':' then the hex digits)
+
+    Return:            Returns HexStream_ErrorStatus_t
+                       - hexStream_retInvalidRecord (if the record is corrupted, ask the host to resend it)
+                       - hexStream_retBusy (if it's the end of file record)
+                       - hexStream_retOk (if the record is accepted)
+***********************************************************/
+HexStream_ErrorStatus_t hexStream_pushRecord(u8* record);
+
+
+
+
+/**********************************************************
+    Description:       This function returns hexStream_retDone when the end of file record was
+                       received and all data programmed, hexStream_retBusy until then
+***********************************************************/
+HexStream_ErrorStatus_t hexStream_getStatus(void);
+
+
+
+
+/* start address of the image (start linear or start segment address record), 0xFFFFFFFF if none */
+HexStream_ErrorStatus_t hexStream_getEntryPoint(pu32 entryPoint);
+
+#endif  /* HEX_STREAM_H */
@@ -0,0 +1,145 @@
+/**
+ * @file LzssStream.c
+ * @author Ibrahim Saad
+ * @brief This is the source file of the LZSS decompression stage of the bootloader
+ * @version 0.1
+ * @date 2023-06-18
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "LzssStream.h"
+
+#define MSK_WINDOW                  (LZSS_WINDOW_SIZE - 1)
+#define FLAGS_PER_BYTE              8
+#define FLAG_LITERAL                1
+
+static u8 window [LZSS_WINDOW_SIZE];
+static u32 expectedSize = 0;
+static u32 produced = 0;            /* bytes decoded, the last LZSS_WINDOW_SIZE ones are in window */
+static u32 flushed = 0;             /* bytes given to the sink */
+static u8 flags = 0;
+static u8 flagsLeft = 0;            /* items left for the flags byte, 0: next byte is a flags byte */
+static u8 matchLow = 0;
+static u8 hasMatchLow = 0;          /* first byte of a match received */
+static lzssSink_t outputSink = NULL;
+static LzssStream_ErrorStatus_t streamStatus = lzssStream_retNotStarted;
+
+static u8 flushWindow(void);
+
+LzssStream_ErrorStatus_t lzssStream_begin(u32 outputSize, lzssSink_t sink)
+{
+    LzssStream_ErrorStatus_t errorStatus = lzssStream_retNotOk;
+    if(!sink)
+    {
+        errorStatus = lzssStream_retNullPointer;
+    }
+    else
+    {
+        outputSink = sink;
+        expectedSize = outputSize;
+        produced = 0;
+        flushed = 0;
+        flagsLeft = 0;
+        hasMatchLow = 0;
+        streamStatus = outputSize ? lzssStream_retBusy : lzssStream_retDone;
+        errorStatus = lzssStream_retOk;
+    }
+    return errorStatus;
+}
+
+LzssStream_ErrorStatus_t lzssStream_feed(const u8* bytes, u32 count)
+{
+    LzssStream_ErrorStatus_t errorStatus = lzssStream_retNotOk;
+    if(!bytes)
+    {
+        errorStatus = lzssStream_retNullPointer;
+    }
+    else
+    {
+        u32 i;
+        if(streamStatus == lzssStream_retDone && count)
+        {
+            streamStatus = lzssStream_retCorrupted;
+        }
+        for(i = 0; i < count && streamStatus == lzssStream_retBusy; i++)
+        {
+            u8 byte = bytes[i];
+            if(!flagsLeft)
+            {
+                flags = byte;
+                flagsLeft = FLAGS_PER_BYTE;
+            }
+            else if(flags & FLAG_LITERAL)
+            {
+                window[produced & MSK_WINDOW] = byte;
+                produced++;
+                flags >>= 1;
+                flagsLeft--;
+            }
+            else if(!hasMatchLow)
+            {
+                matchLow = byte;
+                hasMatchLow = 1;
+            }
+            else
+            {
+                u16 token = (u16) (matchLow | (byte << 8));
+                u32 distance = (token & MSK_WINDOW) + 1;
+                u32 length = (token >> LZSS_WINDOW_BITS) + LZSS_MIN_MATCH;
+                hasMatchLow = 0;
+                flags >>= 1;
+                flagsLeft--;
+                if(distance > produced || length > expectedSize - produced)
+                {
+                    streamStatus = lzssStream_retCorrupted;
+                }
+                else
+                {
+                    u32 source = produced - distance;
+                    /* byte by byte, an overlapping copy repeats the bytes it has just written */
+                    while(length && streamStatus == lzssStream_retBusy)
+                    {
+                        window[produced & MSK_WINDOW] = window[source & MSK_WINDOW];
+                        produced++;
+                        source++;
+                        length--;
+                        if(!(produced & MSK_WINDOW) && !flushWindow())
+                        {
+                            streamStatus = lzssStream_retSinkError;
+                        }
+                    }
+                }
+            }
+            /* the window is given to the sink before it wraps over bytes not flushed */
+            if(streamStatus == lzssStream_retBusy && !(produced & MSK_WINDOW) && produced != flushed && !flushWindow())
+            {
+                streamStatus = lzssStream_retSinkError;
+            }
+            if(streamStatus == lzssStream_retBusy && produced == expectedSize)
+            {
+                streamStatus = lzssStream_retDone;
+                if(i + 1 < count)
+                {
+                    /* data after the end of the output */
+                    streamStatus = lzssStream_retCorrupted;
+                }
+            }
+        }
+        if((streamStatus == lzssStream_retBusy || streamStatus == lzssStream_retDone) && produced != flushed && !flushWindow())
+        {
+            streamStatus = lzssStream_retSinkError;
+        }
+        errorStatus = streamStatus;
+    }
+    return errorStatus;
+}
+
+/* bytes since the last flush are contiguous in window, a flush is done at least at each wrap */
+static u8 flushWindow(void)
+{
+    u8 accepted = outputSink(&window[flushed & MSK_WINDOW], produced - flushed);
+    flushed = produced;
+    return accepted;
+}
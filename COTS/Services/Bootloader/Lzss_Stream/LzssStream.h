@@ -0,0 +1,72 @@
+/**
+ * @file LzssStream.h
+ * @author Ibrahim Saad
+ * @brief This is the interface of the LZSS decompression stage of the bootloader, it takes the
+ *        compressed image in pieces of any size as they come from the link and gives the decoded
+ *        bytes in order to a sink (the flash writer), RAM is the window only
+ * @version 0.1
+ * @date 2023-06-18
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef LZSS_STREAM_H
+#define LZSS_STREAM_H
+
+#include "../../../LIB/Std_types.h"
+
+/*
+    Stream format (Tools/Lzss_Compress makes it):
+        - a flags byte is followed by up to 8 items, bit 0 of the flags is the first item
+        - flag 1: literal, one byte copied to the output
+        - flag 0: match, two bytes little endian, bits [LZSS_WINDOW_BITS-1:0] are distance - 1 and the
+          upper bits are length - LZSS_MIN_MATCH, the bytes at distance back in the output are copied
+          (the copy may overlap the bytes it writes)
+        - the stream ends when the output size given to lzssStream_begin is reached
+    The window is 1 << LZSS_WINDOW_BITS bytes of RAM, the compressor must use the same LZSS_WINDOW_BITS.
+*/
+#define LZSS_WINDOW_BITS            12
+#define LZSS_WINDOW_SIZE            (1 << LZSS_WINDOW_BITS)
+#define LZSS_MIN_MATCH              3
+#define LZSS_MAX_MATCH              (LZSS_MIN_MATCH + (1 << (16 - LZSS_WINDOW_BITS)) - 1)
+
+/* header of the compressed image files of the host tools, it isn't part of the stream */
+#define LZSS_FILE_MAGIC             0x31535A4C      /* "LZS1" little endian */
+#define LZSS_FILE_HEADER_SIZE       12              /* magic, output size, softCrc_updateBytes of the output (u32s) */
+
+typedef enum
+{
+    lzssStream_retNotOk = 0,
+    lzssStream_retOk,
+    lzssStream_retNullPointer,
+    lzssStream_retNotStarted,
+    lzssStream_retCorrupted,            /* match before the start of the output or data after its end */
+    lzssStream_retSinkError,
+    lzssStream_retBusy,                 /* more input is needed */
+    lzssStream_retDone,                 /* output size reached */
+}LzssStream_ErrorStatus_t;
+
+/* takes length decoded bytes, returns 0 to stop the stream (lzssStream_retSinkError) */
+typedef u8 (*lzssSink_t)(const u8* data, u32 length);
+
+/**********************************************************
+    Description:       This function is used to start a new stream decoded to outputSize bytes
+***********************************************************/
+LzssStream_ErrorStatus_t lzssStream_begin(u32 outputSize, lzssSink_t sink);
+
+
+
+
+/**********************************************************
+    Description:       This function is used to decode count bytes of the stream, the decoded bytes
+                       are given to the sink before it returns (at most LZSS_WINDOW_SIZE bytes a call)
+
+    Return:            Returns LzssStream_ErrorStatus_t
+                       - lzssStream_retBusy (if the output isn't complete)
+                       - lzssStream_retDone (if the output size is reached by the last byte)
+                       - lzssStream_retCorrupted, lzssStream_retSinkError (stream stopped)
+***********************************************************/
+LzssStream_ErrorStatus_t lzssStream_feed(const u8* bytes, u32 count);
+
+#endif  /* LZSS_STREAM_H */
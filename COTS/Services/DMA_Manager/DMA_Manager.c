@@ -0,0 +1,226 @@
+/*******************************************************************
+*   File name:    DMA_Manager.c
+*   Author:       Ibrahim Saad
+*   Description:  This file contains all APIs definitions of the DMA manager module
+*   Version: v1.0
+*******************************************************************/
+
+#include "DMA_Manager.h"
+
+#define DMA_COUNTS                  2
+#define STREAMS_COUNT               8
+#define DMA1_IDX                    0
+#define DMA2_IDX                    1
+
+#define STREAM_FREE                 0
+#define STREAM_GRANTED              1
+
+/* 
+    Request map of STM32F401 (RM0368 DMA1/DMA2 request mapping), preferred route first,
+    unused routes are left zero (dmaId = 0)
+*/
+static const dmaGrant_t requestRoutes [dmaRequestCount][DMA_MANAGER_MAX_ROUTES] =
+{
+    [dmaRequest_SPI1_RX]      = {{dmaId_2, streamId_0, channelId_3}, {dmaId_2, streamId_2, channelId_3}},
+    [dmaRequest_SPI1_TX]      = {{dmaId_2, streamId_3, channelId_3}, {dmaId_2, streamId_5, channelId_3}},
+    [dmaRequest_SPI2_RX]      = {{dmaId_1, streamId_3, channelId_0}},
+    [dmaRequest_SPI2_TX]      = {{dmaId_1, streamId_4, channelId_0}},
+    [dmaRequest_SPI3_RX]      = {{dmaId_1, streamId_0, channelId_0}, {dmaId_1, streamId_2, channelId_0}},
+    [dmaRequest_SPI3_TX]      = {{dmaId_1, streamId_5, channelId_0}, {dmaId_1, streamId_7, channelId_0}},
+    [dmaRequest_SPI4_RX]      = {{dmaId_2, streamId_0, channelId_4}, {dmaId_2, streamId_3, channelId_5}},
+    [dmaRequest_SPI4_TX]      = {{dmaId_2, streamId_1, channelId_4}, {dmaId_2, streamId_4, channelId_5}},
+    [dmaRequest_I2S2_EXT_RX]  = {{dmaId_1, streamId_3, channelId_3}},
+    [dmaRequest_I2S2_EXT_TX]  = {{dmaId_1, streamId_4, channelId_2}},
+    [dmaRequest_I2S3_EXT_RX]  = {{dmaId_1, streamId_0, channelId_3}, {dmaId_1, streamId_2, channelId_2}},
+    [dmaRequest_I2S3_EXT_TX]  = {{dmaId_1, streamId_5, channelId_2}},
+    [dmaRequest_I2C1_RX]      = {{dmaId_1, streamId_0, channelId_1}, {dmaId_1, streamId_5, channelId_1}},
+    [dmaRequest_I2C1_TX]      = {{dmaId_1, streamId_6, channelId_1}, {dmaId_1, streamId_7, channelId_1}},
+    [dmaRequest_I2C2_RX]      = {{dmaId_1, streamId_2, channelId_7}, {dmaId_1, streamId_3, channelId_7}},
+    [dmaRequest_I2C2_TX]      = {{dmaId_1, streamId_7, channelId_7}},
+    [dmaRequest_I2C3_RX]      = {{dmaId_1, streamId_1, channelId_1}, {dmaId_1, streamId_2, channelId_3}},
+    [dmaRequest_I2C3_TX]      = {{dmaId_1, streamId_4, channelId_3}, {dmaId_1, streamId_5, channelId_6}},
+    [dmaRequest_USART1_RX]    = {{dmaId_2, streamId_2, channelId_4}, {dmaId_2, streamId_5, channelId_4}},
+    [dmaRequest_USART1_TX]    = {{dmaId_2, streamId_7, channelId_4}},
+    [dmaRequest_USART2_RX]    = {{dmaId_1, streamId_5, channelId_4}},
+    [dmaRequest_USART2_TX]    = {{dmaId_1, streamId_6, channelId_4}},
+    [dmaRequest_USART6_RX]    = {{dmaId_2, streamId_1, channelId_5}, {dmaId_2, streamId_2, channelId_5}},
+    [dmaRequest_USART6_TX]    = {{dmaId_2, streamId_6, channelId_5}, {dmaId_2, streamId_7, channelId_5}},
+    [dmaRequest_ADC1]         = {{dmaId_2, streamId_0, channelId_0}, {dmaId_2, streamId_4, channelId_0}},
+    [dmaRequest_SDIO]         = {{dmaId_2, streamId_3, channelId_4}, {dmaId_2, streamId_6, channelId_4}},
+    [dmaRequest_TIM1_UP]      = {{dmaId_2, streamId_5, channelId_6}},
+    [dmaRequest_TIM1_CH1]     = {{dmaId_2, streamId_1, channelId_6}, {dmaId_2, streamId_3, channelId_6}, {dmaId_2, streamId_6, channelId_0}},
+    [dmaRequest_TIM1_CH2]     = {{dmaId_2, streamId_2, channelId_6}, {dmaId_2, streamId_6, channelId_0}},
+    [dmaRequest_TIM1_CH3]     = {{dmaId_2, streamId_6, channelId_6}, {dmaId_2, streamId_6, channelId_0}},
+    [dmaRequest_TIM1_CH4]     = {{dmaId_2, streamId_4, channelId_6}},
+    [dmaRequest_TIM1_TRIG]    = {{dmaId_2, streamId_0, channelId_6}, {dmaId_2, streamId_4, channelId_6}},
+    [dmaRequest_TIM1_COM]     = {{dmaId_2, streamId_4, channelId_6}},
+    [dmaRequest_TIM2_UP]      = {{dmaId_1, streamId_1, channelId_3}, {dmaId_1, streamId_7, channelId_3}},
+    [dmaRequest_TIM2_CH1]     = {{dmaId_1, streamId_5, channelId_3}},
+    [dmaRequest_TIM2_CH2]     = {{dmaId_1, streamId_6, channelId_3}},
+    [dmaRequest_TIM2_CH3]     = {{dmaId_1, streamId_1, channelId_3}},
+    [dmaRequest_TIM2_CH4]     = {{dmaId_1, streamId_6, channelId_3}, {dmaId_1, streamId_7, channelId_3}},
+    [dmaRequest_TIM3_UP]      = {{dmaId_1, streamId_2, channelId_5}},
+    [dmaRequest_TIM3_CH1]     = {{dmaId_1, streamId_4, channelId_5}},
+    [dmaRequest_TIM3_CH2]     = {{dmaId_1, streamId_5, channelId_5}},
+    [dmaRequest_TIM3_CH3]     = {{dmaId_1, streamId_7, channelId_5}},
+    [dmaRequest_TIM3_CH4]     = {{dmaId_1, streamId_2, channelId_5}},
+    [dmaRequest_TIM3_TRIG]    = {{dmaId_1, streamId_4, channelId_5}},
+    [dmaRequest_TIM4_UP]      = {{dmaId_1, streamId_6, channelId_2}},
+    [dmaRequest_TIM4_CH1]     = {{dmaId_1, streamId_0, channelId_2}},
+    [dmaRequest_TIM4_CH2]     = {{dmaId_1, streamId_3, channelId_2}},
+    [dmaRequest_TIM4_CH3]     = {{dmaId_1, streamId_7, channelId_2}},
+    [dmaRequest_TIM5_UP]      = {{dmaId_1, streamId_0, channelId_6}, {dmaId_1, streamId_6, channelId_6}},
+    [dmaRequest_TIM5_CH1]     = {{dmaId_1, streamId_2, channelId_6}},
+    [dmaRequest_TIM5_CH2]     = {{dmaId_1, streamId_4, channelId_6}},
+    [dmaRequest_TIM5_CH3]     = {{dmaId_1, streamId_0, channelId_6}},
+    [dmaRequest_TIM5_CH4]     = {{dmaId_1, streamId_1, channelId_6}, {dmaId_1, streamId_3, channelId_6}},
+    [dmaRequest_TIM5_TRIG]    = {{dmaId_1, streamId_1, channelId_6}, {dmaId_1, streamId_3, channelId_6}},
+};
+
+static const u16 streamIds [STREAMS_COUNT] = 
+{
+    streamId_0, streamId_1, streamId_2, streamId_3, streamId_4, streamId_5, streamId_6, streamId_7
+};
+
+static u8 streamsState [DMA_COUNTS][STREAMS_COUNT];
+
+static DMA_Manager_ErrorStatus_t getStreamIndices(u32 dmaId, u16 streamId, pu8 dmaIndex, pu8 streamIndex);
+static u8 getRoute(dmaRequest_t request, u8 routeIndex, dmaGrant_t* route);
+static u8 placeRequests(const dmaRequest_t* requests, u8 count, u8 index, dmaGrant_t* grants);
+
+DMA_Manager_ErrorStatus_t dmaManager_requestStream(dmaRequest_t request, dmaGrant_t* grant)
+{
+    return dmaManager_requestStreams(&request, 1, grant);
+}
+
+DMA_Manager_ErrorStatus_t dmaManager_requestStreams(const dmaRequest_t* requests, u8 count, dmaGrant_t* grants)
+{
+    DMA_Manager_ErrorStatus_t errorStatus = dmaManager_retNotOk;
+    if(requests && grants)
+    {
+        u8 iterator;
+        errorStatus = dmaManager_retOk;
+        for(iterator = 0; iterator < count; iterator++)
+        {
+            if(requests[iterator] >= dmaRequestCount)
+            {
+                errorStatus = dmaManager_retInvalidRequest;
+            }
+        }
+        if(errorStatus == dmaManager_retOk)
+        {
+            if(!placeRequests(requests, count, 0, grants))
+            {
+                errorStatus = dmaManager_retNoFreeStream;
+            }
+        }
+    }
+    else
+    {
+        errorStatus = dmaManager_retNullPointer;
+    }
+    return errorStatus;
+}
+
+DMA_Manager_ErrorStatus_t dmaManager_claimStream(u32 dmaId, u16 streamId)
+{
+    u8 dmaIndex, streamIndex;
+    DMA_Manager_ErrorStatus_t errorStatus = getStreamIndices(dmaId, streamId, &dmaIndex, &streamIndex);
+    if(errorStatus == dmaManager_retOk)
+    {
+        if(streamsState[dmaIndex][streamIndex] == STREAM_FREE)
+        {
+            streamsState[dmaIndex][streamIndex] = STREAM_GRANTED;
+        }
+        else
+        {
+            errorStatus = dmaManager_retStreamAlreadyGranted;
+        }
+    }
+    return errorStatus;
+}
+
+DMA_Manager_ErrorStatus_t dmaManager_releaseStream(u32 dmaId, u16 streamId)
+{
+    u8 dmaIndex, streamIndex;
+    DMA_Manager_ErrorStatus_t errorStatus = getStreamIndices(dmaId, streamId, &dmaIndex, &streamIndex);
+    if(errorStatus == dmaManager_retOk)
+    {
+        if(streamsState[dmaIndex][streamIndex] == STREAM_GRANTED)
+        {
+            streamsState[dmaIndex][streamIndex] = STREAM_FREE;
+        }
+        else
+        {
+            errorStatus = dmaManager_retStreamNotGranted;
+        }
+    }
+    return errorStatus;
+}
+
+static DMA_Manager_ErrorStatus_t getStreamIndices(u32 dmaId, u16 streamId, pu8 dmaIndex, pu8 streamIndex)
+{
+    DMA_Manager_ErrorStatus_t errorStatus = dmaManager_retInvalidStream;
+    u8 iterator;
+    if(dmaId == dmaId_1 || dmaId == dmaId_2)
+    {
+        *dmaIndex = (dmaId == dmaId_1) ? DMA1_IDX : DMA2_IDX;
+        for(iterator = 0; iterator < STREAMS_COUNT; iterator++)
+        {
+            if(streamIds[iterator] == streamId)
+            {
+                *streamIndex = iterator;
+                errorStatus = dmaManager_retOk;
+            }
+        }
+    }
+    return errorStatus;
+}
+
+static u8 getRoute(dmaRequest_t request, u8 routeIndex, dmaGrant_t* route)
+{
+    u8 found = 0;
+    if(request == dmaRequest_MemToMem)
+    {
+        /* high streams first, low DMA2 streams serve most of the peripherals */
+        if(routeIndex < STREAMS_COUNT)
+        {
+            route->dmaId = dmaId_2;
+            route->streamId = streamIds[STREAMS_COUNT - 1 - routeIndex];
+            route->channelId = channelId_0;
+            found = 1;
+        }
+    }
+    else if(routeIndex < DMA_MANAGER_MAX_ROUTES && requestRoutes[request][routeIndex].dmaId)
+    {
+        *route = requestRoutes[request][routeIndex];
+        found = 1;
+    }
+    return found;
+}
+
+static u8 placeRequests(const dmaRequest_t* requests, u8 count, u8 index, dmaGrant_t* grants)
+{
+    u8 placed = 0, routeIndex = 0, dmaIndex, streamIndex;
+    dmaGrant_t route;
+    if(index == count)
+    {
+        placed = 1;
+    }
+    while(!placed && getRoute(requests[index], routeIndex, &route))
+    {
+        getStreamIndices(route.dmaId, route.streamId, &dmaIndex, &streamIndex);
+        if(streamsState[dmaIndex][streamIndex] == STREAM_FREE)
+        {
+            streamsState[dmaIndex][streamIndex] = STREAM_GRANTED;
+            grants[index] = route;
+            placed = placeRequests(requests, count, index + 1, grants);
+            if(!placed)
+            {
+                streamsState[dmaIndex][streamIndex] = STREAM_FREE;
+            }
+        }
+        routeIndex++;
+    }
+    return placed;
+}
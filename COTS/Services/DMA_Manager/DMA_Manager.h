@@ -0,0 +1,153 @@
+/*******************************************************************
+*   File name:    DMA_Manager.h
+*   Author:       Ibrahim Saad
+*   Description:  This file contains all APIs of the DMA manager module which grants
+*                 DMA streams/channels to peripheral requests based on STM32F401 request map
+*   Version: v1.0
+*******************************************************************/
+
+#ifndef DMA_MANAGER_H
+#define DMA_MANAGER_H
+
+#include "../../LIB/Std_types.h"
+#include "../../MCAL/DMA/STM_DMA.h"
+
+#define DMA_MANAGER_MAX_ROUTES      3   /* max number of (dma, stream, channel) serving one request */
+
+typedef enum
+{
+    dmaRequest_SPI1_RX = 0,
+    dmaRequest_SPI1_TX,
+    dmaRequest_SPI2_RX,
+    dmaRequest_SPI2_TX,
+    dmaRequest_SPI3_RX,
+    dmaRequest_SPI3_TX,
+    dmaRequest_SPI4_RX,
+    dmaRequest_SPI4_TX,
+    dmaRequest_I2S2_EXT_RX,
+    dmaRequest_I2S2_EXT_TX,
+    dmaRequest_I2S3_EXT_RX,
+    dmaRequest_I2S3_EXT_TX,
+    dmaRequest_I2C1_RX,
+    dmaRequest_I2C1_TX,
+    dmaRequest_I2C2_RX,
+    dmaRequest_I2C2_TX,
+    dmaRequest_I2C3_RX,
+    dmaRequest_I2C3_TX,
+    dmaRequest_USART1_RX,
+    dmaRequest_USART1_TX,
+    dmaRequest_USART2_RX,
+    dmaRequest_USART2_TX,
+    dmaRequest_USART6_RX,
+    dmaRequest_USART6_TX,
+    dmaRequest_ADC1,
+    dmaRequest_SDIO,
+    dmaRequest_TIM1_UP,
+    dmaRequest_TIM1_CH1,
+    dmaRequest_TIM1_CH2,
+    dmaRequest_TIM1_CH3,
+    dmaRequest_TIM1_CH4,
+    dmaRequest_TIM1_TRIG,
+    dmaRequest_TIM1_COM,
+    dmaRequest_TIM2_UP,
+    dmaRequest_TIM2_CH1,
+    dmaRequest_TIM2_CH2,
+    dmaRequest_TIM2_CH3,
+    dmaRequest_TIM2_CH4,
+    dmaRequest_TIM3_UP,
+    dmaRequest_TIM3_CH1,
+    dmaRequest_TIM3_CH2,
+    dmaRequest_TIM3_CH3,
+    dmaRequest_TIM3_CH4,
+    dmaRequest_TIM3_TRIG,
+    dmaRequest_TIM4_UP,
+    dmaRequest_TIM4_CH1,
+    dmaRequest_TIM4_CH2,
+    dmaRequest_TIM4_CH3,
+    dmaRequest_TIM5_UP,
+    dmaRequest_TIM5_CH1,
+    dmaRequest_TIM5_CH2,
+    dmaRequest_TIM5_CH3,
+    dmaRequest_TIM5_CH4,
+    dmaRequest_TIM5_TRIG,
+    dmaRequest_MemToMem,        /* any free DMA2 stream, channel 0 */
+    dmaRequestCount,            /* don't change value of this enumerator or remove it */
+}dmaRequest_t;
+
+typedef enum
+{
+    dmaManager_retNotOk = 0,
+    dmaManager_retOk,
+    dmaManager_retNullPointer,
+    dmaManager_retInvalidRequest,
+    dmaManager_retInvalidStream,
+    dmaManager_retNoFreeStream,
+    dmaManager_retStreamAlreadyGranted,
+    dmaManager_retStreamNotGranted,
+}DMA_Manager_ErrorStatus_t;
+
+typedef struct
+{
+    u32 dmaId;
+    u16 streamId;
+    u8 channelId;
+}dmaGrant_t;
+
+/**********************************************************
+    Description:       This function is used to get a stream/channel serving a request, the preferred
+                       stream is tried first then the alternatives from the request map
+
+    Input parameters:  request from dmaRequest_t
+                       A valid pointer (Not NULL) to store the granted dmaId, streamId and channelId
+
+    Return:            Returns DMA_Manager_ErrorStatus_t
+                       - dmaManager_retInvalidRequest (if got invalid request)
+                       - dmaManager_retNullPointer (if got a NULL pointer)
+                       - dmaManager_retNoFreeStream (if all streams serving the request are granted)
+                       - dmaManager_retOk (if a stream is granted)
+***********************************************************/
+DMA_Manager_ErrorStatus_t dmaManager_requestStream(dmaRequest_t request, dmaGrant_t* grant);
+
+
+
+
+/**********************************************************
+    Description:       This function is used at init to grant streams to many requests at once, it
+                       searches all combinations of alternatives so requests sharing streams are
+                       placed together, nothing is granted if they can't all be served
+
+    Input parameters:  Array of requests and its count
+                       Array (Not NULL) of count grants to store the result in it
+
+    Return:            Same as dmaManager_requestStream
+***********************************************************/
+DMA_Manager_ErrorStatus_t dmaManager_requestStreams(const dmaRequest_t* requests, u8 count, dmaGrant_t* grants);
+
+
+
+
+/**********************************************************
+    Description:       This function is used by drivers using a fixed stream to mark it as granted,
+                       so a later request for the same stream is rejected
+
+    Return:            Returns DMA_Manager_ErrorStatus_t
+                       - dmaManager_retInvalidStream (if got invalid dmaId or streamId)
+                       - dmaManager_retStreamAlreadyGranted (if the stream is already granted)
+                       - dmaManager_retOk (if the stream is now granted)
+***********************************************************/
+DMA_Manager_ErrorStatus_t dmaManager_claimStream(u32 dmaId, u16 streamId);
+
+
+
+
+/**********************************************************
+    Description:       This function is used to give back a granted stream
+
+    Return:            Returns DMA_Manager_ErrorStatus_t
+                       - dmaManager_retInvalidStream (if got invalid dmaId or streamId)
+                       - dmaManager_retStreamNotGranted (if the stream is not granted)
+                       - dmaManager_retOk (if the stream is released)
+***********************************************************/
+DMA_Manager_ErrorStatus_t dmaManager_releaseStream(u32 dmaId, u16 streamId);
+
+#endif
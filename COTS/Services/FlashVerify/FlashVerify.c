@@ -0,0 +1,144 @@
+/*******************************************************************
+*   File name:    FlashVerify.c
+*   Author:       Ibrahim Saad
+*   Description:  This file contains all APIs definitions of the flash verify module
+*   Version: v1.0
+*******************************************************************/
+
+#include "FlashVerify.h"
+#include "../../MCAL/CRC_Unit/CRC.h"
+#include "../DMA_Manager/DMA_Manager.h"
+
+#define PHASE_SOURCE            0
+#define PHASE_FLASH             1
+
+static dmaGrant_t grant;
+static u8 initialized = 0;
+static volatile u8 busy = 0;
+
+static u8 phase = PHASE_FLASH;
+static const u32* flashRegion = NULL;
+static u32 regionWords = 0;
+static u32 expected = 0;
+static flashVerifyCbf_t verifyCallback = NULL;
+
+static FlashVerify_ErrorStatus_t startJob(const u32* flashAddress, const u32* source, u32 wordsCount, u32 expectedCrc, flashVerifyCbf_t cbf);
+static CRC_ErrorStatus_t startPhase(const u32* address);
+static void finishJob(FlashVerify_ErrorStatus_t result, u32 crc);
+static void crcDoneCallback(CRC_ErrorStatus_t result, u32 crc);
+
+FlashVerify_ErrorStatus_t flashVerify_init(void)
+{
+    FlashVerify_ErrorStatus_t errorStatus = flashVerify_retNotOk;
+    if(initialized)
+    {
+        errorStatus = flashVerify_retOk;
+    }
+    else if(dmaManager_requestStream(dmaRequest_MemToMem, &grant) != dmaManager_retOk)
+    {
+        errorStatus = flashVerify_retNoDmaStream;
+    }
+    else
+    {
+        initialized = 1;
+        errorStatus = flashVerify_retOk;
+    }
+    return errorStatus;
+}
+FlashVerify_ErrorStatus_t flashVerify_compare(const u32* flashAddress, const u32* source, u32 wordsCount, flashVerifyCbf_t cbf)
+{
+    FlashVerify_ErrorStatus_t errorStatus = flashVerify_retNullPointer;
+    if(source)
+    {
+        errorStatus = startJob(flashAddress, source, wordsCount, 0, cbf);
+    }
+    return errorStatus;
+}
+
+FlashVerify_ErrorStatus_t flashVerify_check(const u32* flashAddress, u32 wordsCount, u32 expectedCrc, flashVerifyCbf_t cbf)
+{
+    return startJob(flashAddress, NULL, wordsCount, expectedCrc, cbf);
+}
+
+static FlashVerify_ErrorStatus_t startJob(const u32* flashAddress, const u32* source, u32 wordsCount, u32 expectedCrc, flashVerifyCbf_t cbf)
+{
+    FlashVerify_ErrorStatus_t errorStatus = flashVerify_retNotOk;
+    if(!initialized)
+    {
+        errorStatus = flashVerify_retNotInitialized;
+    }
+    else if(!flashAddress || !cbf)
+    {
+        errorStatus = flashVerify_retNullPointer;
+    }
+    else if(wordsCount == 0)
+    {
+        errorStatus = flashVerify_retInvalidLength;
+    }
+    else if(busy)
+    {
+        errorStatus = flashVerify_retBusy;
+    }
+    else
+    {
+        CRC_ErrorStatus_t crcStatus;
+        busy = 1;
+        flashRegion = flashAddress;
+        regionWords = wordsCount;
+        verifyCallback = cbf;
+        expected = expectedCrc;
+        if(source)
+        {
+            phase = PHASE_SOURCE;
+            crcStatus = startPhase(source);
+        }
+        else
+        {
+            phase = PHASE_FLASH;
+            crcStatus = startPhase(flashAddress);
+        }
+        if(crcStatus == crc_retOk)
+        {
+            errorStatus = flashVerify_retOk;
+        }
+        else
+        {
+            busy = 0;
+            errorStatus = flashVerify_retDmaError;
+        }
+    }
+    return errorStatus;
+}
+
+static CRC_ErrorStatus_t startPhase(const u32* address)
+{
+    crc_resetCRCValue();
+    return crc_getDataBlockCRCAsync(grant.streamId, address, regionWords, crcDoneCallback);
+}
+
+static void finishJob(FlashVerify_ErrorStatus_t result, u32 crc)
+{
+    busy = 0;
+    verifyCallback(result, crc);
+}
+
+static void crcDoneCallback(CRC_ErrorStatus_t result, u32 crc)
+{
+    if(result != crc_retOk)
+    {
+        finishJob(flashVerify_retDmaError, 0);
+    }
+    else if(phase == PHASE_SOURCE)
+    {
+        expected = crc;
+        phase = PHASE_FLASH;
+        if(startPhase(flashRegion) != crc_retOk)
+        {
+            finishJob(flashVerify_retDmaError, 0);
+        }
+    }
+    else
+    {
+        finishJob((crc == expected) ? flashVerify_retOk : flashVerify_retMismatch, crc);
+    }
+}
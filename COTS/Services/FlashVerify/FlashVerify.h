@@ -0,0 +1,67 @@
+/*******************************************************************
+*   File name:    FlashVerify.h
+*   Author:       Ibrahim Saad
+*   Description:  This file contains all APIs of the flash verify module which checks a flash
+*                 region by streaming it to the CRC unit by a DMA2 memory to memory stream
+*   Version: v1.0
+*******************************************************************/
+
+#ifndef FLASH_VERIFY_H
+#define FLASH_VERIFY_H
+
+#include "../../LIB/Std_types.h"
+
+typedef enum
+{
+    flashVerify_retNotOk = 0,
+    flashVerify_retOk,
+    flashVerify_retNullPointer,
+    flashVerify_retNotInitialized,
+    flashVerify_retInvalidLength,
+    flashVerify_retBusy,
+    flashVerify_retNoDmaStream,
+    flashVerify_retDmaError,
+    flashVerify_retMismatch,
+}FlashVerify_ErrorStatus_t;
+
+/* result is flashVerify_retOk, flashVerify_retMismatch or flashVerify_retDmaError, crc is the one of flash region */
+typedef void (*flashVerifyCbf_t)(FlashVerify_ErrorStatus_t result, u32 crc);
+
+/**********************************************************
+    Description:       This function is used to get a free DMA2 stream from DMA manager for verify jobs,
+                       DMA2 clock and CRC clock must be enabled and the interrupt of the granted stream
+                       enabled in NVIC by the user
+
+    Return:            Returns FlashVerify_ErrorStatus_t
+                       - flashVerify_retNoDmaStream (if DMA manager has no free DMA2 stream)
+                       - flashVerify_retOk (if ready)
+***********************************************************/
+FlashVerify_ErrorStatus_t flashVerify_init(void);
+
+
+
+
+/**********************************************************
+    Description:       This function is used to compare a flash region with the source data it was
+                       programmed from, the source then the flash region are streamed to the CRC unit
+                       in the background and cbf gets the result
+
+    Input parameters:  flashAddress, source (Not NULL, word aligned), wordsCount (Not 0)
+                       cbf (Not NULL) called from DMA interrupt
+
+    Return:            Returns FlashVerify_ErrorStatus_t
+                       - flashVerify_retBusy (if a verify job is running)
+                       - flashVerify_retOk (if the job is started)
+***********************************************************/
+FlashVerify_ErrorStatus_t flashVerify_compare(const u32* flashAddress, const u32* source, u32 wordsCount, flashVerifyCbf_t cbf);
+
+
+
+
+/**********************************************************
+    Description:       Same as flashVerify_compare but the flash region is checked against a CRC
+                       (CRC unit polynomial, initial value 0xFFFFFFFF) calculated before
+***********************************************************/
+FlashVerify_ErrorStatus_t flashVerify_check(const u32* flashAddress, u32 wordsCount, u32 expectedCrc, flashVerifyCbf_t cbf);
+
+#endif
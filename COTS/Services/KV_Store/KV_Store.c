@@ -0,0 +1,645 @@
+/*******************************************************************
+*   File name:    KV_Store.c
+*   Author:       Ibrahim Saad
+*   Description:  This file contains all APIs definitions of the key/value store module
+*   Version: v1.0
+*******************************************************************/
+
+#include "KV_Store.h"
+#include "../../LIB/Address.h"
+
+/*
+    Sector layout:
+        header (16 bytes): erase count, sequence, magic, obsolete
+            - erase count is programmed right after the erase
+            - sequence then magic are programmed when the sector becomes the active one
+            - obsolete is programmed before the erase, so a half erased sector is never mounted
+        records appended after the header, each one is word aligned:
+            - word: key (31:16), delete flag (15), length (14:0)
+            - data padded to a word (padding bytes left erased)
+            - word: FNV-1a of header and data, programmed last so it marks the record valid
+*/
+#define SECTOR_HEADER_SIZE              16
+#define HEADER_ERASE_COUNT_OFFSET       0
+#define HEADER_SEQUENCE_OFFSET          4
+#define HEADER_MAGIC_OFFSET             8
+#define HEADER_OBSOLETE_OFFSET          12
+#define SECTOR_MAGIC                    0x4B565354      /* "KVST" */
+
+#define FNV_OFFSET_BASIS                0x811C9DC5
+#define FNV_PRIME                       0x01000193
+#define RECORD_KEY_SHIFT                16
+#define RECORD_DELETED                  0x8000
+#define MSK_RECORD_LENGTH               0x7FFF
+
+#define FLASH_ERASED_WORD               0xFFFFFFFF
+#define NO_RECORD                       0
+
+#define SECTOR_FREE                     0
+#define SECTOR_USED                     1
+#define SECTOR_ERASING                  2
+#define NO_SECTOR                       0xFF
+
+/* sectors kept free for compaction, only kv_runnable may open the last one */
+#define RESERVED_FREE_SECTORS           1
+
+#define COMPACTION_IDLE                 0
+#define COMPACTION_COPYING              1
+#define COMPACTION_ERASING              2
+#define COMPACTION_FAILED               3       /* flash errors, writes fail until kv_init */
+#define COMPACTION_MAX_RETRIES          3       /* flash errors of a compaction before it fails */
+
+#define GET_SECTOR_ADD(index)           (KV_FIRST_SECTOR_ADD + ((u32) (index) * KV_SECTOR_SIZE))
+#define GET_RECORD_SIZE(length)         (4 + (((u32) (length) + 3) & ~3UL) + 4)
+#define READ_WORD(address)              (*(const volatile u32*) TO_POINTER(address))
+
+static u32 keysIndex [KV_MAX_KEYS];            /* address of the live record of each key, 0: no value */
+static u32 sectorsSequence [KV_SECTORS_COUNT];
+static u32 sectorsEraseCount [KV_SECTORS_COUNT];
+static u8 sectorsState [KV_SECTORS_COUNT];
+static u8 activeSector = NO_SECTOR;
+static u32 writeAddress = 0;
+static u32 lastSequence = 0;
+static u8 initialized = 0;
+
+static u8 compactionState = COMPACTION_IDLE;
+static u8 compactedSector = NO_SECTOR;
+static u16 compactionKey = 0;
+static u8 compactionRetries = 0;
+static u8 eraseRequested = 0;
+static volatile u8 eraseDone = 0;
+static volatile FLASH_ErrorStatus_t eraseStatus = flash_retNotOk;
+
+static KV_ErrorStatus_t programWord(u32 address, u32 value);
+static KV_ErrorStatus_t eraseSectorBlocking(u8 sectorIndex);
+static u8 isSectorBlank(u8 sectorIndex);
+static u32 calculateChecksum(u32 header, const u8* data, u16 length);
+static u32 replaySector(u8 sectorIndex);
+static u8 countFreeSectors(void);
+static u32 countLiveBytes(u8 sectorIndex);
+static u8 findCompactedSector(void);
+static void compactionFlashError(void);
+static KV_ErrorStatus_t openNextSector(u8 useReserve);
+static KV_ErrorStatus_t appendRecord(u16 key, const void* data, u16 lengthField, u8 useReserve);
+static void eraseDoneCallback(FLASH_ErrorStatus_t status);
+
+KV_ErrorStatus_t kv_init(void)
+{
+    KV_ErrorStatus_t errorStatus = kv_retOk;
+    u8 mountOrder [KV_SECTORS_COUNT];
+    u8 usedCount = 0;
+    u32 maxEraseCount = 0;
+    u8 countsKnown = 0;
+    u8 index, j, temp;
+    u16 key;
+    u32 base;
+    if(flash_unlock() != flash_retOk)
+    {
+        errorStatus = kv_retFlashError;
+    }
+    for(key = 0; key < KV_MAX_KEYS; key++)
+    {
+        keysIndex[key] = NO_RECORD;
+    }
+    for(index = 0; index < KV_SECTORS_COUNT; index++)
+    {
+        base = GET_SECTOR_ADD(index);
+        sectorsEraseCount[index] = READ_WORD(base + HEADER_ERASE_COUNT_OFFSET);
+        sectorsSequence[index] = READ_WORD(base + HEADER_SEQUENCE_OFFSET);
+        if(READ_WORD(base + HEADER_MAGIC_OFFSET) == SECTOR_MAGIC && sectorsSequence[index] != FLASH_ERASED_WORD
+            && READ_WORD(base + HEADER_OBSOLETE_OFFSET) == FLASH_ERASED_WORD)
+        {
+            sectorsState[index] = SECTOR_USED;
+            mountOrder[usedCount++] = index;
+        }
+        else if(isSectorBlank(index))
+        {
+            sectorsState[index] = SECTOR_FREE;
+        }
+        else
+        {
+            /* power loss while compacting, erasing or opening the sector */
+            sectorsState[index] = SECTOR_ERASING;
+        }
+        if(sectorsEraseCount[index] != FLASH_ERASED_WORD)
+        {
+            countsKnown = 1;
+            if(sectorsEraseCount[index] > maxEraseCount)
+            {
+                maxEraseCount = sectorsEraseCount[index];
+            }
+        }
+    }
+    for(index = 0; index < KV_SECTORS_COUNT && errorStatus == kv_retOk; index++)
+    {
+        if(sectorsState[index] == SECTOR_ERASING)
+        {
+            /* its counter may be lost by the interrupted erase, the highest known one is kept */
+            if(sectorsEraseCount[index] == FLASH_ERASED_WORD)
+            {
+                sectorsEraseCount[index] = maxEraseCount;
+            }
+            errorStatus = eraseSectorBlocking(index);
+        }
+        else if(sectorsState[index] == SECTOR_FREE && sectorsEraseCount[index] == FLASH_ERASED_WORD)
+        {
+            /* power loss between the erase and its count: the erase is counted on the highest known one,
+               0 only for a new store */
+            sectorsEraseCount[index] = countsKnown ? maxEraseCount + 1 : 0;
+            errorStatus = programWord(GET_SECTOR_ADD(index) + HEADER_ERASE_COUNT_OFFSET, sectorsEraseCount[index]);
+        }
+    }
+    /* replay from the oldest sector so newer records of a key override older ones */
+    for(index = 1; index < usedCount; index++)
+    {
+        for(j = index; j > 0 && sectorsSequence[mountOrder[j - 1]] > sectorsSequence[mountOrder[j]]; j--)
+        {
+            temp = mountOrder[j];
+            mountOrder[j] = mountOrder[j - 1];
+            mountOrder[j - 1] = temp;
+        }
+    }
+    for(index = 0; index < usedCount; index++)
+    {
+        writeAddress = replaySector(mountOrder[index]);
+        activeSector = mountOrder[index];
+        lastSequence = sectorsSequence[activeSector];
+    }
+    compactionState = COMPACTION_IDLE;
+    compactionRetries = 0;
+    if(errorStatus == kv_retOk && usedCount == 0)
+    {
+        activeSector = KV_SECTORS_COUNT - 1;
+        errorStatus = openNextSector(1);
+    }
+    else if(errorStatus == kv_retOk && countFreeSectors() < RESERVED_FREE_SECTORS)
+    {
+        /* only compaction takes the reserve, power was lost before it ended: it goes on from the oldest sector */
+        compactedSector = mountOrder[0];
+        compactionKey = 0;
+        compactionState = COMPACTION_COPYING;
+    }
+    initialized = (errorStatus == kv_retOk);
+    return errorStatus;
+}
+
+KV_ErrorStatus_t kv_write(u16 key, const void* data, u16 length)
+{
+    KV_ErrorStatus_t errorStatus = kv_retNotOk;
+    if(!initialized)
+    {
+        errorStatus = kv_retNotInitialized;
+    }
+    else if(key >= KV_MAX_KEYS)
+    {
+        errorStatus = kv_retInvalidKey;
+    }
+    else if(!data)
+    {
+        errorStatus = kv_retNullPointer;
+    }
+    else if(length == 0 || length > KV_MAX_VALUE_SIZE)
+    {
+        errorStatus = kv_retInvalidLength;
+    }
+    else
+    {
+        errorStatus = appendRecord(key, data, length, 0);
+    }
+    return errorStatus;
+}
+
+KV_ErrorStatus_t kv_read(u16 key, void* buffer, u16 bufferSize, pu16 length)
+{
+    KV_ErrorStatus_t errorStatus = kv_retNotOk;
+    if(!initialized)
+    {
+        errorStatus = kv_retNotInitialized;
+    }
+    else if(key >= KV_MAX_KEYS)
+    {
+        errorStatus = kv_retInvalidKey;
+    }
+    else if(!buffer || !length)
+    {
+        errorStatus = kv_retNullPointer;
+    }
+    else if(keysIndex[key] == NO_RECORD)
+    {
+        errorStatus = kv_retKeyNotFound;
+    }
+    else
+    {
+        u32 record = keysIndex[key];
+        u16 index;
+        *length = READ_WORD(record) & MSK_RECORD_LENGTH;
+        if(*length > bufferSize)
+        {
+            errorStatus = kv_retBufferTooSmall;
+        }
+        else
+        {
+            for(index = 0; index < *length; index++)
+            {
+                ((pu8) buffer)[index] = ((const u8*) TO_POINTER(record + 4))[index];
+            }
+            errorStatus = kv_retOk;
+        }
+    }
+    return errorStatus;
+}
+
+KV_ErrorStatus_t kv_delete(u16 key)
+{
+    KV_ErrorStatus_t errorStatus = kv_retNotOk;
+    if(!initialized)
+    {
+        errorStatus = kv_retNotInitialized;
+    }
+    else if(key >= KV_MAX_KEYS)
+    {
+        errorStatus = kv_retInvalidKey;
+    }
+    else if(keysIndex[key] == NO_RECORD)
+    {
+        errorStatus = kv_retKeyNotFound;
+    }
+    else
+    {
+        errorStatus = appendRecord(key, NULL, RECORD_DELETED, 0);
+    }
+    return errorStatus;
+}
+
+KV_ErrorStatus_t kv_getEraseCount(u8 sectorIndex, pu32 eraseCount)
+{
+    KV_ErrorStatus_t errorStatus = kv_retNotOk;
+    if(!initialized)
+    {
+        errorStatus = kv_retNotInitialized;
+    }
+    else if(!eraseCount)
+    {
+        errorStatus = kv_retNullPointer;
+    }
+    else if(sectorIndex >= KV_SECTORS_COUNT)
+    {
+        errorStatus = kv_retInvalidKey;
+    }
+    else
+    {
+        *eraseCount = sectorsEraseCount[sectorIndex];
+        errorStatus = kv_retOk;
+    }
+    return errorStatus;
+}
+
+void kv_runnable(void)
+{
+    u8 copied = 0;
+    u32 sectorStart, record;
+    KV_ErrorStatus_t result;
+    if(!initialized)
+    {
+        return;
+    }
+    switch(compactionState)
+    {
+        case COMPACTION_IDLE:
+            if(countFreeSectors() <= RESERVED_FREE_SECTORS)
+            {
+                compactedSector = findCompactedSector();
+                result = kv_retOk;
+                if(compactedSector != NO_SECTOR && compactedSector == activeSector)
+                {
+                    /* the full sector is the only one used (2 sectors), the reserve is opened first to compact it */
+                    result = openNextSector(1);
+                }
+                if(result == kv_retFlashError)
+                {
+                    compactionFlashError();
+                }
+                else if(result == kv_retOk && compactedSector != NO_SECTOR)
+                {
+                    compactionKey = 0;
+                    compactionState = COMPACTION_COPYING;
+                }
+            }
+            break;
+        case COMPACTION_COPYING:
+            sectorStart = GET_SECTOR_ADD(compactedSector);
+            result = kv_retOk;
+            while(compactionKey < KV_MAX_KEYS && copied < KV_COMPACTION_RECORDS_PER_RUN && result == kv_retOk)
+            {
+                record = keysIndex[compactionKey];
+                if(record >= sectorStart && record < sectorStart + KV_SECTOR_SIZE)
+                {
+                    result = appendRecord(compactionKey, TO_POINTER(record + 4),
+                                            READ_WORD(record) & MSK_RECORD_LENGTH, 1);
+                    copied++;
+                }
+                if(result == kv_retOk)
+                {
+                    compactionKey++;
+                }
+            }
+            /* delete records aren't copied, older values of their keys are in this sector or erased */
+            if(result == kv_retOk && compactionKey == KV_MAX_KEYS)
+            {
+                result = programWord(sectorStart + HEADER_OBSOLETE_OFFSET, 0);
+                if(result == kv_retOk)
+                {
+                    sectorsState[compactedSector] = SECTOR_ERASING;
+                    eraseRequested = 0;
+                    compactionState = COMPACTION_ERASING;
+                }
+            }
+            if(result == kv_retFlashError || result == kv_retNoSpace)
+            {
+                /* the record or the marker is programmed again next run, a torn record is skipped at mount */
+                compactionFlashError();
+            }
+            break;
+        case COMPACTION_ERASING:
+            if(!eraseRequested)
+            {
+                eraseDone = 0;
+                /* the jobs queue may be full, it's requested again next run */
+                eraseRequested = (flash_eraseSectorAsync(KV_FIRST_SECTOR + compactedSector, eraseDoneCallback) == flash_retOk);
+            }
+            else if(eraseDone && eraseStatus != flash_retOk)
+            {
+                /* erased again next run */
+                eraseRequested = 0;
+                compactionFlashError();
+            }
+            else if(eraseDone)
+            {
+                /* the count is kept in RAM until it's programmed, a failed program is done again next run */
+                result = programWord(GET_SECTOR_ADD(compactedSector) + HEADER_ERASE_COUNT_OFFSET,
+                                        sectorsEraseCount[compactedSector] + 1);
+                if(result == kv_retOk)
+                {
+                    sectorsEraseCount[compactedSector]++;
+                    sectorsSequence[compactedSector] = FLASH_ERASED_WORD;
+                    sectorsState[compactedSector] = SECTOR_FREE;
+                    compactionRetries = 0;
+                    compactionState = COMPACTION_IDLE;
+                }
+                else if(result == kv_retFlashError)
+                {
+                    compactionFlashError();
+                }
+            }
+            break;
+        default:
+            /* COMPACTION_FAILED, writes return kv_retFlashError until kv_init */
+            break;
+    }
+}
+
+static KV_ErrorStatus_t programWord(u32 address, u32 value)
+{
+    KV_ErrorStatus_t errorStatus = kv_retFlashError;
+    FLASH_ErrorStatus_t flashStatus = flash_writeBuffer(TO_POINTER(address), &value, sizeof(value));
+    if(flashStatus == flash_retOk)
+    {
+        errorStatus = kv_retOk;
+    }
+    else if(flashStatus == flash_retBusy)
+    {
+        errorStatus = kv_retBusy;
+    }
+    return errorStatus;
+}
+
+static KV_ErrorStatus_t eraseSectorBlocking(u8 sectorIndex)
+{
+    KV_ErrorStatus_t errorStatus = kv_retFlashError;
+    if(flash_eraseSector(KV_FIRST_SECTOR + sectorIndex) == flash_retOk)
+    {
+        sectorsEraseCount[sectorIndex]++;
+        sectorsSequence[sectorIndex] = FLASH_ERASED_WORD;
+        sectorsState[sectorIndex] = SECTOR_FREE;
+        errorStatus = programWord(GET_SECTOR_ADD(sectorIndex) + HEADER_ERASE_COUNT_OFFSET,
+                                    sectorsEraseCount[sectorIndex]);
+    }
+    return errorStatus;
+}
+
+/* the erase count word may be programmed, all the rest must be erased */
+static u8 isSectorBlank(u8 sectorIndex)
+{
+    u32 address = GET_SECTOR_ADD(sectorIndex) + HEADER_SEQUENCE_OFFSET;
+    u32 end = GET_SECTOR_ADD(sectorIndex) + KV_SECTOR_SIZE;
+    while(address < end && READ_WORD(address) == FLASH_ERASED_WORD)
+    {
+        address += 4;
+    }
+    return (address == end);
+}
+
+/* indexes valid records of a sector and returns where the next record can be appended */
+static u32 replaySector(u8 sectorIndex)
+{
+    u32 address = GET_SECTOR_ADD(sectorIndex) + SECTOR_HEADER_SIZE;
+    u32 end = GET_SECTOR_ADD(sectorIndex) + KV_SECTOR_SIZE;
+    u32 header, size;
+    u16 key, length;
+    while(address < end && (header = READ_WORD(address)) != FLASH_ERASED_WORD)
+    {
+        key = header >> RECORD_KEY_SHIFT;
+        length = header & MSK_RECORD_LENGTH;
+        size = GET_RECORD_SIZE(length);
+        if(key >= KV_MAX_KEYS || length > KV_MAX_VALUE_SIZE || size > end - address)
+        {
+            /* header torn by a power loss, nothing was programmed after it, appends go on after the word */
+            address += 4;
+        }
+        else
+        {
+            /* a record without marker was torn by a power loss, its space is skipped */
+            if(READ_WORD(address + size - 4) == calculateChecksum(header, (const u8*) TO_POINTER(address + 4), length))
+            {
+                keysIndex[key] = (header & RECORD_DELETED) ? NO_RECORD : address;
+            }
+            address += size;
+        }
+    }
+    return address;
+}
+
+static u32 calculateChecksum(u32 header, const u8* data, u16 length)
+{
+    u32 checksum = FNV_OFFSET_BASIS;
+    u16 index;
+    for(index = 0; index < 4; index++)
+    {
+        checksum = (checksum ^ ((header >> (index * 8)) & 0xFF)) * FNV_PRIME;
+    }
+    for(index = 0; index < length; index++)
+    {
+        checksum = (checksum ^ data[index]) * FNV_PRIME;
+    }
+    return checksum;
+}
+
+static u8 countFreeSectors(void)
+{
+    u8 index, count = 0;
+    for(index = 0; index < KV_SECTORS_COUNT; index++)
+    {
+        if(sectorsState[index] == SECTOR_FREE)
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+/* bytes of the live records of a sector */
+static u32 countLiveBytes(u8 sectorIndex)
+{
+    u32 sectorStart = GET_SECTOR_ADD(sectorIndex);
+    u32 liveBytes = 0;
+    u16 key;
+    for(key = 0; key < KV_MAX_KEYS; key++)
+    {
+        if(keysIndex[key] >= sectorStart && keysIndex[key] < sectorStart + KV_SECTOR_SIZE)
+        {
+            liveBytes += GET_RECORD_SIZE(READ_WORD(keysIndex[key]) & MSK_RECORD_LENGTH);
+        }
+    }
+    return liveBytes;
+}
+
+/*
+    oldest used sector other than the active one, with 2 sectors there is none and the active one is
+    compacted when it can't take a record of KV_MAX_VALUE_SIZE and its live records leave room for one
+*/
+static u8 findCompactedSector(void)
+{
+    u8 compacted = NO_SECTOR;
+    u32 oldestSequence = FLASH_ERASED_WORD;
+    u32 maxRecordSize = GET_RECORD_SIZE(KV_MAX_VALUE_SIZE);
+    u8 index;
+    for(index = 0; index < KV_SECTORS_COUNT; index++)
+    {
+        if(sectorsState[index] == SECTOR_USED && index != activeSector && sectorsSequence[index] < oldestSequence)
+        {
+            oldestSequence = sectorsSequence[index];
+            compacted = index;
+        }
+    }
+    if(compacted == NO_SECTOR && sectorsState[activeSector] == SECTOR_USED
+        && writeAddress + maxRecordSize > GET_SECTOR_ADD(activeSector) + KV_SECTOR_SIZE
+        && SECTOR_HEADER_SIZE + countLiveBytes(activeSector) + maxRecordSize <= KV_SECTOR_SIZE)
+    {
+        compacted = activeSector;
+    }
+    return compacted;
+}
+
+/* a flash error of a compaction step, the step is done again next run up to COMPACTION_MAX_RETRIES errors */
+static void compactionFlashError(void)
+{
+    compactionRetries++;
+    if(compactionRetries >= COMPACTION_MAX_RETRIES)
+    {
+        compactionState = COMPACTION_FAILED;
+    }
+}
+
+/* free sectors are taken in ring order after the active one so erases are spread on all sectors */
+static KV_ErrorStatus_t openNextSector(u8 useReserve)
+{
+    KV_ErrorStatus_t errorStatus = kv_retNotOk;
+    u8 freeCount = countFreeSectors();
+    u8 next = activeSector;
+    u8 index;
+    if(!useReserve && freeCount <= RESERVED_FREE_SECTORS)
+    {
+        /* the reserve is for compaction, space comes back when it ends if a sector can be compacted */
+        errorStatus = (compactionState != COMPACTION_IDLE || findCompactedSector() != NO_SECTOR) ? kv_retBusy : kv_retNoSpace;
+    }
+    else if(freeCount == 0)
+    {
+        errorStatus = kv_retNoSpace;
+    }
+    else
+    {
+        for(index = 0; index < KV_SECTORS_COUNT && next == activeSector; index++)
+        {
+            u8 candidate = (activeSector + 1 + index) % KV_SECTORS_COUNT;
+            if(sectorsState[candidate] == SECTOR_FREE)
+            {
+                next = candidate;
+            }
+        }
+        errorStatus = programWord(GET_SECTOR_ADD(next) + HEADER_SEQUENCE_OFFSET, lastSequence + 1);
+        if(errorStatus == kv_retOk)
+        {
+            errorStatus = programWord(GET_SECTOR_ADD(next) + HEADER_MAGIC_OFFSET, SECTOR_MAGIC);
+        }
+        if(errorStatus == kv_retOk)
+        {
+            lastSequence++;
+            sectorsSequence[next] = lastSequence;
+            sectorsState[next] = SECTOR_USED;
+            activeSector = next;
+            writeAddress = GET_SECTOR_ADD(next) + SECTOR_HEADER_SIZE;
+        }
+    }
+    return errorStatus;
+}
+
+static KV_ErrorStatus_t appendRecord(u16 key, const void* data, u16 lengthField, u8 useReserve)
+{
+    KV_ErrorStatus_t errorStatus = kv_retOk;
+    u16 length = lengthField & MSK_RECORD_LENGTH;
+    u32 size = GET_RECORD_SIZE(length);
+    u32 record;
+    if(compactionState == COMPACTION_FAILED)
+    {
+        errorStatus = kv_retFlashError;
+    }
+    else if(compactionState == COMPACTION_ERASING || (compactionState == COMPACTION_COPYING && !useReserve))
+    {
+        /* the flash can't be programmed while it erases, while copying the space is kept for the live records */
+        errorStatus = kv_retBusy;
+    }
+    else if(writeAddress + size > GET_SECTOR_ADD(activeSector) + KV_SECTOR_SIZE)
+    {
+        errorStatus = openNextSector(useReserve);
+    }
+    if(errorStatus == kv_retOk)
+    {
+        record = writeAddress;
+        /* the space is taken even if programming fails, a torn record is skipped at mount */
+        writeAddress += size;
+        errorStatus = programWord(record, ((u32) key << RECORD_KEY_SHIFT) | lengthField);
+        if(errorStatus == kv_retOk && length)
+        {
+            if(flash_writeBuffer(TO_POINTER(record + 4), data, length) != flash_retOk)
+            {
+                errorStatus = kv_retFlashError;
+            }
+        }
+        if(errorStatus == kv_retOk)
+        {
+            errorStatus = programWord(record + size - 4,
+                                        calculateChecksum(((u32) key << RECORD_KEY_SHIFT) | lengthField, data, length));
+        }
+        if(errorStatus == kv_retOk)
+        {
+            keysIndex[key] = (lengthField & RECORD_DELETED) ? NO_RECORD : record;
+        }
+    }
+    return errorStatus;
+}
+
+static void eraseDoneCallback(FLASH_ErrorStatus_t status)
+{
+    eraseStatus = status;
+    eraseDone = 1;
+}
@@ -0,0 +1,119 @@
+/*******************************************************************
+*   File name:    KV_Store.h
+*   Author:       Ibrahim Saad
+*   Description:  This file contains all APIs of the key/value store module which emulates
+*                 an EEPROM by a log of records appended to flash sectors 1:3
+*   Version: v1.0
+*******************************************************************/
+
+#ifndef KV_STORE_H
+#define KV_STORE_H
+
+#include "../../LIB/Std_types.h"
+#include "../../MCAL/FlashDriver/FLASH.h"
+
+#define KV_FIRST_SECTOR                 sectorNo_1
+#define KV_FIRST_SECTOR_ADD             0x08004000
+#define KV_SECTOR_SIZE                  0x4000      /* 16KB */
+#ifndef KV_SECTORS_COUNT
+#define KV_SECTORS_COUNT                3           /* 2 at least, the application must not be linked there */
+#endif
+
+#define KV_MAX_KEYS                     64          /* keys are 0 : KV_MAX_KEYS - 1 */
+#define KV_MAX_VALUE_SIZE               128         /* bytes */
+#define KV_COMPACTION_RECORDS_PER_RUN   4           /* records moved by one call of kv_runnable */
+
+typedef enum
+{
+    kv_retNotOk = 0,
+    kv_retOk,
+    kv_retNullPointer,
+    kv_retNotInitialized,
+    kv_retInvalidKey,
+    kv_retInvalidLength,
+    kv_retKeyNotFound,
+    kv_retBufferTooSmall,
+    kv_retBusy,
+    kv_retNoSpace,
+    kv_retFlashError,
+}KV_ErrorStatus_t;
+
+/**********************************************************
+    Description:       This function is used to mount the store, it unlocks the flash, erases sectors
+                       left half written by a power loss and builds the RAM index of all keys
+                       from the records (newest record of a key wins)
+
+    Return:            Returns KV_ErrorStatus_t
+                       - kv_retFlashError (if a sector couldn't be erased or prepared)
+                       - kv_retOk (if the store is mounted)
+***********************************************************/
+KV_ErrorStatus_t kv_init(void);
+
+
+
+
+/**********************************************************
+    Description:       This function is used to append a new value of a key, the record is valid
+                       only after its marker is programmed (last), so a power loss keeps the old value
+
+    Input parameters:  key from 0 to KV_MAX_KEYS - 1
+                       Pointer to data (Not NULL) and its length (1 : KV_MAX_VALUE_SIZE)
+
+    Return:            Returns KV_ErrorStatus_t
+                       - kv_retBusy (if kv_runnable is compacting a sector or space waits compaction)
+                       - kv_retNoSpace (if all sectors are full of live records)
+                       - kv_retFlashError (if programming failed, or compaction failed until kv_init)
+                       - kv_retOk (if the value is stored)
+***********************************************************/
+KV_ErrorStatus_t kv_write(u16 key, const void* data, u16 length);
+
+
+
+
+/**********************************************************
+    Description:       This function is used to copy the value of a key (O(1) lookup in RAM index)
+
+    Input parameters:  key, buffer (Not NULL) of bufferSize bytes
+                       A valid pointer (Not NULL) to store the value length (even if buffer is too small)
+
+    Return:            Returns KV_ErrorStatus_t
+                       - kv_retKeyNotFound (if the key has no value)
+                       - kv_retBufferTooSmall (if the value is bigger than bufferSize)
+                       - kv_retOk (if the value is copied)
+***********************************************************/
+KV_ErrorStatus_t kv_read(u16 key, void* buffer, u16 bufferSize, pu16 length);
+
+
+
+
+/**********************************************************
+    Description:       This function is used to remove a key by appending a delete record
+***********************************************************/
+KV_ErrorStatus_t kv_delete(u16 key);
+
+
+
+
+/**********************************************************
+    Description:       This function is used to get how many times a sector of the store was erased,
+                       the counter is kept in the sector header so it survives resets
+
+    Input parameters:  sectorIndex from 0 to KV_SECTORS_COUNT - 1 (0 is KV_FIRST_SECTOR)
+***********************************************************/
+KV_ErrorStatus_t kv_getEraseCount(u8 sectorIndex, pu32 eraseCount);
+
+
+
+
+/**********************************************************
+    Description:       This runnable does the garbage collection, it should be added to scheduler
+                       tasks (10ms is fine), when only one free sector is left it moves live records
+                       of the oldest sector to the active one, some each run, then erases the oldest
+                       sector by the async flash engine (FLASH IRQ must be enabled in NVIC), with 2
+                       sectors the full active sector is moved to the free one, writes wait (kv_retBusy)
+                       from the copy to the end of the erase, a flash step failing 3
+                       times stops the store until kv_init
+***********************************************************/
+void kv_runnable(void);
+
+#endif
@@ -0,0 +1,584 @@
+/*******************************************************************
+*   File name:    uploader.c
+*   Author:       Ibrahim Saad
+*   Description:  Linux host side of the binary transfer protocol of the bootloader (BinaryLink.h),
+*                 it sends a raw image over a serial device, or over a simulated USART to the
+*                 bootloader stages built for the host with the flash simulator, and prints the
+*                 effective speed next to the one of the same image as Intel HEX, a .lzs file of
+*                 Tools/Lzss_Compress is sent compressed and decoded by the device, a .dlt file of
+*                 Tools/Delta_Diff is applied by the device to its installed image (in sim, the
+*                 base image given after the baud is installed first)
+*
+*   Build:        gcc -O2 -o uploader uploader.c ../../COTS/LIB/Soft_CRC/Soft_crc.c
+*   Build (sim):  gcc -O2 -DUPLOADER_SIM -DFLASH_HOST_SIM -o uploader uploader.c ../../COTS/LIB/Soft_CRC/Soft_crc.c
+*                     ../../COTS/Services/Bootloader/Binary_Link/BinaryLink.c
+*                     ../../COTS/Services/Bootloader/Lzss_Stream/LzssStream.c
+*                     ../../COTS/Services/Bootloader/Delta_Patch/DeltaPatch.c
+*                     ../../COTS/Services/Bootloader/Flash_Writer/FlashWriter.c
+*                     ../../COTS/MCAL/FlashDriver/FLASH.c ../../COTS/MCAL/FlashDriver/FLASH_Sim.c
+*   Usage:        ./uploader image.bin|image.lzs|patch.dlt address /dev/ttyUSB0 [baud]
+*                 ./uploader image.bin|image.lzs address sim [baud] [corrupted bytes per million]
+*                 ./uploader patch.dlt address sim baud base.bin base_address [corrupted bytes per million]
+*   Version: v1.0
+*******************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/select.h>
+#include "../../COTS/Services/Bootloader/Binary_Link/BinaryLink.h"
+#include "../../COTS/Services/Bootloader/Lzss_Stream/LzssStream.h"
+#include "../../COTS/Services/Bootloader/Delta_Patch/DeltaPatch.h"
+#include "../../COTS/LIB/Soft_CRC/Soft_crc.h"
+#ifdef UPLOADER_SIM
+#include "../../COTS/MCAL/FlashDriver/FLASH.h"
+#include "../../COTS/MCAL/FlashDriver/FLASH_Sim.h"
+#endif
+
+#define DEFAULT_BAUD            115200
+#define BITS_PER_BYTE           10              /* start, 8 data, stop */
+#define WINDOW_CHUNKS           8
+#define START_TIMEOUT_S         20.0            /* the device erases the image sectors first */
+#define ANSWER_MARGIN_S         0.05
+#define MAX_RETRIES             10
+#define HEX_RECORD_SIZE         16              /* Intel HEX compared with, as most toolchains emit it */
+#define HEX_RECORD_CHARS        (11 + 2 * HEX_RECORD_SIZE + 2)
+
+typedef struct
+{
+    void (*write)(const u8* bytes, u32 count);
+    u32 (*read)(u8* bytes, u32 maxCount, double timeout);       /* waits for at least one byte */
+    double (*now)(void);
+}transport_t;
+
+/* what is sent: the image as it is, its compressed stream or its patch */
+typedef struct
+{
+    const u8* stream;
+    u32 streamSize;
+    u32 imageSize;
+    u32 imageCrc;
+    u32 format;
+    u32 baseCrc;                                /* DELTA format only */
+}upload_t;
+
+typedef struct
+{
+    u8 type;
+    u16 sequence;
+    u16 length;
+    u8 payload [BINARY_LINK_CHUNK_SIZE];
+}frame_t;
+
+static const transport_t* transport = NULL;
+static u8 rxBytes [4096];
+static u32 rxCount = 0;
+static u32 rxPosition = 0;
+static u64 sentBytes = 0;
+static u32 resentChunks = 0;
+static double transferStart = 0;                /* after the erase */
+
+/* ----------------------------- serial device ----------------------------- */
+
+static int serialFd = -1;
+
+static double realNow(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void serialWrite(const u8* bytes, u32 count)
+{
+    while(count)
+    {
+        ssize_t written = write(serialFd, bytes, count);
+        if(written > 0)
+        {
+            bytes += written;
+            count -= (u32) written;
+        }
+    }
+}
+
+static u32 serialRead(u8* bytes, u32 maxCount, double timeout)
+{
+    fd_set readSet;
+    struct timeval wait;
+    ssize_t received = 0;
+    FD_ZERO(&readSet);
+    FD_SET(serialFd, &readSet);
+    wait.tv_sec = (long) timeout;
+    wait.tv_usec = (long) ((timeout - wait.tv_sec) * 1e6);
+    if(select(serialFd + 1, &readSet, NULL, NULL, &wait) > 0)
+    {
+        received = read(serialFd, bytes, maxCount);
+    }
+    return (received > 0) ? (u32) received : 0;
+}
+
+static speed_t baudToSpeed(u32 baud)
+{
+    switch(baud)
+    {
+        case 9600:      return B9600;
+        case 19200:     return B19200;
+        case 38400:     return B38400;
+        case 57600:     return B57600;
+        case 230400:    return B230400;
+        case 460800:    return B460800;
+        case 921600:    return B921600;
+        default:        return B115200;
+    }
+}
+
+static int serialOpen(const char* path, u32 baud)
+{
+    struct termios options;
+    serialFd = open(path, O_RDWR | O_NOCTTY);
+    if(serialFd >= 0 && tcgetattr(serialFd, &options) == 0)
+    {
+        cfmakeraw(&options);
+        cfsetspeed(&options, baudToSpeed(baud));
+        options.c_cflag |= CLOCAL | CREAD;
+        options.c_cc[VMIN] = 0;
+        options.c_cc[VTIME] = 0;
+        tcsetattr(serialFd, TCSANOW, &options);
+        tcflush(serialFd, TCIOFLUSH);
+    }
+    return serialFd >= 0;
+}
+
+static const transport_t serialTransport = {serialWrite, serialRead, realNow};
+
+/* ------------------------------ simulated USART ------------------------------ */
+
+#ifdef UPLOADER_SIM
+
+#define SIM_LINE_SIZE           (1 << 16)
+#define SIM_IMAGE_PATH          "uploader_sim.bin"
+
+/* bytes of one direction with the time their stop bit arrives, each byte takes the line for byteTime */
+typedef struct
+{
+    u8 bytes [SIM_LINE_SIZE];
+    double arrival [SIM_LINE_SIZE];
+    u32 head;
+    u32 tail;
+    double lineFree;
+}simLine_t;
+
+static simLine_t toDevice;
+static simLine_t toHost;
+static double simTime = 0;
+static double byteTime = 0;
+static u32 corruptPerMillion = 0;
+static u64 deviceBusyNs = 0;
+
+static void linePush(simLine_t* line, u8 byte)
+{
+    double start = (line->lineFree > simTime) ? line->lineFree : simTime;
+    if((u32) (rand() % 1000000) < corruptPerMillion)
+    {
+        byte ^= (u8) (1 << (rand() % 8));
+    }
+    line->lineFree = start + byteTime;
+    line->bytes[line->tail % SIM_LINE_SIZE] = byte;
+    line->arrival[line->tail % SIM_LINE_SIZE] = line->lineFree;
+    line->tail++;
+}
+
+/* answers leave the device once the flash time spent by the frames before them has passed */
+static void deviceSend(const u8* frame, u16 size)
+{
+    flashSimStats_t stats;
+    u16 i;
+    flashSim_getStats(&stats);
+    simTime += (stats.busyTimeNs - deviceBusyNs) / 1e9;
+    deviceBusyNs = stats.busyTimeNs;
+    for(i = 0; i < size; i++)
+    {
+        linePush(&toHost, frame[i]);
+    }
+}
+
+static void simWrite(const u8* bytes, u32 count)
+{
+    u32 i;
+    for(i = 0; i < count; i++)
+    {
+        linePush(&toDevice, bytes[i]);
+    }
+}
+
+static double simNow(void)
+{
+    return simTime;
+}
+
+/* runs the device until a byte reaches the host or the timeout, the simulated time jumps between arrivals */
+static u32 simRead(u8* bytes, u32 maxCount, double timeout)
+{
+    double deadline = simTime + timeout;
+    u32 count = 0;
+    while(!count && simTime <= deadline)
+    {
+        double next = deadline + 1;
+        while(toDevice.head != toDevice.tail && toDevice.arrival[toDevice.head % SIM_LINE_SIZE] <= simTime)
+        {
+            binaryLink_feed(&toDevice.bytes[toDevice.head % SIM_LINE_SIZE], 1);
+            toDevice.head++;
+        }
+        flashSim_processEvents();
+        while(count < maxCount && toHost.head != toHost.tail && toHost.arrival[toHost.head % SIM_LINE_SIZE] <= simTime)
+        {
+            bytes[count++] = toHost.bytes[toHost.head % SIM_LINE_SIZE];
+            toHost.head++;
+        }
+        if(!count)
+        {
+            if(toDevice.head != toDevice.tail && toDevice.arrival[toDevice.head % SIM_LINE_SIZE] < next)
+            {
+                next = toDevice.arrival[toDevice.head % SIM_LINE_SIZE];
+            }
+            if(toHost.head != toHost.tail && toHost.arrival[toHost.head % SIM_LINE_SIZE] < next)
+            {
+                next = toHost.arrival[toHost.head % SIM_LINE_SIZE];
+            }
+            if(next > deadline)
+            {
+                simTime = deadline;
+                break;
+            }
+            simTime = next;
+        }
+    }
+    return count;
+}
+
+static int simOpen(u32 baud, u32 imageEnd)
+{
+    int opened = 0;
+    remove(SIM_IMAGE_PATH);
+    byteTime = (double) BITS_PER_BYTE / baud;
+    if(flashSim_init(SIM_IMAGE_PATH, 0) == flashSim_retOk)
+    {
+        /* the whole flash after the first sector is the application window */
+        opened = (binaryLink_init(0x08004000, imageEnd, deviceSend) == binaryLink_retOk);
+    }
+    return opened;
+}
+
+/* programs the base image of a patch, as installed by an earlier update, and gives it to the link */
+static int simInstallBase(const char* path, u32 address)
+{
+    FILE* file = fopen(path, "rb");
+    u8* base = NULL;
+    u32 size = 0;
+    int installed = 0;
+    if(file)
+    {
+        fseek(file, 0, SEEK_END);
+        size = (u32) ftell(file);
+        fseek(file, 0, SEEK_SET);
+        base = malloc(size + 1);
+        size = (u32) fread(base, 1, size, file);
+        fclose(file);
+        installed = flash_unlock() == flash_retOk
+                    && flash_eraseRange(address, size) == flash_retOk
+                    && flash_writeBuffer((void*) (unsigned long) address, base, size) == flash_retOk
+                    && binaryLink_setBaseImage(address, size) == binaryLink_retOk;
+        free(base);
+        if(installed)
+        {
+            /* the earlier update isn't part of the time of this one */
+            flashSimStats_t stats;
+            flashSim_getStats(&stats);
+            deviceBusyNs = stats.busyTimeNs;
+        }
+    }
+    return installed;
+}
+
+static const transport_t simTransport = {simWrite, simRead, simNow};
+
+#endif  /* UPLOADER_SIM */
+
+/* ----------------------------- protocol ----------------------------- */
+
+static void writeU16(u8* bytes, u16 value)
+{
+    bytes[0] = (u8) value;
+    bytes[1] = (u8) (value >> 8);
+}
+
+static void writeU32(u8* bytes, u32 value)
+{
+    writeU16(&bytes[0], (u16) value);
+    writeU16(&bytes[2], (u16) (value >> 16));
+}
+
+static void sendFrame(u8 type, u16 sequence, const u8* payload, u16 length)
+{
+    u8 frame [BINARY_LINK_FRAME_SIZE];
+    frame[0] = BINARY_LINK_SOF;
+    frame[1] = type;
+    writeU16(&frame[2], sequence);
+    writeU16(&frame[4], length);
+    memcpy(&frame[BINARY_LINK_HEADER_SIZE], payload, length);
+    writeU32(&frame[BINARY_LINK_HEADER_SIZE + length],
+             softCrc_updateBytes(SOFT_CRC_INIT, &frame[1], BINARY_LINK_HEADER_SIZE - 1 + length));
+    transport->write(frame, BINARY_LINK_HEADER_SIZE + length + BINARY_LINK_CRC_SIZE);
+    sentBytes += BINARY_LINK_HEADER_SIZE + length + BINARY_LINK_CRC_SIZE;
+}
+
+/* next valid frame from the device, 0 on timeout, frames with a bad CRC are skipped */
+static int receiveFrame(frame_t* received, double timeout)
+{
+    double deadline = transport->now() + timeout;
+    u8 raw [BINARY_LINK_FRAME_SIZE];
+    u16 size = 0, end = 0;
+    int found = 0;
+    while(!found)
+    {
+        if(rxPosition == rxCount)
+        {
+            double left = deadline - transport->now();
+            rxPosition = 0;
+            rxCount = (left > 0) ? transport->read(rxBytes, sizeof(rxBytes), left) : 0;
+            if(!rxCount)
+            {
+                break;
+            }
+        }
+        if(!end)
+        {
+            if(rxBytes[rxPosition] == BINARY_LINK_SOF)
+            {
+                size = 0;
+                end = BINARY_LINK_HEADER_SIZE - 1;
+            }
+        }
+        else
+        {
+            raw[size++] = rxBytes[rxPosition];
+            if(size == BINARY_LINK_HEADER_SIZE - 1)
+            {
+                u16 length = (u16) (raw[3] | (raw[4] << 8));
+                end = (length <= BINARY_LINK_CHUNK_SIZE) ? size + length + BINARY_LINK_CRC_SIZE : 0;
+            }
+            else if(size == end)
+            {
+                u32 crc = raw[size - 4] | (raw[size - 3] << 8) | (raw[size - 2] << 16) | ((u32) raw[size - 1] << 24);
+                end = 0;
+                if(softCrc_updateBytes(SOFT_CRC_INIT, raw, size - BINARY_LINK_CRC_SIZE) == crc)
+                {
+                    received->type = raw[0];
+                    received->sequence = (u16) (raw[1] | (raw[2] << 8));
+                    received->length = (u16) (raw[3] | (raw[4] << 8));
+                    memcpy(received->payload, &raw[5], received->length);
+                    found = 1;
+                }
+            }
+        }
+        rxPosition++;
+    }
+    return found;
+}
+
+static int deviceError(const frame_t* answer)
+{
+    int error = (answer->type == BINARY_LINK_FRAME_ERROR);
+    if(error)
+    {
+        printf("device stopped the transfer, status %u at chunk %u\n", answer->length ? answer->payload[0] : 0, answer->sequence);
+    }
+    return error;
+}
+
+/* sends a single frame until its ACK, returns 1 on success */
+static int exchange(u8 type, const u8* payload, u16 length, u16 expectedAck, double timeout)
+{
+    frame_t answer;
+    int retries, done = 0, failed = 0;
+    for(retries = 0; retries < MAX_RETRIES && !done && !failed; retries++)
+    {
+        sendFrame(type, 0, payload, length);
+        while(!done && !failed && receiveFrame(&answer, timeout))
+        {
+            failed = deviceError(&answer);
+            done = (answer.type == BINARY_LINK_FRAME_ACK && answer.sequence == expectedAck);
+        }
+    }
+    return done;
+}
+
+static u32 readU32(const u8* bytes)
+{
+    return (u32) bytes[0] | ((u32) bytes[1] << 8) | ((u32) bytes[2] << 16) | ((u32) bytes[3] << 24);
+}
+
+static int upload(const upload_t* job, u32 address, u32 baud)
+{
+    const u8* image = job->stream;
+    u32 size = job->streamSize;
+    u16 chunksCount = (u16) ((size + BINARY_LINK_CHUNK_SIZE - 1) / BINARY_LINK_CHUNK_SIZE);
+    u16 base = 0, next = 0;
+    u8 payload [20];
+    int retries = 0, failed = 0;
+    /* time to send a window and get its answers */
+    double ackTimeout = 2.0 * WINDOW_CHUNKS * BINARY_LINK_FRAME_SIZE * BITS_PER_BYTE / baud + ANSWER_MARGIN_S;
+    frame_t answer;
+    transferStart = transport->now();
+    writeU32(&payload[0], address);
+    writeU32(&payload[4], job->imageSize);
+    writeU32(&payload[8], size);
+    writeU32(&payload[12], job->format);
+    writeU32(&payload[16], job->baseCrc);
+    if(!exchange(BINARY_LINK_FRAME_START, payload, (job->format == BINARY_LINK_FORMAT_DELTA) ? 20 : 16, 0, START_TIMEOUT_S))
+    {
+        printf("no answer to start\n");
+        return 0;
+    }
+    transferStart = transport->now();
+    while(base < chunksCount && !failed)
+    {
+        while(next < chunksCount && next < base + WINDOW_CHUNKS)
+        {
+            u32 offset = (u32) next * BINARY_LINK_CHUNK_SIZE;
+            u16 length = (size - offset < BINARY_LINK_CHUNK_SIZE) ? (u16) (size - offset) : BINARY_LINK_CHUNK_SIZE;
+            sendFrame(BINARY_LINK_FRAME_DATA, next, &image[offset], length);
+            next++;
+        }
+        if(!receiveFrame(&answer, ackTimeout))
+        {
+            /* window or its answers lost, go back to the first chunk not acknowledged */
+            failed = (++retries > MAX_RETRIES);
+            resentChunks += next - base;
+            next = base;
+        }
+        else if(deviceError(&answer))
+        {
+            failed = 1;
+        }
+        else if(answer.type == BINARY_LINK_FRAME_ACK && answer.sequence > base && answer.sequence <= chunksCount)
+        {
+            base = answer.sequence;
+            retries = 0;
+        }
+        else if(answer.type == BINARY_LINK_FRAME_NAK && answer.sequence >= base && answer.sequence < next)
+        {
+            base = answer.sequence;
+            resentChunks += next - base;
+            next = base;
+        }
+    }
+    writeU32(&payload[0], job->imageCrc);
+    return !failed && exchange(BINARY_LINK_FRAME_END, payload, 4, chunksCount, ackTimeout);
+}
+
+int main(int argc, char** argv)
+{
+    static const char* const formatNames [] = {"raw", "LZSS", "delta patch"};
+    FILE* file;
+    u8* image;
+    upload_t job = {0};
+    u32 size, address, baud;
+    double start, elapsed, transfer, hexTime;
+    int opened = 0, ok;
+    if(argc < 4)
+    {
+        printf("usage: %s image.bin|image.lzs|patch.dlt address device|sim [baud] [base.bin base_address] [corrupted bytes per million]\n", argv[0]);
+        return 1;
+    }
+    file = fopen(argv[1], "rb");
+    if(!file)
+    {
+        printf("can't read %s\n", argv[1]);
+        return 1;
+    }
+    fseek(file, 0, SEEK_END);
+    size = (u32) ftell(file);
+    fseek(file, 0, SEEK_SET);
+    image = malloc(size + 1);
+    size = (u32) fread(image, 1, size, file);
+    fclose(file);
+    if(size >= LZSS_FILE_HEADER_SIZE && readU32(image) == LZSS_FILE_MAGIC)
+    {
+        job.format = BINARY_LINK_FORMAT_LZSS;
+        job.imageSize = readU32(&image[4]);
+        job.imageCrc = readU32(&image[8]);
+        job.stream = &image[LZSS_FILE_HEADER_SIZE];
+        job.streamSize = size - LZSS_FILE_HEADER_SIZE;
+    }
+    else if(size >= DELTA_FILE_HEADER_SIZE && readU32(image) == DELTA_FILE_MAGIC)
+    {
+        job.format = BINARY_LINK_FORMAT_DELTA;
+        job.imageSize = readU32(&image[4]);
+        job.imageCrc = readU32(&image[8]);
+        job.baseCrc = readU32(&image[16]);
+        job.stream = &image[DELTA_FILE_HEADER_SIZE];
+        job.streamSize = size - DELTA_FILE_HEADER_SIZE;
+    }
+    else
+    {
+        job.format = BINARY_LINK_FORMAT_RAW;
+        job.imageSize = size;
+        job.imageCrc = softCrc_updateBytes(SOFT_CRC_INIT, image, size);
+        job.stream = image;
+        job.streamSize = size;
+    }
+    size = job.imageSize;
+    address = (u32) strtoul(argv[2], NULL, 0);
+    baud = (argc > 4) ? (u32) strtoul(argv[4], NULL, 0) : DEFAULT_BAUD;
+    if(strcmp(argv[3], "sim") == 0)
+    {
+#ifdef UPLOADER_SIM
+        /* corrupted bytes per million come after the base image of a delta patch */
+        int errorArgument = (job.format == BINARY_LINK_FORMAT_DELTA) ? 7 : 5;
+        srand(1);
+        opened = simOpen(baud, 0x08000000 + FLASH_SIZE);
+        if(opened && job.format == BINARY_LINK_FORMAT_DELTA)
+        {
+            opened = (argc > 6) && simInstallBase(argv[5], (u32) strtoul(argv[6], NULL, 0));
+        }
+        corruptPerMillion = (argc > errorArgument) ? (u32) strtoul(argv[errorArgument], NULL, 0) : 0;
+        transport = &simTransport;
+#else
+        printf("built without UPLOADER_SIM\n");
+#endif
+    }
+    else
+    {
+        opened = serialOpen(argv[3], baud);
+        transport = &serialTransport;
+    }
+    if(!opened)
+    {
+        printf("can't open %s\n", argv[3]);
+        return 1;
+    }
+    start = transport->now();
+    ok = upload(&job, address, baud);
+    elapsed = transport->now() - start;
+    transfer = transport->now() - transferStart;
+    /* ASCII hex is sent without answers, its time is the one of its characters on the line */
+    hexTime = (double) ((size + HEX_RECORD_SIZE - 1) / HEX_RECORD_SIZE * HEX_RECORD_CHARS + (size / 0x10000 + 2) * 17)
+              * BITS_PER_BYTE / baud;
+    printf("%s: %u bytes (%u sent as %s) in %.2f s, erase %.2f s, transfer %.2f s (%.1f KB/s of image)\n",
+           ok ? "done" : "failed", size, job.streamSize, formatNames[job.format],
+           elapsed, elapsed - transfer, transfer, size / transfer / 1024);
+    printf("%llu bytes on the line, %u chunks resent\n", (unsigned long long) sentBytes, resentChunks);
+    if(ok)
+    {
+        printf("same image as Intel HEX (%d-byte records): %.2f s on the line, binary transfer is %.2fx faster\n",
+               HEX_RECORD_SIZE, hexTime, hexTime / transfer);
+    }
+    free(image);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,92 @@
+/*******************************************************************
+*   File name:    crc_bench.c
+*   Author:       Ibrahim Saad
+*   Description:  Host benchmark of the software CRC (COTS/LIB/Soft_CRC), it checks the fast
+*                 paths against a bit by bit CRC then prints the throughput of a 256KB image
+*                 and of a big buffer
+*
+*   Build:        gcc -O2 -o crc_bench crc_bench.c ../../COTS/LIB/Soft_CRC/Soft_crc.c
+*                 gcc -O2 -mpclmul -o crc_bench crc_bench.c ../../COTS/LIB/Soft_CRC/Soft_crc.c
+*   Usage:        ./crc_bench [buffer size in MB]
+*   Version: v1.0
+*******************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../../COTS/LIB/Soft_CRC/Soft_crc.h"
+
+#define IMAGE_SIZE          (256 * 1024)
+#define DEFAULT_BIG_SIZE_MB 64
+#define MIN_RUN_TIME_S      0.5
+
+static u32 bitwiseCrc(u32 crc, const u32* words, u32 wordsCount)
+{
+    u32 i, bit;
+    for(i = 0; i < wordsCount; i++)
+    {
+        crc ^= words[i];
+        for(bit = 0; bit < 32; bit++)
+        {
+            crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04C11DB7 : (crc << 1);
+        }
+    }
+    return crc;
+}
+
+static double nowSeconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/* GB/s of softCrc_updateWords over size bytes, repeated for at least MIN_RUN_TIME_S */
+static double measure(const u32* buffer, u32 size, u32* crc)
+{
+    double start = nowSeconds();
+    double elapsed = 0;
+    u64 bytes = 0;
+    while(elapsed < MIN_RUN_TIME_S)
+    {
+        *crc = softCrc_updateWords(SOFT_CRC_INIT, buffer, size / 4);
+        bytes += size;
+        elapsed = nowSeconds() - start;
+    }
+    return bytes / elapsed / 1e9;
+}
+
+int main(int argc, char** argv)
+{
+    u32 bigSize = ((argc > 1) ? (u32) atoi(argv[1]) : DEFAULT_BIG_SIZE_MB) * 1024 * 1024;
+    u32* buffer = malloc(bigSize);
+    u32 i, crc, failures = 0;
+    u32 check = 0x12345678;
+    if(!buffer || bigSize < IMAGE_SIZE)
+    {
+        printf("buffer size must be 1MB at least\n");
+        return 1;
+    }
+    srand(1);
+    for(i = 0; i < bigSize / 4; i++)
+    {
+        buffer[i] = ((u32) rand() << 16) ^ (u32) rand();
+    }
+    /* CRC unit of STM32 gives 0xDF8A8A2B for 0x12345678 after reset */
+    if(softCrc_updateWords(SOFT_CRC_INIT, &check, 1) != 0xDF8A8A2B)
+    {
+        failures++;
+    }
+    for(i = 0; i < 1024; i += (i < 64) ? 1 : 61)
+    {
+        if(softCrc_updateWords(SOFT_CRC_INIT, buffer + 3, i) != bitwiseCrc(SOFT_CRC_INIT, buffer + 3, i))
+        {
+            failures++;
+        }
+    }
+    printf("check: %s\n", failures ? "FAILED" : "ok");
+    printf("256KB image: %.2f GB/s\n", measure(buffer, IMAGE_SIZE, &crc));
+    printf("%uMB buffer: %.2f GB/s (crc 0x%08X)\n", bigSize >> 20, measure(buffer, bigSize, &crc), crc);
+    free(buffer);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,262 @@
+/*******************************************************************
+*   File name:    delta_diff.c
+*   Author:       Ibrahim Saad
+*   Description:  Host generator of delta patches for the bootloader (DeltaPatch.h), it finds the
+*                 new image in the old one by exact matches of 8 bytes extended with mismatches
+*                 (bsdiff like, ADD of the differences) and INSERTs what isn't found, then applies
+*                 the patch by DeltaPatch.c in pieces of 256 bytes and checks it gives the new image
+*
+*   Build:        gcc -O2 -o delta_diff delta_diff.c ../../COTS/Services/Bootloader/Delta_Patch/DeltaPatch.c
+*                     ../../COTS/LIB/Soft_CRC/Soft_crc.c
+*   Usage:        ./delta_diff old.bin new.bin patch.dlt
+*   Version: v1.0
+*******************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "../../COTS/Services/Bootloader/Delta_Patch/DeltaPatch.h"
+#include "../../COTS/LIB/Soft_CRC/Soft_crc.h"
+
+#define MIN_MATCH               8               /* bytes of an exact match to start a region */
+#define HASH_BITS               18
+#define HASH_SIZE               (1 << HASH_BITS)
+#define NO_POSITION             0xFFFFFFFF
+#define MAX_CHAIN               64
+#define MAX_EXTEND_GAP          256             /* extension stops this far after its best length */
+#define MIN_COPY_RUN            8               /* equal bytes in a region worth a COPY rather than ADD */
+#define CHECK_PIECE_SIZE        256
+
+static u32 head [HASH_SIZE];
+static u32* previous = NULL;
+static u8* patch = NULL;
+static u32 patchSize = 0;
+static u32 operationsCount [4];
+static const u8* checkImage = NULL;
+static u32 checkPosition = 0;
+
+static u32 hash8(const u8* bytes)
+{
+    u64 value;
+    memcpy(&value, bytes, sizeof(value));
+    return (u32) ((value * 0x9E3779B97F4A7C15ull) >> (64 - HASH_BITS));
+}
+
+static void putVarint(u32 value)
+{
+    while(value >= 0x80)
+    {
+        patch[patchSize++] = (u8) (value | 0x80);
+        value >>= 7;
+    }
+    patch[patchSize++] = (u8) value;
+}
+
+static void putOperation(u8 operation, u32 argument, const u8* bytes)
+{
+    patch[patchSize++] = operation;
+    putVarint(argument);
+    if(bytes)
+    {
+        memcpy(&patch[patchSize], bytes, argument);
+        patchSize += argument;
+    }
+    operationsCount[operation]++;
+}
+
+/* longest exact match of newImage[position..] in the old image, 0 if shorter than MIN_MATCH */
+static u32 findMatch(const u8* oldImage, u32 oldSize, const u8* newImage, u32 newSize, u32 position, pu32 matchLength)
+{
+    u32 candidate = head[hash8(&newImage[position])], chain = 0, best = NO_POSITION;
+    *matchLength = 0;
+    while(candidate != NO_POSITION && chain < MAX_CHAIN)
+    {
+        u32 length = 0;
+        while(candidate + length < oldSize && position + length < newSize && oldImage[candidate + length] == newImage[position + length])
+        {
+            length++;
+        }
+        if(length >= MIN_MATCH && length > *matchLength)
+        {
+            *matchLength = length;
+            best = candidate;
+        }
+        candidate = previous[candidate];
+        chain++;
+    }
+    return best;
+}
+
+/* bsdiff forward extension: the region keeps more than half of its bytes equal */
+static u32 extendRegion(const u8* oldImage, u32 oldSize, const u8* newImage, u32 newSize, u32 oldPosition, u32 position)
+{
+    int equal = 0, bestScore = 0;
+    u32 i, bestLength = 0;
+    for(i = 0; oldPosition + i < oldSize && position + i < newSize && i - bestLength < MAX_EXTEND_GAP; i++)
+    {
+        equal += (oldImage[oldPosition + i] == newImage[position + i]);
+        if(2 * equal - (int) (i + 1) > bestScore)
+        {
+            bestScore = 2 * equal - (int) (i + 1);
+            bestLength = i + 1;
+        }
+    }
+    return bestLength;
+}
+
+/* a region is COPY for runs of equal bytes and ADD of the differences between them */
+static void putRegion(const u8* oldImage, const u8* newImage, u32 oldPosition, u32 position, u32 length)
+{
+    u8* differences = malloc(length);
+    u32 i = 0, addStart = 0;
+    for(i = 0; i < length; i++)
+    {
+        differences[i] = (u8) (newImage[position + i] - oldImage[oldPosition + i]);
+    }
+    i = 0;
+    while(i < length)
+    {
+        u32 run = 0;
+        while(i + run < length && !differences[i + run])
+        {
+            run++;
+        }
+        if(run >= MIN_COPY_RUN || (run && i + run == length && i == addStart))
+        {
+            if(i > addStart)
+            {
+                putOperation(DELTA_OP_ADD, i - addStart, &differences[addStart]);
+            }
+            putOperation(DELTA_OP_COPY, run, NULL);
+            addStart = i + run;
+        }
+        i += run ? run : 1;
+    }
+    if(length > addStart)
+    {
+        putOperation(DELTA_OP_ADD, length - addStart, &differences[addStart]);
+    }
+    free(differences);
+}
+
+static void makePatch(const u8* oldImage, u32 oldSize, const u8* newImage, u32 newSize)
+{
+    u32 position = 0, insertStart = 0, oldPosition = 0, i;
+    memset(head, 0xFF, sizeof(head));
+    for(i = 0; i + MIN_MATCH <= oldSize; i++)
+    {
+        u32 key = hash8(&oldImage[i]);
+        previous[i] = head[key];
+        head[key] = i;
+    }
+    while(position + MIN_MATCH <= newSize)
+    {
+        u32 matchLength, match = findMatch(oldImage, oldSize, newImage, newSize, position, &matchLength);
+        if(match == NO_POSITION)
+        {
+            position++;
+        }
+        else
+        {
+            u32 length = extendRegion(oldImage, oldSize, newImage, newSize, match, position);
+            if(length < matchLength)
+            {
+                length = matchLength;
+            }
+            if(position > insertStart)
+            {
+                putOperation(DELTA_OP_INSERT, position - insertStart, &newImage[insertStart]);
+            }
+            if(match != oldPosition)
+            {
+                putOperation(DELTA_OP_SEEK, (match > oldPosition) ? 2 * (match - oldPosition) : 2 * (oldPosition - match) - 1, NULL);
+            }
+            putRegion(oldImage, newImage, match, position, length);
+            oldPosition = match + length;
+            position += length;
+            insertStart = position;
+        }
+    }
+    if(newSize > insertStart)
+    {
+        putOperation(DELTA_OP_INSERT, newSize - insertStart, &newImage[insertStart]);
+    }
+}
+
+static u8* readFile(const char* path, pu32 size)
+{
+    FILE* file = fopen(path, "rb");
+    u8* data = NULL;
+    if(file)
+    {
+        fseek(file, 0, SEEK_END);
+        *size = (u32) ftell(file);
+        fseek(file, 0, SEEK_SET);
+        /* below 4GB, DeltaPatch.c takes the old image by a 32-bit address */
+        data = mmap(NULL, *size + 1, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+        if(data == MAP_FAILED || fread(data, 1, *size, file) != *size)
+        {
+            data = NULL;
+        }
+        fclose(file);
+    }
+    return data;
+}
+
+static u8 checkSink(const u8* data, u32 length)
+{
+    u8 same = (memcmp(data, &checkImage[checkPosition], length) == 0);
+    checkPosition += length;
+    return same;
+}
+
+int main(int argc, char** argv)
+{
+    u32 oldSize = 0, newSize = 0, i;
+    u8* oldImage = (argc > 3) ? readFile(argv[1], &oldSize) : NULL;
+    u8* newImage = (argc > 3) ? readFile(argv[2], &newSize) : NULL;
+    u32 header [DELTA_FILE_HEADER_SIZE / 4];
+    DeltaPatch_ErrorStatus_t status = deltaPatch_retBusy;
+    FILE* file;
+    if(!oldImage || !newImage)
+    {
+        printf("usage: %s old.bin new.bin patch.dlt\n", argv[0]);
+        return 1;
+    }
+    previous = malloc(sizeof(u32) * (oldSize + 1));
+    /* worst case: short ADD and COPY operations one after the other */
+    patch = malloc(2 * newSize + 64);
+    makePatch(oldImage, oldSize, newImage, newSize);
+
+    checkImage = newImage;
+    deltaPatch_begin((u32) (unsigned long) oldImage, oldSize, newSize, checkSink);
+    for(i = 0; i < patchSize && (status == deltaPatch_retBusy || status == deltaPatch_retDone); i += CHECK_PIECE_SIZE)
+    {
+        status = deltaPatch_feed(&patch[i], (patchSize - i < CHECK_PIECE_SIZE) ? patchSize - i : CHECK_PIECE_SIZE);
+    }
+    if(status != deltaPatch_retDone || checkPosition != newSize)
+    {
+        printf("applied patch doesn't give the new image (status %d)\n", status);
+        return 1;
+    }
+
+    /* the header is little endian as the host */
+    header[0] = DELTA_FILE_MAGIC;
+    header[1] = newSize;
+    header[2] = softCrc_updateBytes(SOFT_CRC_INIT, newImage, newSize);
+    header[3] = oldSize;
+    header[4] = softCrc_updateBytes(SOFT_CRC_INIT, oldImage, oldSize);
+    file = fopen(argv[3], "wb");
+    if(!file || fwrite(header, 1, sizeof(header), file) != sizeof(header) || fwrite(patch, 1, patchSize, file) != patchSize)
+    {
+        printf("can't write %s\n", argv[3]);
+        return 1;
+    }
+    fclose(file);
+    printf("%u -> %u bytes: patch %u bytes (%.1f%% of the new image)\n", oldSize, newSize, patchSize, 100.0 * patchSize / newSize);
+    printf("operations: %u COPY, %u ADD, %u INSERT, %u SEEK\n", operationsCount[DELTA_OP_COPY], operationsCount[DELTA_OP_ADD],
+           operationsCount[DELTA_OP_INSERT], operationsCount[DELTA_OP_SEEK]);
+    return 0;
+}
@@ -0,0 +1,141 @@
+/*******************************************************************
+*   File name:    flash_bench.c
+*   Author:       Ibrahim Saad
+*   Description:  Host benchmark of the blocking programming paths of the flash driver on the
+*                 flash simulator, it programs BENCH_SIZE bytes by flash_writeData (one call a
+*                 word) and by flash_writeBuffer (aligned and unaligned) and prints:
+*                   - program operations and their simulated time (datasheet typical 16us each),
+*                     the KB/s the flash allows
+*                   - the driver time an operation with instant programming (host CPU, not MCU
+*                     cycles), real time programs aren't used: spinning 16us on a loaded host or
+*                     a VM takes much longer
+*                 build it once per FLASH_WRITE_CHUNK_SIZE to compare chunk sizes
+*
+*   Build:        gcc -O2 -DFLASH_HOST_SIM [-DFLASH_WRITE_CHUNK_SIZE=256] -o flash_bench flash_bench.c
+*                     ../../COTS/MCAL/FlashDriver/FLASH.c ../../COTS/MCAL/FlashDriver/FLASH_Sim.c
+*   Usage:        ./flash_bench [bytes]
+*   Version: v1.0
+*******************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../../COTS/LIB/Address.h"
+#include "../../COTS/MCAL/FlashDriver/FLASH.h"
+#include "../../COTS/MCAL/FlashDriver/FLASH_Sim.h"
+
+#define IMAGE_PATH              "flash_bench.bin"
+#define BENCH_ADDRESS           0x08020000      /* sector 5, 128KB */
+#define BENCH_SIZE              (64 * 1024)
+#define MAX_BENCH_SIZE          (128 * 1024)
+#define BENCH_RUNS              50              /* runs averaged with instant programming */
+
+#define PATH_WRITE_DATA         0
+#define PATH_BUFFER_ALIGNED     1
+#define PATH_BUFFER_UNALIGNED   2
+
+static u8 source [MAX_BENCH_SIZE + 4];
+
+static double nowSeconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/* erased image (new file), operations take no time, their simulated time is in the statistics */
+static int mount(void)
+{
+    flashSim_deinit();
+    remove(IMAGE_PATH);
+    return flashSim_init(IMAGE_PATH, 0) == flashSim_retOk && flash_unlock() == flash_retOk;
+}
+
+static FLASH_ErrorStatus_t program(u8 path, u32 length)
+{
+    FLASH_ErrorStatus_t errorStatus = flash_retOk;
+    u32 i;
+    if(path == PATH_WRITE_DATA)
+    {
+        /* the path before flash_writeBuffer: PG set once, BSY and all error flags checked each word */
+        errorStatus = flash_setPsize(pszie_x32);
+        if(errorStatus == flash_retOk)
+        {
+            errorStatus = flash_startProgramming();
+        }
+        for(i = 0; i < length && errorStatus == flash_retOk; i += 4)
+        {
+            u32 word = (u32) source[i] | ((u32) source[i + 1] << 8) | ((u32) source[i + 2] << 16) | ((u32) source[i + 3] << 24);
+            errorStatus = flash_writeData(word, (pu32) TO_POINTER(BENCH_ADDRESS + i));
+        }
+        if(errorStatus == flash_retOk)
+        {
+            errorStatus = flash_stopProgramming();
+        }
+    }
+    else if(path == PATH_BUFFER_ALIGNED)
+    {
+        errorStatus = flash_writeBuffer(TO_POINTER(BENCH_ADDRESS), source, length);
+    }
+    else
+    {
+        /* head and tail programmed by bytes, source not aligned either */
+        errorStatus = flash_writeBuffer(TO_POINTER(BENCH_ADDRESS + 1), &source[1], length - 2);
+    }
+    return errorStatus;
+}
+
+static int runPath(u8 path, const char* name, u32 length)
+{
+    flashSimStats_t stats = {0};
+    double start, driverTime = 0;
+    u32 run;
+    u32 offset = (path == PATH_BUFFER_UNALIGNED) ? 1 : 0;
+    u32 bytes = (path == PATH_BUFFER_UNALIGNED) ? length - 2 : length;
+    int failed = 0;
+    for(run = 0; run < BENCH_RUNS && !failed; run++)
+    {
+        failed |= !mount();
+        start = nowSeconds();
+        failed |= (program(path, length) != flash_retOk);
+        driverTime += nowSeconds() - start;
+        /* the flash must read back as the source */
+        failed |= (memcmp(TO_POINTER(BENCH_ADDRESS + offset), &source[offset], bytes) != 0);
+        failed |= (flashSim_getStats(&stats) != flashSim_retOk);
+    }
+    if(failed || !stats.programOperations)
+    {
+        printf("%-26s FAILED\n", name);
+    }
+    else
+    {
+        printf("%-26s %6u ops  flash %6.1f ms  %6.1f KB/s  driver %6.1f ns/op\n", name,
+               stats.programOperations, stats.busyTimeNs / 1e6, length / 1024.0 / (stats.busyTimeNs / 1e9),
+               driverTime * 1e9 / BENCH_RUNS / stats.programOperations);
+    }
+    return !stats.programOperations || failed;
+}
+
+int main(int argc, char** argv)
+{
+    u32 length = (argc > 1) ? (u32) strtoul(argv[1], NULL, 0) : BENCH_SIZE;
+    int failures = 0;
+    u32 i;
+    if(length < 8 || length > MAX_BENCH_SIZE || (length % 4))
+    {
+        printf("bytes must be a multiple of 4 in 8 : %u\n", MAX_BENCH_SIZE);
+        return 1;
+    }
+    for(i = 0; i < sizeof(source); i++)
+    {
+        source[i] = (u8) (i * 7 + 3);
+    }
+    printf("%u bytes, FLASH_WRITE_CHUNK_SIZE %u\n", length, FLASH_WRITE_CHUNK_SIZE);
+    failures += runPath(PATH_WRITE_DATA, "flash_writeData (x32)", length);
+    failures += runPath(PATH_BUFFER_ALIGNED, "flash_writeBuffer aligned", length);
+    failures += runPath(PATH_BUFFER_UNALIGNED, "flash_writeBuffer +1", length);
+    flashSim_deinit();
+    remove(IMAGE_PATH);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,186 @@
+/*******************************************************************
+*   File name:    flash_test.c
+*   Author:       Ibrahim Saad
+*   Description:  Host test of the blocking erase paths of the flash driver on the flash
+*                 simulator:
+*                   - flash_eraseRange of sectors 1:2 erases them and leaves sectors 0 and 3,
+*                     an odd sector erased before must not change the next sector number
+*                   - a write protected sector stops flash_eraseRange with its error
+*                   - programming still works after an erase
+*                   - wait states (ACR) of the clock switches done by STM_RCC.c: never below what
+*                     the current and the new HCLK need during a switch, the minimum of the new one
+*                     after it, ART enabled, a busy flash or a clock above 84MHz refuse the switch
+*
+*   Build:        gcc -O2 -DFLASH_HOST_SIM -o flash_test flash_test.c
+*                     ../../COTS/MCAL/FlashDriver/FLASH.c ../../COTS/MCAL/FlashDriver/FLASH_Sim.c
+*   Usage:        ./flash_test
+*   Version: v1.0
+*******************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include "../../COTS/LIB/Address.h"
+#include "../../COTS/MCAL/FlashDriver/FLASH.h"
+#include "../../COTS/MCAL/FlashDriver/FLASH_Sim.h"
+
+#define IMAGE_PATH              "flash_test.bin"
+#define REG_OPTCR               5
+#define OPTCR_NWRP_SHIFT        16
+#define MARK_SIZE               16          /* bytes programmed at both ends of each sector */
+#define TEST_SECTORS            4           /* sectors 0:3, 16KB each */
+#define REG_ACR                 0
+#define MSK_ACR_LATENCY         0x0000000F
+#define MSK_ACR_ART             0x00000700  /* PRFTEN, ICEN, DCEN */
+#define HZ_PER_WAIT_STATE       30000000    /* 2.7V:3.6V */
+
+static const u8 mark [MARK_SIZE] = {0x5A, 0xA5, 0x00, 0x11, 0x22, 0x33, 0x44, 0x55,
+                                    0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD};
+
+static int mount(void)
+{
+    flashSim_deinit();
+    remove(IMAGE_PATH);
+    return flashSim_init(IMAGE_PATH, 0) == flashSim_retOk && flash_unlock() == flash_retOk;
+}
+
+static const u8* sectorBytes(u8 sector, pu32 size)
+{
+    u32 start = 0;
+    flash_getSectorRange(sectorNo_0 + sector, &start, size);
+    return (const u8*) TO_POINTER(start);
+}
+
+/* marks at the start and the end of each test sector */
+static int markSectors(void)
+{
+    int failed = 0;
+    u8 sector;
+    for(sector = 0; sector < TEST_SECTORS; sector++)
+    {
+        u32 size = 0;
+        const u8* bytes = sectorBytes(sector, &size);
+        failed |= flash_writeBuffer((void*) bytes, mark, MARK_SIZE) != flash_retOk;
+        failed |= flash_writeBuffer((void*) &bytes[size - MARK_SIZE], mark, MARK_SIZE) != flash_retOk;
+    }
+    return failed;
+}
+
+static int isErased(u8 sector)
+{
+    u32 size = 0, i;
+    const u8* bytes = sectorBytes(sector, &size);
+    for(i = 0; i < size && bytes[i] == 0xFF; i++)
+    {
+    }
+    return i == size;
+}
+
+static int isMarked(u8 sector)
+{
+    u32 size = 0;
+    const u8* bytes = sectorBytes(sector, &size);
+    return memcmp(bytes, mark, MARK_SIZE) == 0 && memcmp(&bytes[size - MARK_SIZE], mark, MARK_SIZE) == 0;
+}
+
+static int check(const char* name, int passed)
+{
+    printf("%-52s %s\n", name, passed ? "ok" : "FAILED");
+    return !passed;
+}
+
+static int testEraseRange(void)
+{
+    int failures = 0;
+    failures += check("mount and mark sectors 0:3", mount() && !markSectors());
+    failures += check("eraseRange sectors 1:2", flash_eraseRange(0x08004000, 0x8000) == flash_retOk);
+    failures += check("sectors 1 and 2 erased", isErased(1) && isErased(2));
+    failures += check("sectors 0 and 3 kept", isMarked(0) && isMarked(3));
+    /* an erase of sector 1 then of sector 2 by flash_eraseSector */
+    failures += check("mark again, erase sector 1 then sector 2", !markSectors()
+                      && flash_eraseSector(sectorNo_1) == flash_retOk && flash_eraseSector(sectorNo_2) == flash_retOk);
+    failures += check("sectors 1 and 2 erased, 0 and 3 kept", isErased(1) && isErased(2) && isMarked(0) && isMarked(3));
+    failures += check("program after erase", flash_writeBuffer(TO_POINTER(0x08004000), mark, MARK_SIZE) == flash_retOk
+                      && memcmp(TO_POINTER(0x08004000), mark, MARK_SIZE) == 0);
+    return failures;
+}
+
+static int testWriteProtection(void)
+{
+    int failures = 0;
+    failures += check("mount and mark sectors 0:3", mount() && !markSectors());
+    flashSim_registers[REG_OPTCR] &= ~(1 << (OPTCR_NWRP_SHIFT + 2));
+    failures += check("eraseRange 1:3, sector 2 protected, WRPERR",
+                      flash_eraseRange(0x08004000, 0xC000) == flash_retWriteProtectionError);
+    failures += check("sector 1 erased, sectors 2 and 3 kept", isErased(1) && isMarked(2) && isMarked(3));
+    flashSim_registers[REG_OPTCR] |= (1 << (OPTCR_NWRP_SHIFT + 2));
+    failures += check("error cleared, eraseRange 2:3", flash_eraseRange(0x08008000, 0x8000) == flash_retOk
+                      && isErased(2) && isErased(3) && isMarked(0));
+    return failures;
+}
+
+static u32 waitStatesOf(u32 hclk)
+{
+    return (hclk - 1) / HZ_PER_WAIT_STATE;
+}
+
+static u32 readWaitStates(void)
+{
+    return flashSim_registers[REG_ACR] & MSK_ACR_LATENCY;
+}
+
+static void onEraseDone(FLASH_ErrorStatus_t status)
+{
+    (void) status;
+}
+
+/* HSI, HSE, PLL/AHB prescaler HCLKs, the sequence of STM_RCC.c for each switch */
+static int testClockSwitches(void)
+{
+    static const u32 clocks [] = {16000000, 25000000, 42000000, 60000000, 84000000, 8000000};
+    int failures = 0;
+    u32 from, to;
+    failures += check("mount", mount());
+    for(from = 0; from < sizeof(clocks) / sizeof(clocks[0]); from++)
+    {
+        for(to = 0; to < sizeof(clocks) / sizeof(clocks[0]); to++)
+        {
+            char name [64];
+            u32 during;
+            int passed = flash_setLatencyForClock(clocks[from]) == flash_retOk && readWaitStates() == waitStatesOf(clocks[from]);
+            flashSim_registers[REG_ACR] &= ~MSK_ACR_ART;
+            passed = passed && flash_clockChangeHook(clocks[to]) == flash_retOk;
+            during = readWaitStates();
+            passed = passed && during >= waitStatesOf(clocks[from]) && during >= waitStatesOf(clocks[to])
+                     && (flashSim_registers[REG_ACR] & MSK_ACR_ART) == MSK_ACR_ART;
+            passed = passed && flash_setLatencyForClock(clocks[to]) == flash_retOk && readWaitStates() == waitStatesOf(clocks[to]);
+            if(!passed)
+            {
+                sprintf(name, "switch %uMHz to %uMHz, %u wait states during", clocks[from] / 1000000, clocks[to] / 1000000, during);
+                failures += check(name, 0);
+            }
+        }
+    }
+    failures += check("wait states of all switches", failures == 0);
+    failures += check("84MHz: 2 wait states", flash_setLatencyForClock(84000000) == flash_retOk && readWaitStates() == 2);
+    failures += check("100MHz refused, wait states kept", flash_clockChangeHook(100000000) == flash_retInvalidLatency
+                      && readWaitStates() == 2);
+    /* an erase keeps the flash busy until flashSim_processEvents */
+    failures += check("16MHz, erase running", flash_setLatencyForClock(16000000) == flash_retOk
+                      && flash_eraseSectorAsync(sectorNo_3, onEraseDone) == flash_retOk);
+    failures += check("84MHz refused while busy, wait states kept", flash_clockChangeHook(84000000) == flash_retBusy
+                      && readWaitStates() == 0);
+    failures += check("16MHz accepted while busy", flash_clockChangeHook(16000000) == flash_retOk);
+    return failures;
+}
+
+int main(void)
+{
+    int failures = 0;
+    failures += testEraseRange();
+    failures += testWriteProtection();
+    failures += testClockSwitches();
+    flashSim_deinit();
+    remove(IMAGE_PATH);
+    printf("%s\n", failures ? "FAILED" : "all passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,139 @@
+/*******************************************************************
+*   File name:    hex_bench.c
+*   Author:       Ibrahim Saad
+*   Description:  Host benchmark of hexParser_parseHexRecord, it parses every record of a
+*                 .hex file (or of a generated 512KB image) many times and prints records
+*                 per second and MB/s of hex text
+*
+*   Build:        gcc -O2 -o hex_bench hex_bench.c ../../COTS/Services/Bootloader/Hex_Parser/HexParser.c
+*   Usage:        ./hex_bench [file.hex]
+*   Version: v1.0
+*******************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../../COTS/Services/Bootloader/Hex_Parser/HexParser.h"
+
+#define GENERATED_IMAGE_SIZE    (512 * 1024)
+#define GENERATED_RECORD_SIZE   16
+#define MIN_RUN_TIME_S          1.0
+
+static double nowSeconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static u32 appendRecord(char* text, u8 type, u16 address, const u8* data, u8 length)
+{
+    u32 position = 0;
+    u8 sum = length + (address >> 8) + (address & 0xFF) + type;
+    u8 i;
+    position += sprintf(&text[position], ":%02X%04X%02X", length, address, type);
+    for(i = 0; i < length; i++)
+    {
+        position += sprintf(&text[position], "%02X", data[i]);
+        sum += data[i];
+    }
+    position += sprintf(&text[position], "%02X\r\n", (u8) (0 - sum));
+    return position;
+}
+
+/* 512KB of random data at 0x08000000 in records of GENERATED_RECORD_SIZE bytes */
+static char* generateHex(u32* textSize)
+{
+    char* text = malloc(GENERATED_IMAGE_SIZE / GENERATED_RECORD_SIZE * 64 + 1024);
+    u32 position = 0, address;
+    u8 data [GENERATED_RECORD_SIZE];
+    u8 i;
+    srand(1);
+    for(address = 0; address < GENERATED_IMAGE_SIZE; address += GENERATED_RECORD_SIZE)
+    {
+        if((address & 0xFFFF) == 0)
+        {
+            u8 upper [2] = {0x08, (u8) (address >> 16)};
+            position += appendRecord(&text[position], EXTENDED_LINEAR_ADDRESS_RECORD, 0, upper, 2);
+        }
+        for(i = 0; i < GENERATED_RECORD_SIZE; i++)
+        {
+            data[i] = (u8) rand();
+        }
+        position += appendRecord(&text[position], DATA_RECORD, (u16) address, data, GENERATED_RECORD_SIZE);
+    }
+    position += appendRecord(&text[position], END_OF_FILE_RECORD, 0, NULL, 0);
+    *textSize = position;
+    return text;
+}
+
+static char* readFile(const char* path, u32* textSize)
+{
+    FILE* file = fopen(path, "rb");
+    char* text = NULL;
+    if(file)
+    {
+        fseek(file, 0, SEEK_END);
+        *textSize = (u32) ftell(file);
+        fseek(file, 0, SEEK_SET);
+        text = malloc(*textSize + 1);
+        if(text && fread(text, 1, *textSize, file) != *textSize)
+        {
+            free(text);
+            text = NULL;
+        }
+        fclose(file);
+    }
+    return text;
+}
+
+int main(int argc, char** argv)
+{
+    u32 textSize = 0, recordsCount = 0, badRecords = 0, i;
+    char* text = (argc > 1) ? readFile(argv[1], &textSize) : generateHex(&textSize);
+    u8** records;
+    HexRecord_t record;
+    double start, elapsed;
+    u64 parsed = 0;
+    if(!text)
+    {
+        printf("can't read %s\n", argv[1]);
+        return 1;
+    }
+    text[textSize] = '\0';
+    /* split lines once, the benchmark times only the parser */
+    records = malloc(sizeof(u8*) * (textSize / 11 + 1));
+    for(i = 0; i < textSize; i++)
+    {
+        if(text[i] == ':')
+        {
+            records[recordsCount++] = (u8*) &text[i];
+        }
+        else if(text[i] == '\r' || text[i] == '\n')
+        {
+            text[i] = '\0';
+        }
+    }
+    for(i = 0; i < recordsCount; i++)
+    {
+        badRecords += !hexParser_parseHexRecord(records[i], &record);
+    }
+    start = nowSeconds();
+    elapsed = 0;
+    while(elapsed < MIN_RUN_TIME_S)
+    {
+        for(i = 0; i < recordsCount; i++)
+        {
+            hexParser_parseHexRecord(records[i], &record);
+        }
+        parsed += recordsCount;
+        elapsed = nowSeconds() - start;
+    }
+    printf("%u records (%u bytes of text), %u rejected\n", recordsCount, textSize, badRecords);
+    printf("%.2f M records/s, %.1f MB/s of hex text\n", parsed / elapsed / 1e6,
+           (double) textSize * (parsed / recordsCount) / elapsed / 1e6);
+    free(records);
+    free(text);
+    return badRecords ? 1 : 0;
+}
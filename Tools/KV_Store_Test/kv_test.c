@@ -0,0 +1,334 @@
+/*******************************************************************
+*   File name:    kv_test.c
+*   Author:       Ibrahim Saad
+*   Description:  Host test of the key/value store (COTS/Services/KV_Store) on the flash
+*                 simulator, it checks every value against a model in RAM:
+*                   - endurance: random writes and deletes with compactions
+*                   - power fail sweep: power is lost at each flash operation of a run of
+*                     writes, the store is mounted again, checked, then written again
+*                   - erase count: power is lost after each compaction erase, before its count is
+*                     programmed, no sector's count may drop and the erase must be counted
+*                 writes waiting compaction forever (kv_retBusy) or kv_retNoSpace fail the test,
+*                 build it with KV_SECTORS_COUNT=2 too (the smallest store)
+*
+*   Build:        gcc -O2 -DFLASH_HOST_SIM -o kv_test kv_test.c ../../COTS/Services/KV_Store/KV_Store.c
+*                     ../../COTS/MCAL/FlashDriver/FLASH.c ../../COTS/MCAL/FlashDriver/FLASH_Sim.c
+*                 gcc -O2 -DFLASH_HOST_SIM -DKV_SECTORS_COUNT=2 -o kv_test2 kv_test.c ...
+*   Usage:        ./kv_test [endurance writes] [power fail points]
+*   Version: v1.0
+*******************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../COTS/Services/KV_Store/KV_Store.h"
+#include "../../COTS/MCAL/FlashDriver/FLASH_Sim.h"
+
+#define IMAGE_PATH              "kv_test.bin"
+#define TEST_KEYS               16
+#define MAX_TEST_VALUE_SIZE     100
+#define MAX_RETRIES             100000      /* runs of kv_runnable a write may wait */
+#define DEFAULT_WRITES          3000
+#define DEFAULT_FAIL_POINTS     3000
+#define WARM_UP_WRITES          400         /* before the power fail, so compactions are running */
+#define WRITES_AFTER_REMOUNT    300
+#define ERASE_COUNT_CUTS        50          /* power fails between an erase and its count */
+#define MAX_STEPS_TO_ERASE      100000
+
+typedef struct
+{
+    u8 present;
+    u16 length;
+    u8 value [MAX_TEST_VALUE_SIZE];
+}modelKey_t;
+
+static modelKey_t model [TEST_KEYS];
+static u32 randomState = 1;
+
+static u32 nextRandom(void)
+{
+    randomState = randomState * 1103515245 + 12345;
+    return randomState >> 8;
+}
+
+static int mount(int fresh)
+{
+    if(fresh)
+    {
+        remove(IMAGE_PATH);
+    }
+    return flashSim_init(IMAGE_PATH, 0) == flashSim_retOk && kv_init() == kv_retOk;
+}
+
+/* a write or delete retried while the store is busy, as the application does with its scheduler */
+static KV_ErrorStatus_t runOperation(u16 key, const u8* value, u16 length)
+{
+    KV_ErrorStatus_t result = kv_retBusy;
+    u32 retries = 0;
+    while(result == kv_retBusy && retries < MAX_RETRIES && !flashSim_isPowerLost())
+    {
+        result = length ? kv_write(key, value, length) : kv_delete(key);
+        if(result == kv_retBusy)
+        {
+            kv_runnable();
+            flashSim_processEvents();
+            retries++;
+        }
+    }
+    if(result == kv_retKeyNotFound && !length)
+    {
+        result = kv_retOk;
+    }
+    return result;
+}
+
+/* random operation on the model and the store, a delete one time in 8 */
+static KV_ErrorStatus_t randomOperation(u16* key, modelKey_t* newValue)
+{
+    u16 i;
+    *key = nextRandom() % TEST_KEYS;
+    newValue->present = (nextRandom() % 8) != 0;
+    newValue->length = newValue->present ? 1 + nextRandom() % MAX_TEST_VALUE_SIZE : 0;
+    for(i = 0; i < newValue->length; i++)
+    {
+        newValue->value[i] = (u8) nextRandom();
+    }
+    kv_runnable();
+    flashSim_processEvents();
+    return runOperation(*key, newValue->value, newValue->length);
+}
+
+static int sameAs(u16 key, const modelKey_t* expected)
+{
+    u8 value [KV_MAX_VALUE_SIZE];
+    u16 length = 0;
+    KV_ErrorStatus_t result = kv_read(key, value, sizeof(value), &length);
+    return expected->present ? (result == kv_retOk && length == expected->length && memcmp(value, expected->value, length) == 0)
+                             : (result == kv_retKeyNotFound);
+}
+
+static int checkModel(const char* when, int pendingKey, const modelKey_t* pendingValue)
+{
+    int failures = 0;
+    u16 key;
+    for(key = 0; key < TEST_KEYS; key++)
+    {
+        /* the operation cut by the power fail may be there or not */
+        if(!sameAs(key, &model[key]) && !((int) key == pendingKey && sameAs(key, pendingValue)))
+        {
+            printf("%s: key %u doesn't match\n", when, key);
+            failures++;
+        }
+    }
+    return failures;
+}
+
+static int testEndurance(u32 writes)
+{
+    int failures = 0;
+    u32 i;
+    u32 eraseCount, totalErases = 0;
+    u8 sector;
+    memset(model, 0, sizeof(model));
+    if(!mount(1))
+    {
+        printf("endurance: mount failed\n");
+        return 1;
+    }
+    for(i = 0; i < writes && !failures; i++)
+    {
+        u16 key;
+        modelKey_t newValue;
+        KV_ErrorStatus_t result = randomOperation(&key, &newValue);
+        if(result != kv_retOk)
+        {
+            printf("endurance: operation %u failed (%d)\n", i, result);
+            failures++;
+        }
+        model[key] = newValue;
+    }
+    failures += checkModel("endurance", -1, NULL);
+    flashSim_deinit();
+    failures += !mount(0);
+    failures += checkModel("endurance remount", -1, NULL);
+    for(sector = 0; sector < KV_SECTORS_COUNT; sector++)
+    {
+        kv_getEraseCount(sector, &eraseCount);
+        totalErases += eraseCount;
+    }
+    flashSim_deinit();
+    printf("endurance: %u operations on %u keys, %u sector erases, %s\n", writes, TEST_KEYS, totalErases,
+           failures ? "FAILED" : "ok");
+    return failures;
+}
+
+static int testPowerFail(u32 failPoints)
+{
+    int failures = 0;
+    u32 point, i;
+    for(point = 1; point <= failPoints; point++)
+    {
+        int pendingKey = -1;
+        modelKey_t pendingValue;
+        char when [48];
+        memset(model, 0, sizeof(model));
+        randomState = point;
+        failures += !mount(1);
+        for(i = 0; i < WARM_UP_WRITES; i++)
+        {
+            u16 key;
+            if(randomOperation(&key, &pendingValue) == kv_retOk)
+            {
+                model[key] = pendingValue;
+            }
+        }
+        flashSim_schedulePowerFail(point);
+        while(!flashSim_isPowerLost())
+        {
+            u16 key;
+            KV_ErrorStatus_t result = randomOperation(&key, &pendingValue);
+            if(flashSim_isPowerLost())
+            {
+                pendingKey = key;
+            }
+            else if(result == kv_retOk)
+            {
+                model[key] = pendingValue;
+            }
+        }
+        flashSim_powerOn();
+        flashSim_deinit();
+        sprintf(when, "power fail at operation %u", point);
+        if(!mount(0))
+        {
+            printf("%s: mount failed\n", when);
+            failures++;
+        }
+        else if(checkModel(when, pendingKey, &pendingValue))
+        {
+            failures++;
+        }
+        else
+        {
+            /* the store goes on after the remount, interrupted compaction included */
+            for(i = 0; i < WRITES_AFTER_REMOUNT; i++)
+            {
+                u16 key;
+                modelKey_t newValue;
+                KV_ErrorStatus_t result = randomOperation(&key, &newValue);
+                if(result != kv_retOk)
+                {
+                    printf("%s: write %u after remount failed (%d)\n", when, i, result);
+                    failures++;
+                    break;
+                }
+                model[key] = newValue;
+            }
+            failures += checkModel(when, -1, NULL) != 0;
+        }
+        flashSim_deinit();
+    }
+    printf("power fail: %u points, %s\n", failPoints, failures ? "FAILED" : "ok");
+    return failures;
+}
+
+static void readEraseCounts(pu32 counts)
+{
+    u8 sector;
+    for(sector = 0; sector < KV_SECTORS_COUNT; sector++)
+    {
+        kv_getEraseCount(sector, &counts[sector]);
+    }
+}
+
+static u32 erasedSectors(void)
+{
+    flashSimStats_t stats = {0};
+    flashSim_getStats(&stats);
+    return stats.erasedSectors;
+}
+
+/* single steps of the store, the power is lost as soon as the flash ends an erase: its count is still in RAM */
+static int testEraseCountPowerFail(u32 cuts)
+{
+    int failures = 0;
+    u32 cut, steps;
+    u32 before [KV_SECTORS_COUNT], after [KV_SECTORS_COUNT];
+    u32 totalBefore, totalAfter;
+    u8 sector;
+    memset(model, 0, sizeof(model));
+    randomState = 1;
+    failures += !mount(1);
+    for(cut = 0; cut < cuts && !failures; cut++)
+    {
+        u32 erased = erasedSectors();
+        readEraseCounts(before);
+        for(steps = 0; steps < MAX_STEPS_TO_ERASE && erasedSectors() == erased; steps++)
+        {
+            kv_runnable();
+            flashSim_processEvents();
+            if(erasedSectors() == erased)
+            {
+                u16 key;
+                modelKey_t newValue;
+                u16 i;
+                key = nextRandom() % TEST_KEYS;
+                newValue.present = 1;
+                newValue.length = 1 + nextRandom() % MAX_TEST_VALUE_SIZE;
+                for(i = 0; i < newValue.length; i++)
+                {
+                    newValue.value[i] = (u8) nextRandom();
+                }
+                if(kv_write(key, newValue.value, newValue.length) == kv_retOk)
+                {
+                    model[key] = newValue;
+                }
+            }
+        }
+        flashSim_deinit();
+        if(steps == MAX_STEPS_TO_ERASE || !mount(0))
+        {
+            printf("erase count: cut %u, no erase or mount failed\n", cut);
+            failures++;
+        }
+        else
+        {
+            readEraseCounts(after);
+            totalBefore = 0;
+            totalAfter = 0;
+            for(sector = 0; sector < KV_SECTORS_COUNT; sector++)
+            {
+                if(after[sector] < before[sector])
+                {
+                    printf("erase count: cut %u, sector %u count dropped from %u to %u\n", cut, sector, before[sector], after[sector]);
+                    failures++;
+                }
+                totalBefore += before[sector];
+                totalAfter += after[sector];
+            }
+            if(totalAfter <= totalBefore)
+            {
+                printf("erase count: cut %u, the erase isn't counted\n", cut);
+                failures++;
+            }
+            failures += checkModel("erase count", -1, NULL) != 0;
+        }
+    }
+    flashSim_deinit();
+    printf("erase count: %u power fails after an erase, %s\n", cuts, failures ? "FAILED" : "ok");
+    return failures;
+}
+
+int main(int argc, char** argv)
+{
+    u32 writes = (argc > 1) ? (u32) strtoul(argv[1], NULL, 0) : DEFAULT_WRITES;
+    u32 failPoints = (argc > 2) ? (u32) strtoul(argv[2], NULL, 0) : DEFAULT_FAIL_POINTS;
+    int failures = 0;
+    printf("%u sectors of %u KB, values up to %u bytes\n", KV_SECTORS_COUNT, KV_SECTOR_SIZE / 1024, MAX_TEST_VALUE_SIZE);
+    failures += testEndurance(writes);
+    failures += testPowerFail(failPoints);
+    failures += testEraseCountPowerFail(ERASE_COUNT_CUTS);
+    remove(IMAGE_PATH);
+    printf("%s\n", failures ? "FAILED" : "all passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,198 @@
+/*******************************************************************
+*   File name:    lzss_compress.c
+*   Author:       Ibrahim Saad
+*   Description:  Host compressor of firmware images for the LZSS stage of the bootloader
+*                 (LzssStream.h), it writes the file header and the stream, then decodes the
+*                 stream by LzssStream.c in pieces of 256 bytes and checks it gives the image back
+*
+*   Build:        gcc -O2 -o lzss_compress lzss_compress.c ../../COTS/Services/Bootloader/Lzss_Stream/LzssStream.c
+*                     ../../COTS/LIB/Soft_CRC/Soft_crc.c
+*   Usage:        ./lzss_compress image.bin image.lzs
+*   Version: v1.0
+*******************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../COTS/Services/Bootloader/Lzss_Stream/LzssStream.h"
+#include "../../COTS/LIB/Soft_CRC/Soft_crc.h"
+
+#define HASH_BITS               15
+#define HASH_SIZE               (1 << HASH_BITS)
+#define NO_POSITION             0xFFFFFFFF
+#define MAX_CHAIN               256             /* positions tried for a match */
+#define CHECK_PIECE_SIZE        256             /* as the chunks of BinaryLink */
+
+typedef struct
+{
+    u32 length;
+    u32 distance;
+}match_t;
+
+static u32 head [HASH_SIZE];
+static u32* previous = NULL;                    /* previous position of the same hash */
+static const u8* checkImage = NULL;
+static u32 checkPosition = 0;
+
+static u32 hash3(const u8* bytes)
+{
+    return ((bytes[0] << 16 | bytes[1] << 8 | bytes[2]) * 2654435761u) >> (32 - HASH_BITS);
+}
+
+static void insertPosition(const u8* image, u32 size, u32 position)
+{
+    if(position + LZSS_MIN_MATCH <= size)
+    {
+        u32 key = hash3(&image[position]);
+        previous[position] = head[key];
+        head[key] = position;
+    }
+}
+
+static match_t findMatch(const u8* image, u32 size, u32 position)
+{
+    match_t best = {0, 0};
+    u32 candidate, chain = 0, maxLength = size - position;
+    if(maxLength > LZSS_MAX_MATCH)
+    {
+        maxLength = LZSS_MAX_MATCH;
+    }
+    if(maxLength < LZSS_MIN_MATCH)
+    {
+        return best;
+    }
+    candidate = head[hash3(&image[position])];
+    while(candidate != NO_POSITION && position - candidate <= LZSS_WINDOW_SIZE && chain < MAX_CHAIN)
+    {
+        u32 length = 0;
+        while(length < maxLength && image[candidate + length] == image[position + length])
+        {
+            length++;
+        }
+        if(length > best.length)
+        {
+            best.length = length;
+            best.distance = position - candidate;
+            if(length == maxLength)
+            {
+                break;
+            }
+        }
+        candidate = previous[candidate];
+        chain++;
+    }
+    if(best.length < LZSS_MIN_MATCH)
+    {
+        best.length = 0;
+    }
+    return best;
+}
+
+/* greedy parse with one step of lazy matching, returns the stream size */
+static u32 compress(const u8* image, u32 size, u8* stream)
+{
+    u32 position = 0, out = 0, flagsAt = 0, item = 8;
+    memset(head, 0xFF, sizeof(head));
+    while(position < size)
+    {
+        match_t match = findMatch(image, size, position);
+        if(item == 8)
+        {
+            flagsAt = out++;
+            stream[flagsAt] = 0;
+            item = 0;
+        }
+        insertPosition(image, size, position);
+        if(match.length && position + 1 < size && findMatch(image, size, position + 1).length > match.length)
+        {
+            /* a longer match at the next byte is worth a literal now */
+            match.length = 0;
+        }
+        if(match.length)
+        {
+            u16 token = (u16) ((match.distance - 1) | ((match.length - LZSS_MIN_MATCH) << LZSS_WINDOW_BITS));
+            u32 last = position + match.length;
+            stream[out++] = (u8) token;
+            stream[out++] = (u8) (token >> 8);
+            while(++position < last)
+            {
+                insertPosition(image, size, position);
+            }
+        }
+        else
+        {
+            stream[flagsAt] |= (u8) (1 << item);
+            stream[out++] = image[position];
+            position++;
+        }
+        item++;
+    }
+    return out;
+}
+
+static u8 checkSink(const u8* data, u32 length)
+{
+    u8 same = (memcmp(data, &checkImage[checkPosition], length) == 0);
+    checkPosition += length;
+    return same;
+}
+
+int main(int argc, char** argv)
+{
+    FILE* file;
+    u8* image;
+    u8* stream;
+    u8 header [LZSS_FILE_HEADER_SIZE];
+    u32 size, streamSize, crc, i;
+    LzssStream_ErrorStatus_t status = lzssStream_retBusy;
+    if(argc < 3 || !(file = fopen(argv[1], "rb")))
+    {
+        printf("usage: %s image.bin image.lzs\n", argv[0]);
+        return 1;
+    }
+    fseek(file, 0, SEEK_END);
+    size = (u32) ftell(file);
+    fseek(file, 0, SEEK_SET);
+    image = malloc(size + 1);
+    stream = malloc(size + size / 8 + 16);
+    previous = malloc(sizeof(u32) * (size + 1));
+    size = (u32) fread(image, 1, size, file);
+    fclose(file);
+    streamSize = compress(image, size, stream);
+
+    checkImage = image;
+    lzssStream_begin(size, checkSink);
+    for(i = 0; i < streamSize && (status == lzssStream_retBusy || status == lzssStream_retDone); i += CHECK_PIECE_SIZE)
+    {
+        status = lzssStream_feed(&stream[i], (streamSize - i < CHECK_PIECE_SIZE) ? streamSize - i : CHECK_PIECE_SIZE);
+    }
+    if(status != lzssStream_retDone || checkPosition != size)
+    {
+        printf("decoded stream doesn't match the image (status %d)\n", status);
+        return 1;
+    }
+
+    crc = softCrc_updateBytes(SOFT_CRC_INIT, image, size);
+    for(i = 0; i < 4; i++)
+    {
+        header[i] = (u8) (LZSS_FILE_MAGIC >> (8 * i));
+        header[4 + i] = (u8) (size >> (8 * i));
+        header[8 + i] = (u8) (crc >> (8 * i));
+    }
+    file = fopen(argv[2], "wb");
+    if(!file || fwrite(header, 1, sizeof(header), file) != sizeof(header) || fwrite(stream, 1, streamSize, file) != streamSize)
+    {
+        printf("can't write %s\n", argv[2]);
+        return 1;
+    }
+    fclose(file);
+    printf("%u -> %u bytes (%.1f%%), window %u bytes\n", size, streamSize, 100.0 * streamSize / size, LZSS_WINDOW_SIZE);
+    if(streamSize >= size)
+    {
+        printf("the image doesn't compress, send it as it is\n");
+    }
+    free(previous);
+    free(stream);
+    free(image);
+    return 0;
+}